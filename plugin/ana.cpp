@@ -1,3 +1,4 @@
+#define LOG_CATEGORY log_analysis
 #include "idp.hpp"
 #include "nmips.hpp"
 #include "log.hpp"
@@ -6,6 +7,7 @@
 #include <ida.hpp>
 #include <allins.hpp>
 #include <map>
+#include <algorithm>
 #include <pro.h>
 #include <string>
 #include "ins.hpp"
@@ -221,22 +223,21 @@ std::map<std::string, uint16> opcode_mapping = {
     {"move.balc", nMIPS_move_balc},
 };
 
-bool plugin_ctx_t::fill_opcode(insn_t &insn, struct nanomips_opcode& op)
+void plugin_ctx_t::build_opcode_itypes()
 {
-#define cmp_op(exp_name) (strcmp(op.name, exp_name) == 0)
-
-    std::string op_name(op.name);
-
-    auto it = opcode_mapping.find(op_name);
-    if (it != opcode_mapping.end()) {
-        insn.itype = it->second;
-    } else {
-        // LOG("[0x%x] opcode %s not implemented!", insn.ea, op.name);
-        insn.itype = nMIPS_todo;
-        return false;
+    opcode_itypes.resize(bfd_nanomips_num_opcodes);
+    for (int i = 0; i < bfd_nanomips_num_opcodes; i++)
+    {
+        auto it = opcode_mapping.find(nanomips_opcodes[i].name);
+        opcode_itypes[i] = it != opcode_mapping.end() ? it->second : nMIPS_todo;
     }
-    
-    return true;
+}
+
+bool plugin_ctx_t::fill_opcode(insn_t &insn, const struct nanomips_opcode& op)
+{
+    insn.itype = opcode_itypes[&op - nanomips_opcodes];
+    // LOG("[0x%x] opcode %s not implemented!", insn.ea, op.name);
+    return insn.itype != nMIPS_todo;
 }
 
 size_t remap_register(size_t reg)
@@ -251,14 +252,91 @@ size_t remap_register(size_t reg)
     return reg;
 }
 
-int plugin_ctx_t::fill_operand(insn_t &insn, struct nanomips_opcode& opcode, nanomips_decoded_op &op, int idx)
+/**
+ * @brief  The ida operand type a nanomips operand turns into, o_void if it is not implemented yet.
+ */
+static optype_t fill_optype(enum nanomips_operand_type type)
+{
+    switch (type)
+    {
+        case OP_INT:
+        case OP_IMM_INT:
+        case OP_MAPPED_INT:
+        case OP_MSB:
+        case OP_NEG_INT:
+        case OP_HI20_INT:
+        case OP_IMM_WORD:
+        case OP_UINT_WORD:
+        case OP_INT_WORD:
+        case OP_GPREL_WORD:
+            return o_imm;
+
+        case OP_REG:
+        case OP_OPTIONAL_REG:
+        case OP_MAPPED_CHECK_PREV:
+        case OP_BASE_CHECK_OFFSET:
+        case OP_REG_PAIR:
+        case OP_CHECK_PREV:
+        case OP_NON_ZERO_REG:
+        case OP_REPEAT_PREV_REG:
+        case OP_REPEAT_DEST_REG:
+            return o_reg;
+
+        case OP_PCREL:
+        case OP_PC_WORD:
+        // TODO: this decodes wrong, not sure why??
+        case OP_HI20_PCREL:
+        case OP_NON_ZERO_PCREL_S1:
+            return o_mem;
+
+        case OP_SAVE_RESTORE_LIST:
+            // specval is a bitmap of the registers to save.
+            return MIPS_SAVE_RESTORE_TYPE;
+
+        default:
+            return o_void;
+    }
+}
+
+static fill_field_t fill_field(optype_t type)
+{
+    switch (type)
+    {
+        case o_imm: return fill_value;
+        case o_reg: return fill_reg;
+        case o_mem: return fill_addr;
+        default: return fill_specval;
+    }
+}
+
+static inline uval_t get_fill_field(const op_t& op, uint8 field)
+{
+    switch (field)
+    {
+        case fill_reg: return op.reg;
+        case fill_value: return op.value;
+        case fill_addr: return op.addr;
+        default: return op.specval;
+    }
+}
+
+static inline void set_fill_field(op_t& op, uint8 field, uval_t val)
+{
+    switch (field)
+    {
+        case fill_reg: op.reg = val; break;
+        case fill_value: op.value = val; break;
+        case fill_addr: op.addr = val; break;
+        default: op.specval = val; break;
+    }
+}
+
+int plugin_ctx_t::operand_values(const struct nanomips_opcode& opcode, const nanomips_decoded_op &op, uval_t* out)
 {
     struct nanomips_operand* operand = op.op;
     unsigned int uval = op.val;
     bfd_vma base_pc = op.base_pc;
-    op_t* res = &insn.ops[idx];
-    res->dtype = dt_dword;
-    bool did_something = true;
+    int count_out = 1;
 
     // only used for save restore list.
     bool mode16 = opcode.mask >> 16 == 0;
@@ -266,10 +344,8 @@ int plugin_ctx_t::fill_operand(insn_t &insn, struct nanomips_opcode& opcode, nan
     #define set_reg(num) bitmask = (bitmask | (1 << (num)))
     unsigned int freg, fp, gp, ra;
     int count;
-    
-    int next_idx = idx+1;
 
-    switch (op.op->type)
+    switch (operand->type)
     {
         case OP_INT:
         case OP_IMM_INT:
@@ -278,8 +354,7 @@ int plugin_ctx_t::fill_operand(insn_t &insn, struct nanomips_opcode& opcode, nan
 
             int_op = (const struct nanomips_int_operand *) operand;
             uval = nanomips_decode_int_operand (int_op, uval);
-            res->type = o_imm;
-            res->value = uval;
+            out[0] = uval;
         }
         break;
 
@@ -289,8 +364,7 @@ int plugin_ctx_t::fill_operand(insn_t &insn, struct nanomips_opcode& opcode, nan
 
             mint_op = (const struct nanomips_mapped_int_operand *) operand;
             uval = mint_op->int_map[uval];
-            res->type = o_imm;
-            res->value = uval;
+            out[0] = uval;
         }
         break;
 
@@ -302,8 +376,7 @@ int plugin_ctx_t::fill_operand(insn_t &insn, struct nanomips_opcode& opcode, nan
             uval += msb_op->bias;
             if (msb_op->add_lsb)
                 uval -= ana_state.last_int;
-            res->type = o_imm;
-            res->value = uval;
+            out[0] = uval;
         }
         break;
 
@@ -316,9 +389,7 @@ int plugin_ctx_t::fill_operand(insn_t &insn, struct nanomips_opcode& opcode, nan
 
             reg_op = (const struct nanomips_reg_operand *) operand;
             uval = nanomips_decode_reg_operand (reg_op, uval);
-            uval = remap_register(uval);
-            res->type = o_reg;
-            res->reg = uval; // TODO change mapping here!
+            out[0] = remap_register(uval); // TODO change mapping here!
         }
         break;
 
@@ -327,14 +398,9 @@ int plugin_ctx_t::fill_operand(insn_t &insn, struct nanomips_opcode& opcode, nan
             const struct nanomips_reg_pair_operand *pair_op;
 
             pair_op = (const struct nanomips_reg_pair_operand *) operand;
-            int reg1 = pair_op->reg1_map[uval];
-            int reg2 = pair_op->reg2_map[uval];
-            res->type = o_reg;
-            res->reg = remap_register(reg1);
-            insn.ops[next_idx].type = o_reg;
-            insn.ops[next_idx].dtype = dt_dword;
-            insn.ops[next_idx].reg = remap_register(reg2);
-            next_idx++;
+            out[0] = remap_register(pair_op->reg1_map[uval]);
+            out[1] = remap_register(pair_op->reg2_map[uval]);
+            count_out = 2;
         }
         break;
 
@@ -343,45 +409,32 @@ int plugin_ctx_t::fill_operand(insn_t &insn, struct nanomips_opcode& opcode, nan
             const struct nanomips_pcrel_operand *pcrel_op;
 
             pcrel_op = (const struct nanomips_pcrel_operand *) operand;
-            bfd_vma address = nanomips_decode_pcrel_operand (pcrel_op, base_pc, uval);
-
-            res->type = o_mem;
-            res->addr = address;
+            out[0] = nanomips_decode_pcrel_operand (pcrel_op, base_pc, uval);
         }
         break;
 
         case OP_CHECK_PREV:
         case OP_NON_ZERO_REG:
-        {
-            res->type = o_reg;
-            res->reg = remap_register(uval & 31);
-        }
+            out[0] = remap_register(uval & 31);
         break;
 
         case OP_NEG_INT:
-            res->type = o_imm;
-            res->value = -uval;
+            out[0] = -uval;
         break;
 
         case OP_REPEAT_PREV_REG:
-            res->type = o_reg;
-            res->reg = ana_state.last_reg;
+            out[0] = ana_state.last_reg;
         break;
 
         case OP_REPEAT_DEST_REG:
-            res->type = o_reg;
-            res->reg = ana_state.dest_reg;
+            out[0] = ana_state.dest_reg;
         break;
 
         case OP_PC_WORD:
-            res->type = o_mem;
-	        res->addr = base_pc + (((uval >> 16) & 0xffff) | (uval << 16));
+            out[0] = base_pc + (((uval >> 16) & 0xffff) | (uval << 16));
         break;
 
         case OP_SAVE_RESTORE_LIST:
-            res->type = MIPS_SAVE_RESTORE_TYPE;
-            // specval is a bitmap of the registers to save.
-            
             fp = gp = ra = 0;
 
             if (mode16)
@@ -438,34 +491,20 @@ int plugin_ctx_t::fill_operand(insn_t &insn, struct nanomips_opcode& opcode, nan
                     set_reg(freg + i);
                 }
             }
-            res->specval = bitmask;
+            out[0] = bitmask;
         break;
 
-        // TODO: this decodes wrong, not sure why??
         case OP_HI20_PCREL:
-        {
-            res->type = o_mem;
-            
-            if (false)
-            {
-                uval = nanomips_decode_hi20_int_operand (operand, uval);
-                res->addr = uval;
-            }
-            else
-            {
-                res->addr = nanomips_decode_hi20_pcrel_operand (operand, base_pc, uval);
-            }
-        }
+            out[0] = nanomips_decode_hi20_pcrel_operand (operand, base_pc, uval);
         break;
 
         case OP_HI20_INT:
         {
             uval = nanomips_decode_hi20_int_operand (operand, uval);
-            res->type = o_imm;
-            if (false || uval == 0)
-                res->value = uval & 0xfffff;
+            if (uval == 0)
+                out[0] = uval & 0xfffff;
             else
-                res->value = (uval & 0xfffff) << 12;
+                out[0] = (uval & 0xfffff) << 12;
             // LOG("HI20(0x%x)", uval);
         }
         break;
@@ -477,13 +516,7 @@ int plugin_ctx_t::fill_operand(insn_t &insn, struct nanomips_opcode& opcode, nan
                 static_cast<unsigned int>((1 << operand->size) - 1), 0, 1, TRUE}, 0, 0, 0
             };
 
-            res->type = o_mem;
-
-            if (true)
-                res->addr = nanomips_decode_pcrel_operand (&pcrel_op, base_pc,
-                                    uval);
-            else
-                res->addr = 0;
+            out[0] = nanomips_decode_pcrel_operand (&pcrel_op, base_pc, uval);
         }
         break;
 
@@ -491,42 +524,186 @@ int plugin_ctx_t::fill_operand(insn_t &insn, struct nanomips_opcode& opcode, nan
         {
             const struct nanomips_int_operand *int_op;
             int_op = (const struct nanomips_int_operand *) operand;
-            res->value = ((uval >> 16) & 0xffff) | (uval << 16);
-            res->value += int_op->bias;
-            res->type = o_imm;
+            out[0] = ((uval >> 16) & 0xffff) | (uval << 16);
+            out[0] += int_op->bias;
         }
         break;
 
         case OP_UINT_WORD:
         case OP_INT_WORD:
         case OP_GPREL_WORD:
-        {
-            res->type = o_imm;
-            res->value = ((uval >> 16) & 0xffff) | (uval << 16);
-        }
+            out[0] = ((uval >> 16) & 0xffff) | (uval << 16);
         break;
 
         default:
-            LOG("[0x%x] Operand %d not yet implemented!", insn.ea, op.op->type);
-            did_something = false;
-            next_idx = idx;
+            return 0;
+    }
+    #undef set_reg
+
+    switch (fill_optype(operand->type)) {
+        case o_reg:
+            ana_state.record_register((uint16)out[0]);
+        break;
+        case o_imm:
+            ana_state.record_int(out[0]);
         break;
     }
 
-    if (did_something)
+    return count_out;
+}
+
+void plugin_ctx_t::build_fill_plans()
+{
+    fill_plans.clear();
+    fill_plans.resize(bfd_nanomips_num_opcodes);
+    for (int i = 0; i < bfd_nanomips_num_opcodes; i++)
     {
-        switch (res->type) {
-            case o_reg:
-                ana_state.record_register(res->reg);
-            break;
-            case o_imm:
-                ana_state.record_int(res->value);
-            break;
+        fill_plan_t& plan = fill_plans[i];
+        plan.itype = opcode_itypes[i];
+        if (plan.itype == nMIPS_todo) continue;
+
+        uint32 vals[MAX_NUM_OPS] = {};
+        nanomips_decoded_op operands[MAX_NUM_OPS] = {};
+        unsigned int num_operands = nanomips_expand_operands(&nanomips_opcodes[i], vals, 0, 0, operands);
+
+        // the operands as filled in before post processing, every value gets its own slot.
+        insn_t layout;
+        layout.itype = plan.itype;
+        int idx = 0;
+        int slot = 0;
+        for (unsigned int k = 0; k < num_operands && idx < UA_MAXOP; k++)
+        {
+            enum nanomips_operand_type type = operands[k].op->type;
+            // don't care operand, we should skip!
+            if (type == OP_DONT_CARE) continue;
+
+            layout.ops[idx].dtype = dt_dword;
+            optype_t optype = fill_optype(type);
+            if (optype == o_void)
+            {
+                LOG("Operand %d of %s not yet implemented!", type, nanomips_opcodes[i].name);
+                continue;
+            }
+
+            plan.operands[plan.num_operands++] = k;
+            int num_values = type == OP_REG_PAIR ? 2 : 1;
+            for (int v = 0; v < num_values && idx < UA_MAXOP; v++, idx++, slot++)
+            {
+                layout.ops[idx].type = optype;
+                layout.ops[idx].dtype = dt_dword;
+                plan.writes[plan.num_writes++] = { (uint8)slot, (uint8)idx, (uint8)fill_field(optype) };
+            }
+        }
+
+        // run post_process on the layout twice, with different placeholders for the values.
+        // Fields holding the same placeholder slot both times just receive that value,
+        // anything else was computed from the values and needs post_process at runtime.
+        auto placeholders = [&](uval_t reg_tag, uval_t tag) {
+            insn_t tagged = layout;
+            for (int w = 0; w < plan.num_writes; w++)
+            {
+                const fill_write_t& write = plan.writes[w];
+                set_fill_field(tagged.ops[write.op], write.field, (write.field == fill_reg ? reg_tag : tag) | write.slot);
+            }
+            post_process(tagged);
+            return tagged;
+        };
+
+        bool folded = false;
+        // these add a secondary instruction, so cannot be run here.
+        if (plan.itype != nMIPS_move_balc && plan.itype != nMIPS_restore_jrc)
+        {
+            insn_t a = placeholders(0xff00, 0xfeed0000);
+            insn_t b = placeholders(0xfe00, 0xface0000);
+            fill_write_t writes[qnumber(plan.writes)];
+            int num_writes = 0;
+            folded = a.itype == b.itype && a.flags == b.flags;
+            for (int o = 0; o < UA_MAXOP && folded; o++)
+            {
+                for (uint8 field = fill_reg; field <= fill_specval && folded; field++)
+                {
+                    uval_t va = get_fill_field(a.ops[o], field);
+                    uval_t vb = get_fill_field(b.ops[o], field);
+                    if (va == vb) continue;
+
+                    uint8 write_slot = va & 0xff;
+                    folded = write_slot < slot && num_writes < (int)qnumber(writes)
+                        && va == ((field == fill_reg ? 0xff00 : 0xfeed0000) | write_slot)
+                        && vb == ((field == fill_reg ? 0xfe00 : 0xface0000) | write_slot);
+                    if (!folded) break;
+
+                    set_fill_field(a.ops[o], field, 0);
+                    writes[num_writes++] = { write_slot, (uint8)o, field };
+                }
+            }
+
+            if (folded)
+            {
+                plan.itype = a.itype;
+                plan.flags = a.flags;
+                std::copy(writes, writes + num_writes, plan.writes);
+                plan.num_writes = num_writes;
+                std::copy(a.ops, a.ops + UA_MAXOP, plan.ops);
+            }
+        }
+
+        if (!folded)
+        {
+            plan.runtime_post = true;
+            plan.flags = layout.flags;
+            std::copy(layout.ops, layout.ops + UA_MAXOP, plan.ops);
+        }
+
+        // ops past the last one in use are left as they are in a fresh insn_t.
+        plan.num_ops = 0;
+        for (int o = 0; o < UA_MAXOP; o++)
+        {
+            if (plan.ops[o].type != o_void || plan.ops[o].dtype != 0) plan.num_ops = o + 1;
         }
+        for (int w = 0; w < plan.num_writes; w++)
+        {
+            plan.num_ops = std::max<uint8>(plan.num_ops, plan.writes[w].op + 1);
+        }
+    }
+}
+
+size_t plugin_ctx_t::fill_insn(insn_t &insn, const struct nanomips_opcode& op, const nanomips_decoded_op* operands, size_t size)
+{
+    const fill_plan_t& plan = fill_plans[&op - nanomips_opcodes];
+    set_insn_opcode(insn, op);
+    insn.itype = plan.itype;
+    if (insn.itype == nMIPS_todo) return size;
+
+    insn.flags |= plan.flags;
+    std::copy(plan.ops, plan.ops + plan.num_ops, insn.ops);
+
+    uval_t vals[2 * MAX_NUM_OPS];
+    int num_vals = 0;
+    for (int i = 0; i < plan.num_operands; i++)
+    {
+        num_vals += operand_values(op, operands[plan.operands[i]], &vals[num_vals]);
+    }
+
+    for (int i = 0; i < plan.num_writes; i++)
+    {
+        const fill_write_t& write = plan.writes[i];
+        set_fill_field(insn.ops[write.op], write.field, vals[write.slot]);
     }
 
-    return next_idx;
+    // so that post process can modify this.
+    insn.size = size;
+    if (plan.runtime_post) post_process(insn);
 
+    return insn.size;
+}
+
+size_t plugin_ctx_t::decode(ea_t ea, const struct nanomips_opcode** op, nanomips_decoded_op* operands)
+{
+    size_t size = 0;
+    // the index was decoded without relocations, the decode cache takes care of those.
+    // it was also decoded from the database, not the memory of a debugged process.
+    if (!mirror.debugging() && !reloc_index.may_cover(ea, ea + 6) && insn_index.lookup(ea, op, operands, &size)) return size;
+    return decode_cache.decode(ea, op, operands);
 }
 
 //--------------------------------------------------------------------------
@@ -540,57 +717,33 @@ size_t plugin_ctx_t::ana(insn_t &insn)
     // LOG("Ana 0x%x", insn.ea);
 
     // check if this should be a fake jrc
-    auto it = fake_secondary_insn.find(insn.ea);
-    if (it != fake_secondary_insn.end())
+    const fake_secondary_t* secondary = fake_secondary_insn.find(insn.ea);
+    if (secondary != nullptr)
     {
-        insn.itype = it->second.itype;
-        insn.Op1 = it->second.Op1;
-        insn.Op2 = it->second.Op2;
-        insn.Op3 = it->second.Op3;
-        insn.Op4 = it->second.Op4;
-        insn.size = it->second.size;
+        secondary->fill(insn);
         return insn.size;
     }
 
-    struct nanomips_opcode op = {};
+    const struct nanomips_opcode* op = nullptr;
     nanomips_decoded_op operands[MAX_NUM_OPS] = {};
-    size_t insn_size = nanomips_disasm_instr(insn.ea, &disasm_info, &op, operands);
+    size_t insn_size = decode(insn.ea, &op, operands);
     // LOG("Decoded instruction of size: %d", insn_size);
     if (insn_size <= 0) return insn_size;
 
-    bool remapped = fill_opcode(insn, op);
-    if (!remapped) return insn_size;
-
-    int op_idx = 0;
-
-    for (int i = 0; i < MAX_NUM_OPS; i++) {
-        nanomips_decoded_op curr_op = operands[i];
-        if (curr_op.op == NULL) break;
-
-        // don't care operand, we should skip!
-        if (curr_op.op->type == OP_DONT_CARE) {
-            continue;
-        }
-
-        op_idx = fill_operand(insn, op, curr_op, op_idx);
-    }
-
-    // so that post process can modify this.
-    insn.size = insn_size;
-
-    post_process(insn);
-
-    return insn.size;
+    return fill_insn(insn, *op, operands, insn_size);
 }
 
-insn_t* plugin_ctx_t::add_fake_secondary(insn_t &curr)
+void plugin_ctx_t::add_fake_secondary(insn_t &curr, uint16 itype, optype_t optype, op_dtype_t dtype, ea_t value)
 {
-    ea_t fake_ea = curr.ea + 1;
-    insn_t* ret = &fake_secondary_insn[fake_ea];
-    ret->size = curr.size - 1;
+    fake_secondary_t secondary;
+    secondary.ea = curr.ea + 1;
+    secondary.value = value;
+    secondary.itype = itype;
+    secondary.size = curr.size - 1;
+    secondary.optype = optype;
+    secondary.dtype = dtype;
+    fake_secondary_insn.add(secondary);
     curr.size = 1;
-
-    return ret;
 }
 
 void encode_phrase(op_t& op, int base, int scale)
@@ -602,7 +755,6 @@ void encode_phrase(op_t& op, int base, int scale)
 
 void plugin_ctx_t::post_process(insn_t &insn)
 {
-    insn_t* secondary = nullptr;
     switch (insn.itype) {
         case MIPS_lw:
         case MIPS_lb:
@@ -677,23 +829,16 @@ void plugin_ctx_t::post_process(insn_t &insn)
         break;
 
         case nMIPS_move_balc:
-            secondary = add_fake_secondary(insn);
+            // 3rd op should be address here.
+            add_fake_secondary(insn, MIPS_bal, o_near, insn.Op3.dtype, insn.Op3.addr);
             insn.itype = MIPS_move;
-            secondary->itype = MIPS_bal;
-            secondary->Op1 = insn.Op3; // 3rd op should be address here.
-            secondary->Op1.type = o_near;
             insn.Op3.type = o_void;
         break;
 
         // convert into a restore, followed by a jrc instruction.
         // restore also needs to have an empty first op.
         case nMIPS_restore_jrc:
-            secondary = add_fake_secondary(insn);
-            secondary->itype = MIPS_jrc;
-            secondary->Op1.type = o_reg;
-            secondary->Op1.reg = RA;
-            secondary->Op1.dtype = dt_word;
-            secondary->Op1.set_shown();
+            add_fake_secondary(insn, MIPS_jrc, o_reg, dt_word, RA);
             insn.itype = MIPS_restore;
         case MIPS_save:
         case MIPS_restore:
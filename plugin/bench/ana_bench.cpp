@@ -0,0 +1,351 @@
+// Benchmark of the analysis hooks, plugin_ctx_t::ana and emu, linked against the SDK stand-in in sdk/.
+// The allocated sections of an ELF file are loaded as the database, and every instruction
+// of the executable ones goes through each stage in address order, the way autoanalysis visits them.
+// Output follows Google Benchmark, except that times are per instruction instead of per iteration.
+//
+// The instruction index is built once more on a larger image, made by repeating the code, with different numbers of threads.
+//
+// usage: nmips_ana_bench [elf file] [minimum seconds per benchmark]
+
+#include "nmips.hpp"
+#include "log.hpp"
+#include "standin_db.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define PREDECODE_BYTES (16 << 20)
+
+static const int predecode_threads[] = { 1, 2, 4, 8, 16 };
+
+static double min_time = 0.5;
+static volatile size_t sink;
+
+static double now_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Runs setup + pass until at least min_time seconds were spent in pass, and prints the time per item.
+ * @param setup Called before every pass, not timed.
+ */
+template<class Setup, class Pass>
+static void run_benchmark(const char* name, size_t items, Setup setup, Pass pass)
+{
+    setup();
+    pass();
+
+    double wall = 0, cpu = 0;
+    size_t iterations = 0;
+    while (wall < min_time * 1e9)
+    {
+        setup();
+        double wall_start = now_ns(CLOCK_MONOTONIC);
+        double cpu_start = now_ns(CLOCK_PROCESS_CPUTIME_ID);
+        pass();
+        cpu += now_ns(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+        wall += now_ns(CLOCK_MONOTONIC) - wall_start;
+        iterations++;
+    }
+
+    double total = (double)items * iterations;
+    printf("%-24s %10.1f ns %12.1f ns %12zu %10.2fM/s\n", name, wall / total, cpu / total, iterations, total / cpu * 1e3);
+}
+
+template<class Pass>
+static void run_benchmark(const char* name, size_t items, Pass pass)
+{
+    run_benchmark(name, items, [] {}, pass);
+}
+
+/**
+ * @brief Addresses of all instructions in the executable segments, including the secondary half of combined instructions.
+ */
+static eavec_t collect_insns(plugin_ctx_t* ctx)
+{
+    eavec_t eas;
+    for (int i = 0; i < get_segm_qty(); i++)
+    {
+        segment_t* seg = getnseg(i);
+        if ((seg->perm & SEGPERM_EXEC) == 0) continue;
+
+        ea_t ea = seg->start_ea;
+        while (ea + 2 <= seg->end_ea)
+        {
+            insn_t insn;
+            insn.ea = ea;
+            size_t size = ctx->ana(insn);
+            eas.push_back(ea);
+            // combined instructions are split in two, the second half starts at ea + 1.
+            if (size == 1)
+            {
+                eas.push_back(ea + 1);
+                insn.ea = ea + 1;
+                size += ctx->ana(insn);
+            }
+            ea += size != 0 ? size : 2;
+        }
+    }
+    return eas;
+}
+
+/**
+ * @brief Number of instructions the index decodes differently from the decode cache.
+ */
+static size_t check_index(plugin_ctx_t* ctx, const eavec_t& eas)
+{
+    size_t mismatches = 0;
+    for (ea_t ea : eas)
+    {
+        const struct nanomips_opcode* indexed_op = nullptr;
+        const struct nanomips_opcode* cached_op = nullptr;
+        nanomips_decoded_op indexed[MAX_NUM_OPS] = {};
+        nanomips_decoded_op cached[MAX_NUM_OPS] = {};
+        size_t indexed_size = 0;
+        if (!ctx->insn_index.lookup(ea, &indexed_op, indexed, &indexed_size)) continue;
+        size_t cached_size = ctx->decode_cache.decode(ea, &cached_op, cached);
+        if (indexed_size != cached_size || (cached_size != 0 && indexed_op != cached_op))
+        {
+            mismatches++;
+            continue;
+        }
+        for (int i = 0; i < MAX_NUM_OPS; i++)
+        {
+            if (indexed[i].op != cached[i].op || indexed[i].val != cached[i].val)
+            {
+                mismatches++;
+                break;
+            }
+        }
+    }
+    return mismatches;
+}
+
+/**
+ * @brief Builds the instruction index of an image made by repeating the code segments, with different numbers of threads.
+ */
+static void bench_predecode(plugin_ctx_t* ctx)
+{
+    bytevec_t code;
+    for (int i = 0; i < get_segm_qty(); i++)
+    {
+        segment_t* seg = getnseg(i);
+        if ((seg->perm & SEGPERM_EXEC) == 0) continue;
+        size_t pos = code.size();
+        code.resize(pos + seg->size());
+        ssize_t nbytes = get_bytes(&code[pos], seg->size(), seg->start_ea);
+        code.resize(pos + (nbytes > 0 ? nbytes & ~1 : 0));
+    }
+    if (code.empty()) return;
+
+    bytevec_t image;
+    image.resize(PREDECODE_BYTES);
+    for (size_t pos = 0; pos < image.size(); pos += code.size())
+    {
+        memcpy(&image[pos], &code[0], std::min(code.size(), image.size() - pos));
+    }
+
+    printf("\ninstruction index of %d MiB:\n", PREDECODE_BYTES >> 20);
+    for (int threads : predecode_threads)
+    {
+        insn_index_t index(ctx->decoder);
+        size_t count = index.build_segment(0x10000000, &image[0], image.size(), threads);
+        char name[64];
+        qsnprintf(name, sizeof(name), "BM_predecode/threads:%d", threads);
+        run_benchmark(name, count, [&] { index.clear(); }, [&] {
+            sink = index.build_segment(0x10000000, &image[0], image.size(), threads);
+        });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = argc > 1 ? argv[1] : "babymips";
+    if (argc > 2) min_time = atof(argv[2]);
+    loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+
+    if (!standin_load_elf(path))
+    {
+        fprintf(stderr, "cannot load %s\n", path);
+        return 1;
+    }
+
+    plugin_ctx_t* ctx = new plugin_ctx_t;
+    eavec_t eas = collect_insns(ctx);
+    if (eas.empty())
+    {
+        fprintf(stderr, "%s has no executable sections\n", path);
+        return 1;
+    }
+
+    qvector<insn_t> insns;
+    insns.resize(eas.size());
+    for (size_t i = 0; i < eas.size(); i++)
+    {
+        insns[i].ea = eas[i];
+        ctx->ana(insns[i]);
+    }
+
+    printf("%s: %zu instructions\n", path, eas.size());
+    printf("%-24s %13s %15s %12s %11s\n", "Benchmark", "Time", "CPU", "Iterations", "insn/s");
+    printf("%s\n", std::string(78, '-').c_str());
+
+    run_benchmark("BM_decode/cold", eas.size(), [&] { ctx->decode_cache.clear(); }, [&] {
+        size_t total = 0;
+        for (ea_t ea : eas)
+        {
+            const struct nanomips_opcode* op = nullptr;
+            nanomips_decoded_op operands[MAX_NUM_OPS] = {};
+            total += ctx->decode(ea, &op, operands);
+        }
+        sink = total;
+    });
+
+    run_benchmark("BM_decode/cached", eas.size(), [&] {
+        size_t total = 0;
+        for (ea_t ea : eas)
+        {
+            const struct nanomips_opcode* op = nullptr;
+            nanomips_decoded_op operands[MAX_NUM_OPS] = {};
+            total += ctx->decode(ea, &op, operands);
+        }
+        sink = total;
+    });
+
+    run_benchmark("BM_ana", eas.size(), [&] {
+        size_t total = 0;
+        for (ea_t ea : eas)
+        {
+            insn_t insn;
+            insn.ea = ea;
+            total += ctx->ana(insn);
+        }
+        sink = total;
+    });
+
+    run_benchmark("BM_emu", insns.size(), standin_clear_xrefs, [&] {
+        size_t total = 0;
+        for (insn_t& insn : insns)
+        {
+            total += ctx->emu(insn);
+        }
+        sink = total;
+    });
+
+    // may_be_func looks at the crefs emu added.
+    run_benchmark("BM_may_be_func", insns.size(), [&] {
+        size_t total = 0;
+        for (insn_t& insn : insns)
+        {
+            total += ctx->may_be_func(&insn, 1);
+        }
+        sink = total;
+    });
+
+    run_benchmark("BM_ana_emu", eas.size(), standin_clear_xrefs, [&] {
+        size_t total = 0;
+        for (ea_t ea : eas)
+        {
+            insn_t insn;
+            insn.ea = ea;
+            if (ctx->ana(insn) != 0) total += ctx->emu(insn);
+        }
+        sink = total;
+    });
+
+    // ana on the instruction index, as after loading an ELF file.
+    ctx->insn_index.build();
+    size_t mismatches = check_index(ctx, eas);
+
+    run_benchmark("BM_decode/indexed", eas.size(), [&] {
+        size_t total = 0;
+        for (ea_t ea : eas)
+        {
+            const struct nanomips_opcode* op = nullptr;
+            nanomips_decoded_op operands[MAX_NUM_OPS] = {};
+            total += ctx->decode(ea, &op, operands);
+        }
+        sink = total;
+    });
+
+    run_benchmark("BM_ana/indexed", eas.size(), [&] {
+        size_t total = 0;
+        for (ea_t ea : eas)
+        {
+            insn_t insn;
+            insn.ea = ea;
+            total += ctx->ana(insn);
+        }
+        sink = total;
+    });
+
+    printf("\ninstruction index: %llu hits, %llu misses%s\n",
+        (unsigned long long)ctx->insn_index.hits, (unsigned long long)ctx->insn_index.misses, mismatches == 0 ? "" : " MISMATCH");
+
+    // an unapplied relocation on every 16th instruction, as in a relocatable object.
+    for (size_t i = 0; i < eas.size(); i += 16)
+    {
+        ctx->reloc_index.add(eas[i]);
+    }
+    ctx->reloc_index.build();
+    run_benchmark("BM_decode/relocated", eas.size(), [&] {
+        size_t total = 0;
+        for (ea_t ea : eas)
+        {
+            const struct nanomips_opcode* op = nullptr;
+            nanomips_decoded_op operands[MAX_NUM_OPS] = {};
+            total += ctx->decode(ea, &op, operands);
+        }
+        sink = total;
+    });
+
+    printf("\nrelocations: %llu instructions decoded with one\n", (unsigned long long)ctx->reloc_index.hits);
+    ctx->reloc_index.clear();
+    ctx->insn_index.clear();
+
+    // function discovery after loading, may_be_func looks up the candidates before walking the crefs.
+    size_t num_funcs = ctx->func_finder.discover();
+    run_benchmark("BM_find_funcs", eas.size(), [&] {
+        sink = ctx->func_finder.discover();
+    });
+
+    run_benchmark("BM_may_be_func/swept", insns.size(), [&] {
+        size_t total = 0;
+        for (insn_t& insn : insns)
+        {
+            total += ctx->may_be_func(&insn, 1);
+        }
+        sink = total;
+    });
+
+    printf("\nfunction finder: %zu function starts, %zu confirmed and planned\n", num_funcs, standin_num_procs());
+
+    // brsc tables resolved after loading, and is_switch for every instruction once everything is cached.
+    size_t num_switches = ctx->switch_cache.scan();
+    run_benchmark("BM_find_switches", eas.size(), [&] {
+        sink = ctx->switch_cache.scan();
+    });
+
+    run_benchmark("BM_is_switch/cached", insns.size(), [&] {
+        size_t total = 0;
+        for (insn_t& insn : insns)
+        {
+            switch_info_t si;
+            total += ctx->is_switch(&si, &insn);
+        }
+        sink = total;
+    });
+
+    printf("\nswitch cache: %zu switch tables, %llu hits, %llu misses\n", num_switches,
+        (unsigned long long)ctx->switch_cache.hits, (unsigned long long)ctx->switch_cache.misses);
+
+    bench_predecode(ctx);
+
+    printf("\ndecode cache: %llu hits, %llu misses, %zu xrefs\n",
+        (unsigned long long)ctx->decode_cache.hits, (unsigned long long)ctx->decode_cache.misses, standin_num_xrefs());
+    delete ctx;
+    return 0;
+}
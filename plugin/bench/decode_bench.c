@@ -0,0 +1,277 @@
+/* Throughput benchmark for the nanoMIPS decoder.
+   Decodes the executable sections of an ELF file, both one instruction at a
+   time through nanomips_decode and in bulk through nanomips_decode_range.
+   Length classification is measured on a larger buffer made by repeating
+   those sections, roughly the size of a firmware image.
+
+   usage: nmips_decode_bench [elf file] [iterations]  */
+
+#include "nanomips-dis.h"
+#include "nanomips-len.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SHF_EXECINSTR 0x4
+#define CLASSIFY_BYTES (16 << 20)
+#define CLASSIFY_PASSES 20
+
+struct section
+{
+    const uint8_t *bytes;
+    size_t size;
+    uint32_t addr;
+};
+
+static double
+now_ns (void)
+{
+    struct timespec ts;
+    timespec_get (&ts, TIME_UTC);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t
+read32 (const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint16_t
+read16 (const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+/* Collect the executable sections of a little-endian ELF32 file.  */
+static size_t
+find_sections (const uint8_t *file, size_t size, struct section *out, size_t max)
+{
+    uint32_t shoff;
+    uint16_t shentsize, shnum, i;
+    size_t count = 0;
+
+    if (size < 52 || file[0] != 0x7f || file[1] != 'E' || file[4] != 1 || file[5] != 1)
+        return 0;
+
+    shoff = read32 (file + 32);
+    shentsize = read16 (file + 46);
+    shnum = read16 (file + 48);
+    for (i = 0; i < shnum && count < max; i++)
+    {
+        const uint8_t *sh = file + shoff + (size_t) i * shentsize;
+        uint32_t flags, addr, offset, sh_size;
+
+        if (sh + 40 > file + size)
+            break;
+        flags = read32 (sh + 8);
+        addr = read32 (sh + 12);
+        offset = read32 (sh + 16);
+        sh_size = read32 (sh + 20);
+        if ((flags & SHF_EXECINSTR) == 0 || (size_t) offset + sh_size > size)
+            continue;
+
+        out[count].bytes = file + offset;
+        out[count].size = sh_size;
+        out[count].addr = addr;
+        count++;
+    }
+    return count;
+}
+
+static void
+bench_classify (const struct section *sections, size_t num_sections)
+{
+    uint8_t *buf = malloc (CLASSIFY_BYTES);
+    uint8_t *lengths = malloc (CLASSIFY_BYTES / 2);
+    uint8_t *expected = malloc (CLASSIFY_BYTES / 2);
+    uint32_t *starts = malloc (CLASSIFY_BYTES / 2 * sizeof (*starts));
+    size_t pos = 0, s = 0, num_starts = 0;
+    double start, scalar_ns, kernel_ns, walk_ns;
+    char label[32];
+    int r;
+
+    while (pos < CLASSIFY_BYTES)
+    {
+        size_t n = sections[s].size & ~(size_t) 1;
+        if (n > CLASSIFY_BYTES - pos)
+            n = CLASSIFY_BYTES - pos;
+        memcpy (buf + pos, sections[s].bytes, n);
+        pos += n;
+        s = (s + 1) % num_sections;
+    }
+
+    start = now_ns ();
+    for (r = 0; r < CLASSIFY_PASSES; r++)
+        nanomips_classify_lengths_scalar (buf, CLASSIFY_BYTES, 0, expected);
+    scalar_ns = (now_ns () - start) / CLASSIFY_PASSES;
+
+    start = now_ns ();
+    for (r = 0; r < CLASSIFY_PASSES; r++)
+        nanomips_classify_lengths (buf, CLASSIFY_BYTES, 0, lengths);
+    kernel_ns = (now_ns () - start) / CLASSIFY_PASSES;
+
+    start = now_ns ();
+    for (r = 0; r < CLASSIFY_PASSES; r++)
+        num_starts = nanomips_insn_starts (lengths, CLASSIFY_BYTES / 2, 0, starts, CLASSIFY_BYTES / 2);
+    walk_ns = (now_ns () - start) / CLASSIFY_PASSES;
+
+    printf ("length classification of %d MiB:\n", CLASSIFY_BYTES >> 20);
+    printf ("  %-12s %8.2f ms %8.2f GB/s\n", "scalar:", scalar_ns / 1e6, CLASSIFY_BYTES / scalar_ns);
+    snprintf (label, sizeof (label), "%s:", nanomips_classify_lengths_kernel ());
+    printf ("  %-12s %8.2f ms %8.2f GB/s%s\n", label, kernel_ns / 1e6, CLASSIFY_BYTES / kernel_ns,
+            memcmp (lengths, expected, CLASSIFY_BYTES / 2) == 0 ? "" : " MISMATCH");
+    printf ("  %-12s %8.2f ms (%zu instructions)\n", "start walk:", walk_ns / 1e6, num_starts);
+
+    free (starts);
+    free (expected);
+    free (lengths);
+    free (buf);
+}
+
+/* nanomips_decode on the instructions of each length separately, the
+   16-bit ones mostly go through the lookup table.  */
+static void
+bench_by_length (const struct section *sections, size_t num_sections, const nanomips_decoder *decoder,
+                 nanomips_insn_stream *stream, long iterations)
+{
+    static const unsigned int lengths[] = { 2, 4, 6 };
+    nanomips_decoded_op operands[NANOMIPS_STREAM_MAX_OPS];
+    nanomips_decode_result result;
+    size_t total = 0, s, i, l;
+    uint32_t *section_of, *offset_of;
+
+    for (s = 0; s < num_sections; s++)
+        total += sections[s].size / 2;
+    section_of = malloc (total * sizeof (uint32_t));
+    offset_of = malloc (total * sizeof (uint32_t));
+
+    printf ("nanomips_decode by length:\n");
+    for (l = 0; l < sizeof (lengths) / sizeof (lengths[0]); l++)
+    {
+        size_t count = 0;
+        long r;
+        double start, ns;
+
+        for (s = 0; s < num_sections; s++)
+        {
+            nanomips_decode_range (decoder, sections[s].bytes, sections[s].size, sections[s].addr, stream);
+            for (i = 0; i < stream->count; i++)
+            {
+                if (stream->length[i] != lengths[l] || stream->opcode[i] == NANOMIPS_STREAM_INVALID)
+                    continue;
+                section_of[count] = s;
+                offset_of[count] = stream->offset[i];
+                count++;
+            }
+        }
+        if (count == 0)
+            continue;
+
+        start = now_ns ();
+        for (r = 0; r < iterations; r++)
+            for (i = 0; i < count; i++)
+            {
+                const struct section *sec = &sections[section_of[i]];
+                nanomips_decode (decoder, sec->bytes + offset_of[i], sec->size - offset_of[i],
+                                 sec->addr + offset_of[i], 0, &result, operands);
+            }
+        ns = (now_ns () - start) / ((double) count * iterations);
+        printf ("  %2u-bit: %6.1f ns/insn %8.2f Minsn/s\n", lengths[l] * 8, ns, 1e3 / ns);
+    }
+
+    free (section_of);
+    free (offset_of);
+}
+
+int
+main (int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "babymips";
+    long iterations = argc > 2 ? atol (argv[2]) : 20000;
+    struct section sections[16];
+    size_t num_sections, s, size;
+    nanomips_insn_stream stream;
+    nanomips_decoder decoder;
+    nanomips_decoded_op operands[NANOMIPS_STREAM_MAX_OPS];
+    nanomips_decode_result result;
+    size_t by_length[7] = {0};
+    long insns, r;
+    double start, single_ns, range_ns;
+    uint8_t *file;
+    FILE *f;
+
+    f = fopen (path, "rb");
+    if (f == NULL)
+    {
+        fprintf (stderr, "cannot open %s\n", path);
+        return 1;
+    }
+    fseek (f, 0, SEEK_END);
+    size = ftell (f);
+    rewind (f);
+    file = malloc (size);
+    if (fread (file, 1, size, f) != size)
+    {
+        fprintf (stderr, "cannot read %s\n", path);
+        return 1;
+    }
+    fclose (f);
+
+    num_sections = find_sections (file, size, sections, 16);
+    if (num_sections == 0)
+    {
+        fprintf (stderr, "%s has no executable sections\n", path);
+        return 1;
+    }
+
+    decoder.big_endian = 0;
+    nanomips_init_dispatch ();
+    nanomips_stream_init (&stream);
+
+    insns = 0;
+    start = now_ns ();
+    for (r = 0; r < iterations; r++)
+        for (s = 0; s < num_sections; s++)
+        {
+            size_t pos = 0, length;
+            while (sections[s].size - pos >= 2)
+            {
+                length = nanomips_decode (&decoder, sections[s].bytes + pos, sections[s].size - pos,
+                                          sections[s].addr + pos, 0, &result, operands);
+                pos += length ? length : 2;
+                insns++;
+            }
+        }
+    single_ns = (now_ns () - start) / insns;
+
+    insns = 0;
+    start = now_ns ();
+    for (r = 0; r < iterations; r++)
+        for (s = 0; s < num_sections; s++)
+            insns += nanomips_decode_range (&decoder, sections[s].bytes, sections[s].size,
+                                            sections[s].addr, &stream);
+    range_ns = (now_ns () - start) / insns;
+
+    for (s = 0; s < num_sections; s++)
+    {
+        size_t i;
+        nanomips_decode_range (&decoder, sections[s].bytes, sections[s].size, sections[s].addr, &stream);
+        for (i = 0; i < stream.count; i++)
+            by_length[stream.opcode[i] == NANOMIPS_STREAM_INVALID ? 0 : stream.length[i]]++;
+    }
+
+    printf ("%s: %zu executable sections, %ld passes\n", path, num_sections, iterations);
+    printf ("instructions: %zu 16-bit, %zu 32-bit, %zu 48-bit, %zu invalid\n",
+            by_length[2], by_length[4], by_length[6], by_length[0]);
+    printf ("nanomips_decode:       %6.1f ns/insn %8.2f Minsn/s\n", single_ns, 1e3 / single_ns);
+    printf ("nanomips_decode_range: %6.1f ns/insn %8.2f Minsn/s\n", range_ns, 1e3 / range_ns);
+
+    bench_by_length (sections, num_sections, &decoder, &stream, iterations);
+    bench_classify (sections, num_sections);
+
+    nanomips_stream_free (&stream);
+    free (file);
+    return 0;
+}
@@ -0,0 +1,93 @@
+// The plugin_ctx_t members defined in nmips.cpp, mopt.cpp and gdb.cpp need the full SDK (ELF loader, hexrays, UI).
+// The analysis benchmark links these instead, which only do what ana and emu depend on.
+
+#include "nmips.hpp"
+#include "log.hpp"
+
+uint32 get_feature(insn_t& insn)
+{
+    if (insn.itype >= CUSTOM_INSN_ITYPE) {
+        const nanomips_insn_t* info = get_nanomips_insn(insn.itype);
+        return info != nullptr ? info->features : 0;
+    }
+
+    return insn.get_canon_feature(PH);
+}
+
+static int standin_read_memory(bfd_vma memaddr, bfd_byte* myaddr, unsigned int length, struct disassemble_info* info)
+{
+    segment_mirror_t* mirror = (segment_mirror_t*)info->application_data;
+    return mirror->read(memaddr, myaddr, length) < length ? EIO : 0;
+}
+
+static int standin_printf(void*, const char* fmt, ...)
+{
+    return 0;
+}
+
+plugin_ctx_t::plugin_ctx_t()
+{
+    hook_event_listener(HT_IDP, this);
+
+    init_disassemble_info(&disasm_info, NULL, standin_printf);
+    disasm_info.arch = bfd_arch_nanomips;
+    disasm_info.mach = bfd_mach_nanomipsisa32r6;
+
+    disasm_info.read_memory_func = standin_read_memory;
+    disasm_info.application_data = &mirror;
+
+    disassemble_init_for_target(&disasm_info);
+    decoder.big_endian = disasm_info.endian == BFD_ENDIAN_BIG;
+    nanomips_init_dispatch();
+    build_opcode_itypes();
+    build_fill_plans();
+    decode_cache.resize(decode_cache_default_bits);
+
+    mirror.enable_hooks(true);
+    reloc_index.enable_hooks(true);
+    decode_cache.enable_hooks(true);
+    insn_index.enable_hooks(true);
+    func_finder.enable_hooks(true);
+    switch_cache.enable_hooks(true);
+    fake_secondary_insn.enable_hooks(true);
+    hooked = true;
+}
+
+plugin_ctx_t::~plugin_ctx_t()
+{
+    mirror.enable_hooks(false);
+    reloc_index.enable_hooks(false);
+    decode_cache.enable_hooks(false);
+    insn_index.enable_hooks(false);
+    func_finder.enable_hooks(false);
+    switch_cache.enable_hooks(false);
+    fake_secondary_insn.enable_hooks(false);
+    unhook_event_listener(HT_IDP, this);
+    log_shutdown();
+}
+
+bool idaapi plugin_ctx_t::run(size_t)
+{
+    return true;
+}
+
+ssize_t idaapi plugin_ctx_t::on_event(ssize_t code, va_list va)
+{
+    return 0;
+}
+
+void plugin_ctx_t::ensure_mgen_installed()
+{
+    // there is no decompiler.
+    did_check_hexx = true;
+}
+
+int idaapi large_stk_opt_t::func(mblock_t* blk, minsn_t* ins, int optflags)
+{
+    return 0;
+}
+
+int idaapi config_gdb_plugin_t::activate(action_activation_ctx_t*)
+{
+    return 0;
+}
@@ -0,0 +1,273 @@
+/* Checks and benchmarks the nanoMIPS relocation engine.
+   Every instruction relocation is first applied to a matching instruction
+   over its whole range, and the decoder has to read back the same value.
+   Then each ELF file given is mapped, its relocations are read and applied
+   to a copy of its sections, as often as fits into the time given.
+
+   usage: nmips_reloc_bench [seconds] elf files...  */
+
+#include "nanomips-dis.h"
+#include "nanomips-reloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SHT_NOBITS 8
+#define SHF_ALLOC 0x2
+#define CHECK_GP 0x00428000u
+#define CHECK_PC 0x00410000u
+
+/* What S + A is relative to, the decoder reads back the target of
+   PC-relative instructions and the offset from GP of the others.  */
+enum check_base { BASE_NONE, BASE_PC, BASE_GP };
+
+struct reloc_check
+{
+    unsigned int type;
+    /* The instruction, with the field cleared.  */
+    uint32_t insn;
+    unsigned int length;
+    enum check_base base;
+    /* Range of values to try in the field, and the step between them.  */
+    int32_t min, max, step;
+};
+
+static const struct reloc_check checks[] = {
+    { R_NANOMIPS_PC25_S1, 0x28000000, 4, BASE_PC, -(1 << 25), (1 << 25) - 2, 2046 },     /* bc */
+    { R_NANOMIPS_PC21_S1, 0x04800000, 4, BASE_PC, -(1 << 21), (1 << 21) - 2, 126 },      /* lapc */
+    { R_NANOMIPS_PC14_S1, 0xa8850000, 4, BASE_PC, -(1 << 14), (1 << 14) - 2, 2 },        /* bnec */
+    { R_NANOMIPS_PC11_S1, 0xc88c1800, 4, BASE_PC, -(1 << 11), (1 << 11) - 2, 2 },        /* bgeiuc */
+    { R_NANOMIPS_PC10_S1, 0x1800, 2, BASE_PC, -(1 << 10), (1 << 10) - 2, 2 },            /* bc[16] */
+    { R_NANOMIPS_PC7_S1, 0x9880, 2, BASE_PC, -(1 << 7), (1 << 7) - 2, 2 },               /* beqzc[16] */
+    { R_NANOMIPS_PC4_S1, 0xd8a0, 2, BASE_PC, 2, 30, 2 },                                 /* beqc[16] */
+    { R_NANOMIPS_GPREL19_S2, 0x40800002, 4, BASE_GP, 0, (1 << 21) - 4, 4 },              /* lw[gp] */
+    { R_NANOMIPS_GPREL18, 0x448c0000, 4, BASE_GP, 0, (1 << 18) - 1, 1 },                 /* addiu[gp.b] */
+    { R_NANOMIPS_GPREL17_S1, 0x44900000, 4, BASE_GP, 0, (1 << 18) - 2, 2 },              /* lh[gp] */
+    { R_NANOMIPS_GPREL7_S2, 0x5480, 2, BASE_GP, 0, (1 << 9) - 4, 4 },                    /* lw[gp16] */
+    { R_NANOMIPS_HI20, 0xe0800000, 4, BASE_NONE, INT32_MIN, INT32_MAX - 0xfff, 0x3fff000 }, /* lui */
+    { R_NANOMIPS_GPREL_HI20, 0xe0800000, 4, BASE_GP, 0, INT32_MAX - 0xfff, 0x3fff000 },  /* lui */
+    /* The decoder gets ALUIPC wrong beyond 512 KiB, so only that much is checked.  */
+    { R_NANOMIPS_PCHI20, 0xe0800002, 4, BASE_PC, -(1 << 19), (1 << 19) - 0x1000, 0x1000 }, /* aluipc */
+    { R_NANOMIPS_LO12, 0x84858000, 4, BASE_NONE, 0, 0xfff, 1 },                          /* lw[u12] */
+    { R_NANOMIPS_GPREL_LO12, 0x84858000, 4, BASE_GP, 0, 0xfff, 1 },                      /* lw[u12] */
+    { R_NANOMIPS_I32, 0x6080, 6, BASE_NONE, INT32_MIN, INT32_MAX, 0x3ffffff },           /* li[48] */
+    { R_NANOMIPS_PC_I32, 0x6083, 6, BASE_PC, INT32_MIN, INT32_MAX - 6, 0x3ffffff },      /* lapc[48] */
+    { R_NANOMIPS_GPREL_I32, 0x6082, 6, BASE_GP, INT32_MIN, INT32_MAX, 0x3ffffff },       /* addiu[gp48] */
+};
+
+struct loaded_section
+{
+    const uint8_t *file_bytes;
+    uint8_t *bytes;
+    uint32_t size;
+    uint32_t address;
+};
+
+static double
+now_ns (void)
+{
+    struct timespec ts;
+    timespec_get (&ts, TIME_UTC);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* The value the decoder reads back from the instruction: the target of a
+   PC-relative operand, else the first immediate.  */
+static int
+decoded_value (const nanomips_decoder *decoder, const uint8_t *bytes, unsigned int length, uint32_t *out)
+{
+    nanomips_decoded_op operands[NANOMIPS_STREAM_MAX_OPS] = { 0 };
+    nanomips_decode_result result;
+    int i;
+
+    if (nanomips_decode (decoder, bytes, length, CHECK_PC, 0, &result, operands) != length)
+        return 0;
+    if (result.target != NANOMIPS_NO_TARGET)
+    {
+        *out = result.target;
+        return 1;
+    }
+    for (i = 0; i < NANOMIPS_STREAM_MAX_OPS && operands[i].op != NULL; i++)
+    {
+        const struct nanomips_operand *op = operands[i].op;
+        unsigned int val = operands[i].val;
+
+        switch (op->type)
+        {
+        case OP_INT:
+        case OP_IMM_INT:
+            *out = nanomips_decode_int_operand ((const struct nanomips_int_operand *) op, val);
+            return 1;
+        case OP_HI20_INT:
+        case OP_HI20_SCALE:
+            *out = (uint32_t) nanomips_decode_hi20_int_operand (op, val) << 12;
+            return 1;
+        case OP_INT_WORD:
+        case OP_UINT_WORD:
+        case OP_GPREL_WORD:
+        case OP_IMM_WORD:
+            *out = ((val >> 16) & 0xffff) | (val << 16);
+            return 1;
+        default:
+            break;
+        }
+    }
+    return 0;
+}
+
+/* Apply every check over its whole range, returns the number of mismatches.  */
+static size_t
+run_checks (const nanomips_decoder *decoder)
+{
+    size_t c, total = 0, mismatches = 0;
+
+    for (c = 0; c < sizeof (checks) / sizeof (checks[0]); c++)
+    {
+        const struct reloc_check *check = &checks[c];
+        size_t count = 0, bad = 0;
+        int64_t v;
+
+        for (v = check->min; v <= check->max; v += check->step)
+        {
+            uint8_t bytes[6] = { 0 };
+            uint32_t value = (uint32_t) v, expected, decoded = 0;
+            enum nanomips_reloc_status status;
+
+            bytes[0] = check->insn >> (check->length == 4 ? 16 : 0);
+            bytes[1] = check->insn >> (check->length == 4 ? 24 : 8);
+            bytes[2] = check->insn;
+            bytes[3] = check->insn >> 8;
+
+            if (check->base == BASE_PC)
+                value += CHECK_PC + check->length;
+            else if (check->base == BASE_GP)
+                value += CHECK_GP;
+            expected = check->base == BASE_PC ? value : (uint32_t) v;
+            if (check->type == R_NANOMIPS_HI20 || check->type == R_NANOMIPS_GPREL_HI20
+                || check->type == R_NANOMIPS_PCHI20)
+                expected &= ~0xfffu;
+
+            status = nanomips_reloc_apply (decoder->big_endian, check->type, bytes, check->length, CHECK_PC,
+                                           value, CHECK_GP);
+            if (status != NANOMIPS_RELOC_OK || !decoded_value (decoder, bytes, check->length, &decoded)
+                || decoded != expected)
+            {
+                if (bad == 0)
+                    printf ("  %s: 0x%08x gives status %d, decoded 0x%08x instead of 0x%08x\n",
+                            nanomips_reloc_name (check->type), value, status, decoded, expected);
+                bad++;
+            }
+            count++;
+        }
+        total += count;
+        mismatches += bad;
+    }
+    printf ("instruction relocations: %zu values of %zu types checked against the decoder%s\n", total,
+            sizeof (checks) / sizeof (checks[0]), mismatches == 0 ? "" : " MISMATCH");
+    return mismatches;
+}
+
+static int
+bench_file (const char *path, double seconds)
+{
+    struct loaded_section *sections;
+    size_t counts[NANOMIPS_RELOC_NUM_STATUS] = { 0 }, by_type[256] = { 0 };
+    nanomips_reloc_list list;
+    nanomips_elf_section sec;
+    nanomips_elf elf;
+    uint32_t *bases, gp = NANOMIPS_RELOC_NO_GP;
+    unsigned int i, num_sections = 0;
+    double start, read_ns, apply_ns;
+    long passes = 0;
+    size_t j;
+
+    if (nanomips_elf_map (&elf, path) != 0)
+    {
+        fprintf (stderr, "cannot map %s as an ELF32 file\n", path);
+        return 1;
+    }
+
+    bases = calloc (elf.num_sections + 1, sizeof (*bases));
+    sections = calloc (elf.num_sections + 1, sizeof (*sections));
+    nanomips_elf_layout (&elf, bases);
+    for (i = 0; i < elf.num_sections; i++)
+    {
+        if (nanomips_elf_section_at (&elf, i, &sec) != 0 || (sec.flags & SHF_ALLOC) == 0 || sec.size == 0)
+            continue;
+        if (strcmp (sec.name, ".got") == 0)
+            gp = bases[i];
+        if (sec.type == SHT_NOBITS)
+            continue;
+        sections[num_sections].file_bytes = elf.data + sec.offset;
+        sections[num_sections].bytes = malloc (sec.size);
+        sections[num_sections].size = sec.size;
+        sections[num_sections].address = bases[i];
+        num_sections++;
+    }
+
+    nanomips_reloc_list_init (&list);
+    start = now_ns ();
+    if (nanomips_elf_read_relocs (&elf, bases, &list) == (size_t) -1)
+    {
+        fprintf (stderr, "out of memory reading the relocations of %s\n", path);
+        return 1;
+    }
+    nanomips_reloc_resolve (&list);
+    read_ns = now_ns () - start;
+
+    start = now_ns ();
+    do
+    {
+        for (i = 0; i < num_sections; i++)
+            memcpy (sections[i].bytes, sections[i].file_bytes, sections[i].size);
+        nanomips_reloc_resolve (&list);
+        for (i = 0; i < num_sections; i++)
+            nanomips_reloc_apply_list (elf.big_endian, &list, sections[i].bytes, sections[i].size,
+                                       sections[i].address, gp, passes == 0 ? counts : NULL);
+        passes++;
+    } while (now_ns () - start < seconds * 1e9);
+    apply_ns = (now_ns () - start) / passes;
+
+    for (j = 0; j < list.count; j++)
+        by_type[list.type[j]]++;
+
+    printf ("%s: %zu relocations, read in %.1f us, applied in %.1f us (%.1f ns each)\n", path, list.count,
+            read_ns / 1e3, apply_ns / 1e3, list.count ? apply_ns / list.count : 0.0);
+    printf ("  %zu patched, %zu ignored, %zu overflowed, %zu unsupported, %zu outside the sections\n",
+            counts[NANOMIPS_RELOC_OK], counts[NANOMIPS_RELOC_IGNORED], counts[NANOMIPS_RELOC_OVERFLOW],
+            counts[NANOMIPS_RELOC_UNSUPPORTED], list.count - counts[NANOMIPS_RELOC_OK] - counts[NANOMIPS_RELOC_IGNORED]
+            - counts[NANOMIPS_RELOC_OVERFLOW] - counts[NANOMIPS_RELOC_UNSUPPORTED]);
+    for (j = 0; j < 256; j++)
+        if (by_type[j] != 0)
+            printf ("  %-26s %zu\n", nanomips_reloc_name (j) ? nanomips_reloc_name (j) : "unknown", by_type[j]);
+
+    for (i = 0; i < num_sections; i++)
+        free (sections[i].bytes);
+    free (sections);
+    free (bases);
+    nanomips_reloc_list_free (&list);
+    nanomips_elf_unmap (&elf);
+    return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+    nanomips_decoder decoder = { 0 };
+    double seconds = 0.5;
+    int i, first = 1, failed = 0;
+
+    if (argc > 1 && strtod (argv[1], NULL) > 0)
+    {
+        seconds = strtod (argv[1], NULL);
+        first = 2;
+    }
+
+    nanomips_init_dispatch ();
+    if (run_checks (&decoder) != 0)
+        failed = 1;
+    for (i = first; i < argc; i++)
+        failed |= bench_file (argv[i], seconds);
+    return failed;
+}
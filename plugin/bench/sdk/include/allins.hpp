@@ -0,0 +1,21 @@
+#pragma once
+#include "standin.hpp"
+
+// The MIPS instructions of the SDK the plugin refers to, the values do not match the SDK.
+enum mips_itype_t : uint16
+{
+    MIPS_null = 0, MIPS_add, MIPS_addiu, MIPS_addu, MIPS_and, MIPS_andi, MIPS_b, MIPS_bal,
+    MIPS_beqz, MIPS_beqzc, MIPS_bitrev, MIPS_bnez, MIPS_bnezc, MIPS_break, MIPS_cache, MIPS_cachee,
+    MIPS_clo, MIPS_clz, MIPS_deret, MIPS_di, MIPS_div, MIPS_divu, MIPS_dvpe, MIPS_ehb, MIPS_ei,
+    MIPS_eret, MIPS_evpe, MIPS_ext, MIPS_ins, MIPS_j, MIPS_jal, MIPS_jalr_hb, MIPS_jalrc, MIPS_jrc,
+    MIPS_la, MIPS_lb, MIPS_lbe, MIPS_lbu, MIPS_lbue, MIPS_lbux, MIPS_lbx, MIPS_lh, MIPS_lhe,
+    MIPS_lhu, MIPS_lhue, MIPS_lhux, MIPS_lhx, MIPS_li, MIPS_ll, MIPS_lle, MIPS_lsa, MIPS_lw,
+    MIPS_lwe, MIPS_lwm, MIPS_lwx, MIPS_lwxs, MIPS_mfc0, MIPS_move, MIPS_movep, MIPS_movn, MIPS_movz,
+    MIPS_mtc0, MIPS_mul, MIPS_neg, MIPS_negu, MIPS_nop, MIPS_nor, MIPS_not, MIPS_or, MIPS_ori,
+    MIPS_pause, MIPS_pref, MIPS_prefe, MIPS_rdhwr, MIPS_rdpgpr, MIPS_restore, MIPS_rotr, MIPS_rotrv,
+    MIPS_save, MIPS_sb, MIPS_sbe, MIPS_sc, MIPS_sce, MIPS_sdbbp, MIPS_seb, MIPS_seh, MIPS_seqi,
+    MIPS_sh, MIPS_she, MIPS_sll, MIPS_sllv, MIPS_slt, MIPS_slti, MIPS_sltiu, MIPS_sltu, MIPS_sra,
+    MIPS_srav, MIPS_srl, MIPS_srlv, MIPS_sub, MIPS_subu, MIPS_sw, MIPS_swe, MIPS_swm, MIPS_sync,
+    MIPS_synci, MIPS_syscall, MIPS_teq, MIPS_tlbp, MIPS_tlbr, MIPS_tlbwi, MIPS_tlbwr, MIPS_tne,
+    MIPS_wait, MIPS_wrpgpr, MIPS_wsbh, MIPS_xor, MIPS_xori, MIPS_last,
+};
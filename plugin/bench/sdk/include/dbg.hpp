@@ -0,0 +1,8 @@
+#pragma once
+#include "standin.hpp"
+
+enum dbg_notification_t
+{
+    dbg_null, dbg_process_start, dbg_process_exit, dbg_process_attach, dbg_process_detach,
+};
+bool is_debugger_on();
@@ -0,0 +1,84 @@
+#pragma once
+#include "../standin.hpp"
+
+// Declarations of the ELF loader module used by elf_ldr.hpp.
+struct elf_loader_t;
+struct reader_t;
+struct reloc_tools_t;
+struct sym_rel
+{
+    qstring name;
+    qstring original_name;
+    uint64 value;
+};
+struct elf_rela_t
+{
+    uint64 r_offset;
+    uint64 r_info;
+    int64 r_addend;
+};
+struct rel_data_t
+{
+    ea_t S;
+    ea_t Sadd;
+    ea_t P;
+    uint32 type;
+    int64 A;
+};
+struct elf_shdr_t
+{
+    uint32 sh_name;
+    uint32 sh_type;
+    uint64 sh_flags;
+    uint64 sh_addr;
+    uint64 sh_offset;
+    uint64 sh_size;
+    uint32 sh_link;
+    uint32 sh_info;
+    uint64 sh_addralign;
+    uint64 sh_entsize;
+};
+typedef elf_shdr_t Elf64_Shdr;
+struct Elf64_Dyn
+{
+    int64 d_tag;
+    uint64 d_un;
+};
+struct elf_ehdr_t
+{
+    uint16 e_type;
+    uint16 e_machine;
+};
+typedef uint32 elf_sym_idx_t;
+typedef uint32 elf_shndx_t;
+
+struct proc_def_t
+{
+    proc_def_t(elf_loader_t& ldr, reader_t& reader);
+    virtual ~proc_def_t() {}
+
+    elf_loader_t& ldr;
+    reader_t& reader;
+
+    virtual const char* proc_handle_reloc(const rel_data_t& rel_data, const sym_rel* symbol, const elf_rela_t* reloc, reloc_tools_t* tools);
+    virtual bool proc_create_got_offsets(const elf_shdr_t* gotps, reloc_tools_t* tools);
+    virtual const char* proc_describe_flag_bit(uint32* e_flags);
+    virtual bool proc_load_unknown_sec(Elf64_Shdr* sh, bool force);
+    virtual int proc_handle_special_symbol(sym_rel* st, const char* name, ushort type);
+    virtual const char* proc_handle_dynamic_tag(const Elf64_Dyn* dyn);
+    virtual bool proc_is_acceptable_image_type(ushort filetype);
+    virtual void proc_on_start_data_loading(elf_ehdr_t& header);
+    virtual bool proc_on_end_data_loading();
+    virtual bool proc_handle_symbol(sym_rel& sym, const char* symname);
+    virtual void proc_handle_dynsym(const sym_rel& symrel, elf_sym_idx_t isym, const char* symname);
+    virtual bool proc_on_create_section(const elf_shdr_t& sh, const qstring& name, ea_t* sa);
+    virtual const char* calc_procname(uint32* e_flags, const char* procname);
+    virtual ea_t proc_adjust_entry(ea_t entry);
+    virtual bool proc_can_convert_pic_got() const;
+    virtual size_t proc_convert_pic_got(const segment_t* gotps, reloc_tools_t* tools);
+    virtual bool proc_should_load_section(const elf_shdr_t& sh, elf_shndx_t idx, const qstring& name);
+    virtual void proc_on_loading_symbols();
+    virtual bool proc_perform_patching(const elf_shdr_t* plt, const elf_shdr_t* gotps);
+    virtual bool proc_supports_relocs() const;
+};
+struct elf_mips_t : public proc_def_t {};
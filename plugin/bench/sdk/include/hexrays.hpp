@@ -0,0 +1,48 @@
+#pragma once
+#include "standin.hpp"
+
+// Only declarations, the microcode generator is not part of the analysis benchmark.
+struct mblock_t;
+struct minsn_t
+{
+    minsn_t(ea_t ea);
+};
+struct mop_t
+{
+    mop_t();
+    mop_t(mreg_t reg, int size);
+    mop_t(const mop_t& other, int size);
+    void make_number(uint64 value, int size);
+    void make_gvar(ea_t ea);
+};
+
+enum mcode_t { m_jle, m_jl, m_jb, m_jz, m_jae, m_jge, m_jnz, m_goto, m_xdu, m_mul, m_high };
+typedef int merror_t;
+enum { MERR_OK = 0, MERR_INSN = -2 };
+
+struct codegen_t
+{
+    insn_t insn;
+    mreg_t load_operand(int opnum);
+    minsn_t* emit(mcode_t code, int width, uval_t l, uval_t r, uval_t d, int offsize);
+    minsn_t* emit(mcode_t code, const mop_t* l, const mop_t* r, const mop_t* d);
+    bool store_operand(int n, const mop_t& mop);
+};
+
+struct microcode_filter_t
+{
+    virtual bool match(codegen_t& cdg) = 0;
+    virtual merror_t apply(codegen_t& cdg) = 0;
+};
+struct mop_visitor_t
+{
+    virtual int idaapi visit_mop(mop_t* op, const tinfo_t* type, bool is_target) = 0;
+};
+struct optinsn_t
+{
+    virtual int idaapi func(mblock_t* blk, minsn_t* ins, int optflags) = 0;
+};
+
+bool init_hexrays_plugin(int flags = 0);
+bool install_microcode_filter(microcode_filter_t* filter, bool install = true);
+void install_optinsn_handler(optinsn_t* opt);
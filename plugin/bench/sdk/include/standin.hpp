@@ -0,0 +1,472 @@
+#ifndef __NMIPS_SDK_STANDIN_H
+#define __NMIPS_SDK_STANDIN_H
+
+/**
+ * Minimal stand-in for the parts of the IDA SDK the plugin sources use, so that ana and emu can be
+ * compiled and benchmarked without IDA. Every SDK header the plugin includes forwards to this file.
+ * Declarations follow the real SDK (32 bit ea_t), but only what the plugin needs is declared,
+ * and only what the analysis benchmark calls is implemented (in ../standin.cpp).
+ * Layouts of insn_t / op_t match the SDK closely enough that the timings are representative.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+#define idaapi
+#define THREAD_SAFE
+#define AS_PRINTF(format_idx, varg_idx)
+
+//--------------------------------------------------------------------------
+// pro.h
+typedef unsigned char uchar;
+typedef unsigned short ushort;
+typedef unsigned int uint;
+typedef int8_t int8;
+typedef uint8_t uint8;
+typedef int16_t int16;
+typedef uint16_t uint16;
+typedef int32_t int32;
+typedef uint32_t uint32;
+typedef int64_t int64;
+typedef uint64_t uint64;
+
+typedef uint32 ea_t;
+typedef uint32 sel_t;
+typedef uint32 asize_t;
+typedef int32 adiff_t;
+typedef uint32 uval_t;
+typedef int32 sval_t;
+typedef uint32 nodeidx_t;
+typedef uint32 flags_t;
+typedef int error_t;
+
+#define BADADDR ea_t(-1)
+#define BADSEL sel_t(-1)
+#define qnumber(array) (sizeof(array) / sizeof((array)[0]))
+#define va_argi(va, type) ((type)va_arg(va, int))
+
+template<class T> struct qvector : public std::vector<T>
+{
+    using std::vector<T>::push_back;
+    T& push_back() { this->emplace_back(); return this->back(); }
+    void add(const T& value) { this->push_back(value); }
+    void qclear() { this->clear(); }
+};
+
+struct qstring
+{
+    qstring() {}
+    qstring(const char* str) : s(str) {}
+    qstring(const char* str, size_t len) : s(str, len) {}
+
+    const char* c_str() const { return s.c_str(); }
+    size_t length() const { return s.size(); }
+    size_t size() const { return s.size() + 1; }
+    bool empty() const { return s.empty(); }
+    void clear() { s.clear(); }
+    char operator[](size_t idx) const { return s[idx]; }
+    bool operator==(const char* str) const { return s == str; }
+    bool operator==(const qstring& other) const { return s == other.s; }
+    qstring& append(char c) { s += c; return *this; }
+    qstring& append(const char* str) { s.append(str); return *this; }
+    qstring& append(const char* str, size_t len) { s.append(str, len); return *this; }
+    int sprnt(const char* format, ...);
+    int cat_sprnt(const char* format, ...);
+
+    std::string s;
+};
+
+typedef qvector<uchar> bytevec_t;
+typedef qvector<ea_t> eavec_t;
+
+int msg(const char* format, ...);
+int vmsg(const char* format, va_list va);
+int qsnprintf(char* buffer, size_t n, const char* format, ...);
+int qvsnprintf(char* buffer, size_t n, const char* format, va_list va);
+void* qalloc(size_t size);
+void qfree(void* alloc);
+
+//--------------------------------------------------------------------------
+// kernwin.hpp
+void info(const char* format, ...);
+void warning(const char* format, ...);
+const char* get_plugin_options(const char* plugin);
+
+struct action_activation_ctx_t;
+struct action_update_ctx_t;
+enum action_state_t { AST_ENABLE_ALWAYS };
+struct action_handler_t
+{
+    virtual int idaapi activate(action_activation_ctx_t* ctx) = 0;
+    virtual action_state_t idaapi update(action_update_ctx_t* ctx) = 0;
+};
+struct action_desc_t
+{
+    const char* name;
+    const char* label;
+    action_handler_t* handler;
+    void* owner;
+    const char* shortcut;
+    const char* tooltip;
+    int icon;
+};
+#define ACTION_DESC_LITERAL_PLUGMOD(name, label, handler, plgmod, shortcut, tooltip, icon) \
+    { name, label, handler, plgmod, shortcut, tooltip, icon }
+bool register_action(const action_desc_t& desc);
+bool unregister_action(const char* name);
+bool attach_action_to_menu(const char* menupath, const char* name, int flags);
+
+//--------------------------------------------------------------------------
+// netnode.hpp
+struct netnode
+{
+    nodeidx_t netnodenumber = BADADDR;
+
+    bool create(const char* name, size_t namlen = 0);
+    bool kill();
+    nodeidx_t altval(nodeidx_t alt, uchar tag = 'A') const;
+    bool altset(nodeidx_t alt, nodeidx_t value, uchar tag = 'A');
+    ssize_t supval(nodeidx_t alt, void* buf, size_t bufsize, uchar tag = 'S') const;
+    bool supset(nodeidx_t alt, const void* value, size_t length = 0, uchar tag = 'S');
+    bool setblob(const void* buf, size_t size, nodeidx_t start, uchar tag);
+    ssize_t getblob(bytevec_t* blob, nodeidx_t start, uchar tag) const;
+    void* getblob(void* buf, size_t* bufsize, nodeidx_t start, uchar tag) const;
+    int delblob(nodeidx_t start, uchar tag);
+    size_t blobsize(nodeidx_t start, uchar tag);
+    operator nodeidx_t() const { return netnodenumber; }
+};
+
+//--------------------------------------------------------------------------
+// ua.hpp
+typedef uchar optype_t;
+typedef uchar op_dtype_t;
+
+enum
+{
+    o_void = 0, o_reg, o_mem, o_phrase, o_displ, o_imm, o_far, o_near,
+    o_idpspec0, o_idpspec1, o_idpspec2, o_idpspec3, o_idpspec4, o_idpspec5,
+};
+enum { dt_byte = 0, dt_word, dt_dword, dt_float, dt_double, dt_tbyte, dt_packreal, dt_qword };
+
+#define OF_NO_BASE_DISP 0x80
+#define OF_OUTER_DISP 0x40
+#define PACK_FORM_DEF 0x20
+#define OF_NUMBER 0x10
+#define OF_SHOW 0x08
+#define INSN_64BIT 0x04
+#define UA_MAXOP 8
+
+struct op_t
+{
+    op_t() : reg(0), value(0), addr(0), specval(0) {}
+
+    uchar n = 0;
+    optype_t type = o_void;
+    char offb = 0;
+    char offo = 0;
+    uchar flags = OF_SHOW;
+    op_dtype_t dtype = 0;
+    union { uint16 reg; uint16 phrase; };
+    union { uval_t value; struct { uint16 low, high; } value_shorts; };
+    union { ea_t addr; };
+    union { ea_t specval; };
+    char specflag1 = 0;
+    char specflag2 = 0;
+    char specflag3 = 0;
+    char specflag4 = 0;
+
+    void set_shown() { flags |= OF_SHOW; }
+    void clr_shown() { flags &= ~OF_SHOW; }
+    bool shown() const { return (flags & OF_SHOW) != 0; }
+};
+
+struct processor_t;
+struct insn_t
+{
+    insn_t() : auxpref(0) {}
+
+    ea_t cs = 0;
+    ea_t ip = 0;
+    ea_t ea = 0;
+    uint16 itype = 0;
+    uint16 size = 0;
+    union { uint32 auxpref; uint16 auxpref_u16[2]; uint8 auxpref_u8[4]; };
+    char segpref = 0;
+    char insnpref = 0;
+    int16 flags = 0;
+    op_t ops[UA_MAXOP];
+#define Op1 ops[0]
+#define Op2 ops[1]
+#define Op3 ops[2]
+#define Op4 ops[3]
+#define Op5 ops[4]
+#define Op6 ops[5]
+#define Op7 ops[6]
+#define Op8 ops[7]
+
+    uint32 get_canon_feature(const processor_t& ph) const;
+};
+
+struct outctx_t
+{
+    const insn_t& insn;
+    void out_custom_mnem(const char* mnem, int width = 8, const char* postfix = nullptr);
+};
+
+int decode_insn(insn_t* out, ea_t ea);
+ea_t decode_prev_insn(insn_t* out, ea_t ea);
+int create_insn(ea_t ea, insn_t* out = nullptr);
+
+//--------------------------------------------------------------------------
+// idp.hpp
+#define CF_STOP 0x00001
+#define CF_CALL 0x00002
+#define CF_CHG1 0x00004
+#define CF_CHG2 0x00008
+#define CF_CHG3 0x00010
+#define CF_USE1 0x00100
+#define CF_USE2 0x00200
+#define CF_USE3 0x00400
+#define CF_JUMP 0x04000
+#define CUSTOM_INSN_ITYPE 0x8000
+#define IDP_INTERFACE_VERSION 700
+#define PLUGIN_FIX 0x80
+#define PLUGIN_MULTI 0x100
+
+struct instruc_t
+{
+    const char* name;
+    uint32 feature;
+};
+
+struct procmod_t {};
+struct plugmod_t
+{
+    virtual bool idaapi run(size_t arg) = 0;
+    virtual ~plugmod_t() {}
+};
+struct event_listener_t
+{
+    virtual ssize_t idaapi on_event(ssize_t code, va_list va) = 0;
+    virtual ~event_listener_t() {}
+};
+
+enum hook_type_t { HT_IDP, HT_UI, HT_DBG, HT_IDB };
+bool hook_event_listener(hook_type_t hook_type, event_listener_t* cb, const void* owner = nullptr, int pri = 0);
+bool unhook_event_listener(hook_type_t hook_type, event_listener_t* cb);
+
+struct processor_t
+{
+    int32 version;
+    int32 id;
+    uint32 flag;
+    int regs_num;
+    const char* const* reg_names;
+    int instruc_start;
+    int instruc_end;
+    const instruc_t* instruc;
+
+    enum event_t
+    {
+        ev_init, ev_term, ev_newfile, ev_oldfile, ev_newbinary, ev_endbinary, ev_set_idp_options,
+        ev_set_proc_options, ev_ana_insn, ev_emu_insn, ev_out_header, ev_out_footer, ev_out_mnem,
+        ev_out_insn, ev_out_operand, ev_is_switch, ev_may_be_func, ev_is_basic_block_end,
+        ev_delay_slot_insn, ev_is_cond_insn, ev_is_call_insn, ev_get_reg_name, ev_str2reg,
+        ev_calc_retloc, ev_get_cc_regs, ev_calc_arglocs, ev_calc_varglocs, ev_next_exec_insn,
+        ev_calc_next_eas, ev_assemble, ev_loader_elf_machine, ev_ending_undo, ev_is_sane_insn,
+        ev_creating_segm,
+    };
+};
+processor_t* get_ph();
+#define PH (*get_ph())
+
+struct plugin_t
+{
+    int version;
+    int flags;
+    plugmod_t* (idaapi* init)();
+    void (idaapi* term)();
+    bool (idaapi* run)(size_t);
+    const char* comment;
+    const char* help;
+    const char* wanted_name;
+    const char* wanted_hotkey;
+};
+void set_module_data(int* data_id, void* data_ptr);
+void* clr_module_data(int data_id);
+
+namespace idb_event
+{
+enum event_code_t
+{
+    closebase, savebase, upgraded, auto_empty, auto_empty_finally, determined_main, segm_added,
+    segm_deleted, deleting_segm, segm_start_changed, segm_end_changed, segm_moved, allsegs_moved,
+    segm_name_changed, segm_attrs_updated, byte_patched, loader_finished, changing_cmt, cmt_changed,
+    func_added, bookmark_changed, sgr_changed, make_code, make_data, destroyed_items,
+};
+}
+
+//--------------------------------------------------------------------------
+// typeinf.hpp, only what the plugin headers mention.
+typedef int32 mreg_t;
+typedef uchar cm_t;
+struct tinfo_t {};
+struct argloc_t {};
+struct func_type_data_t {};
+struct regobjs_t {};
+struct relobj_t {};
+struct callregs_t { void set(int argregs_kind, const int* gprs, const int* fprs); };
+enum { ARGREGS_FP_CONSUME_GP = 4 };
+bool calc_retloc(argloc_t* retloc, const tinfo_t& rettype, cm_t cc);
+
+//--------------------------------------------------------------------------
+// xref.hpp
+enum cref_t { fl_U, fl_CF = 16, fl_CN = 17, fl_JF = 18, fl_JN = 19, fl_USobsolete = 20, fl_F = 21 };
+enum dref_t { dr_U, dr_O, dr_W, dr_R, dr_T, dr_I, dr_S };
+bool add_cref(ea_t from, ea_t to, cref_t type);
+bool add_dref(ea_t from, ea_t to, dref_t type);
+bool del_cref(ea_t from, ea_t to, bool expand);
+ea_t get_first_cref_to(ea_t to);
+ea_t get_next_cref_to(ea_t to, ea_t current);
+ea_t get_first_cref_from(ea_t from);
+ea_t get_next_cref_from(ea_t from, ea_t current);
+
+//--------------------------------------------------------------------------
+// bytes.hpp
+ssize_t get_bytes(void* buf, ssize_t size, ea_t ea, int gmb_flags = 0, void* mask = nullptr);
+uchar get_byte(ea_t ea);
+ushort get_word(ea_t ea);
+uint32 get_dword(ea_t ea);
+bool patch_word(ea_t ea, uint64 x);
+bool patch_dword(ea_t ea, uint64 x);
+bool patch_bytes(ea_t ea, const void* buf, size_t size);
+void put_bytes(ea_t ea, const void* buf, size_t size);
+bool put_dword(ea_t ea, uint64 x);
+bool create_dword(ea_t ea, asize_t length, bool force = false);
+flags_t get_flags(ea_t ea);
+bool is_loaded(ea_t ea);
+bool is_mapped(ea_t ea);
+bool is_code(flags_t flags);
+bool op_plain_offset(ea_t ea, int n, ea_t base);
+
+//--------------------------------------------------------------------------
+// segment.hpp
+#define SEGPERM_EXEC 1
+#define SEGPERM_WRITE 2
+#define SEGPERM_READ 4
+#define SEG_CODE 2
+
+struct segment_t
+{
+    ea_t start_ea;
+    ea_t end_ea;
+    uchar perm;
+    uchar type;
+    asize_t size() const { return end_ea - start_ea; }
+};
+segment_t* getseg(ea_t ea);
+segment_t* getnseg(int n);
+int get_segm_qty();
+segment_t* get_segm_by_name(const char* name);
+segment_t* get_first_seg();
+segment_t* get_next_seg(ea_t ea);
+ssize_t get_segm_name(qstring* buf, const segment_t* seg, int flags = 0);
+bool set_default_sreg_value(segment_t* seg, int rg, sel_t value);
+
+struct segm_move_info_t
+{
+    ea_t from;
+    ea_t to;
+    size_t size;
+};
+typedef qvector<segm_move_info_t> segm_move_infos_t;
+
+//--------------------------------------------------------------------------
+// loader.hpp, nalt.hpp
+struct linput_t;
+ea_t get_fileregion_ea(int64 offset);
+
+//--------------------------------------------------------------------------
+// funcs.hpp, auto.hpp
+struct func_t
+{
+    ea_t start_ea;
+    ea_t end_ea;
+};
+func_t* get_func(ea_t ea);
+bool add_func(ea_t ea1, ea_t ea2 = BADADDR);
+bool auto_make_proc(ea_t ea);
+void auto_mark_range(ea_t start, ea_t end, int type);
+void auto_wait();
+enum { AU_CODE = 20, AU_PROC = 30, AU_USED = 40 };
+
+//--------------------------------------------------------------------------
+// jumptable.hpp
+#define SWI_J32 0x4
+#define SWI_ELBASE 0x200
+#define SWI_JSIZE 0x400
+#define SWI_SIGNED 0x2000
+#define o_condjump o_idpspec5
+
+struct switch_info_t
+{
+    uint32 flags = 0;
+    ea_t jumps = BADADDR;
+    ea_t defjump = BADADDR;
+    ea_t elbase = 0;
+    ea_t startea = BADADDR;
+    int regnum = -1;
+    op_dtype_t regdtype = 0;
+    uval_t ncases = 0;
+    sval_t lowcase = 0;
+    int shift = 0;
+
+    void set_jtable_size(int size) { ncases = size; }
+    void set_shift(int value) { shift = value; }
+    void set_jtable_element_size(int size);
+    int get_jtable_element_size() const;
+    void clear() { *this = switch_info_t(); }
+};
+
+enum { JT_NONE = 0, JT_SWITCH = 1, JT_CALL = 2 };
+typedef int is_pattern_t(switch_info_t* si, const insn_t& insn, procmod_t* procmod);
+bool check_for_table_jump(switch_info_t* si, const insn_t& insn, is_pattern_t* const patterns[], size_t qty,
+                          void* table_checker = nullptr, const char* name = nullptr);
+
+struct tracked_regs_t;
+struct jump_pattern_t
+{
+    jump_pattern_t(switch_info_t* si, const char (*depends)[4], int last_reg) : si(si) {}
+    virtual ~jump_pattern_t() {}
+
+    insn_t insn;
+    switch_info_t* si;
+    int non_spoiled_reg = -1;
+
+    bool match(const insn_t& insn);
+    void trackop(const op_t& op, int r_i);
+    void track(int reg, int r_i, op_dtype_t dtype);
+
+    virtual void process_delay_slot(ea_t& ea, bool branch) const {}
+    virtual bool equal_ops(const op_t& x, const op_t& y) const;
+    virtual bool handle_mov(tracked_regs_t& regs) { return false; }
+    virtual bool jpi0() = 0;
+    virtual bool jpi1() { return false; }
+    virtual bool jpi2() { return false; }
+    virtual bool jpi3() { return false; }
+    virtual bool jpi4() { return false; }
+};
+
+//--------------------------------------------------------------------------
+// dbg.hpp, parsejson.hpp, lex.hpp
+struct debugger_t {};
+struct jvalue_t {};
+struct lexer_t;
+struct token_t {};
+
+#endif /* __NMIPS_SDK_STANDIN_H */
@@ -0,0 +1,423 @@
+#include "standin_db.hpp"
+#include <allins.hpp>
+#include <dbg.hpp>
+#include <jumptable.hpp>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <stdio.h>
+#include <tuple>
+
+/**
+ * @brief A segment of the stand-in database, bytes is empty for uninitialized (NOBITS) sections.
+ */
+struct standin_segment_t
+{
+    segment_t seg;
+    bytevec_t bytes;
+};
+
+static std::vector<standin_segment_t> segments;
+static std::map<ea_t, std::set<ea_t>> crefs_to;
+static size_t num_xrefs = 0;
+static std::set<ea_t> procs;
+static std::vector<event_listener_t*> listeners[HT_IDB + 1];
+
+static std::map<std::string, nodeidx_t> node_names;
+static std::map<std::tuple<nodeidx_t, uchar, nodeidx_t>, nodeidx_t> node_alts;
+static std::map<std::tuple<nodeidx_t, uchar, nodeidx_t>, bytevec_t> node_blobs;
+
+static uint32 read32(const uchar* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32)p[3] << 24);
+}
+
+static uint16 read16(const uchar* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+bool standin_load_elf(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) return false;
+    bytevec_t file;
+    uchar buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        file.insert(file.end(), buf, buf + n);
+    }
+    fclose(f);
+
+    if (file.size() < 52 || memcmp(&file[0], "\x7f" "ELF", 4) != 0 || file[4] != 1 || file[5] != 1) return false;
+
+    segments.clear();
+    uint32 shoff = read32(&file[32]);
+    uint16 shentsize = read16(&file[46]);
+    uint16 shnum = read16(&file[48]);
+    for (uint16 i = 0; i < shnum; i++)
+    {
+        size_t pos = shoff + (size_t)i * shentsize;
+        if (pos + 40 > file.size()) break;
+        const uchar* sh = &file[pos];
+        uint32 type = read32(sh + 4);
+        uint32 flags = read32(sh + 8);
+        uint32 addr = read32(sh + 12);
+        uint32 offset = read32(sh + 16);
+        uint32 size = read32(sh + 20);
+        // SHF_ALLOC
+        if ((flags & 0x2) == 0 || size == 0) continue;
+
+        standin_segment_t& segment = segments.emplace_back();
+        segment.seg.start_ea = addr;
+        segment.seg.end_ea = addr + size;
+        segment.seg.perm = SEGPERM_READ;
+        segment.seg.type = 0;
+        // SHF_WRITE, SHF_EXECINSTR
+        if (flags & 0x1) segment.seg.perm |= SEGPERM_WRITE;
+        if (flags & 0x4)
+        {
+            segment.seg.perm |= SEGPERM_EXEC;
+            segment.seg.type = SEG_CODE;
+        }
+        // SHT_NOBITS
+        if (type != 8 && (size_t)offset + size <= file.size())
+        {
+            segment.bytes.assign(file.begin() + offset, file.begin() + offset + size);
+        }
+    }
+    std::sort(segments.begin(), segments.end(),
+        [](const standin_segment_t& a, const standin_segment_t& b) { return a.seg.start_ea < b.seg.start_ea; });
+    standin_clear_xrefs();
+    return !segments.empty();
+}
+
+size_t standin_num_xrefs()
+{
+    return num_xrefs;
+}
+
+void standin_clear_xrefs()
+{
+    crefs_to.clear();
+    num_xrefs = 0;
+}
+
+void standin_notify(hook_type_t hook_type, ssize_t code, ...)
+{
+    // copy, listeners may unhook themselves.
+    std::vector<event_listener_t*> hooked = listeners[hook_type];
+    for (event_listener_t* listener : hooked)
+    {
+        va_list va;
+        va_start(va, code);
+        listener->on_event(code, va);
+        va_end(va);
+    }
+}
+
+static standin_segment_t* find_segment(ea_t ea)
+{
+    auto it = std::upper_bound(segments.begin(), segments.end(), ea,
+        [](ea_t addr, const standin_segment_t& s) { return addr < s.seg.start_ea; });
+    if (it == segments.begin()) return NULL;
+    --it;
+    if (ea >= it->seg.end_ea) return NULL;
+    return &*it;
+}
+
+//--------------------------------------------------------------------------
+// pro.h, kernwin.hpp
+int msg(const char* format, ...)
+{
+    // the plugin logs through loguru as well, which the benchmark configures.
+    return 0;
+}
+
+int vmsg(const char* format, va_list va)
+{
+    return 0;
+}
+
+int qsnprintf(char* buffer, size_t n, const char* format, ...)
+{
+    va_list va;
+    va_start(va, format);
+    int res = vsnprintf(buffer, n, format, va);
+    va_end(va);
+    return res;
+}
+
+int qvsnprintf(char* buffer, size_t n, const char* format, va_list va)
+{
+    return vsnprintf(buffer, n, format, va);
+}
+
+void info(const char* format, ...)
+{
+    va_list va;
+    va_start(va, format);
+    vfprintf(stderr, format, va);
+    va_end(va);
+}
+
+void warning(const char* format, ...)
+{
+    va_list va;
+    va_start(va, format);
+    vfprintf(stderr, format, va);
+    va_end(va);
+}
+
+//--------------------------------------------------------------------------
+// netnode.hpp
+bool netnode::create(const char* name, size_t namlen)
+{
+    std::string key = namlen != 0 ? std::string(name, namlen) : std::string(name);
+    auto it = node_names.find(key);
+    if (it == node_names.end())
+    {
+        it = node_names.emplace(key, (nodeidx_t)node_names.size()).first;
+    }
+    netnodenumber = it->second;
+    return true;
+}
+
+nodeidx_t netnode::altval(nodeidx_t alt, uchar tag) const
+{
+    auto it = node_alts.find({netnodenumber, tag, alt});
+    return it != node_alts.end() ? it->second : 0;
+}
+
+bool netnode::altset(nodeidx_t alt, nodeidx_t value, uchar tag)
+{
+    node_alts[{netnodenumber, tag, alt}] = value;
+    return true;
+}
+
+bool netnode::setblob(const void* buf, size_t size, nodeidx_t start, uchar tag)
+{
+    const uchar* bytes = (const uchar*)buf;
+    node_blobs[{netnodenumber, tag, start}].assign(bytes, bytes + size);
+    return true;
+}
+
+ssize_t netnode::getblob(bytevec_t* blob, nodeidx_t start, uchar tag) const
+{
+    auto it = node_blobs.find({netnodenumber, tag, start});
+    if (it == node_blobs.end()) return -1;
+    *blob = it->second;
+    return blob->size();
+}
+
+int netnode::delblob(nodeidx_t start, uchar tag)
+{
+    return node_blobs.erase({netnodenumber, tag, start});
+}
+
+//--------------------------------------------------------------------------
+// ua.hpp, idp.hpp
+static processor_t* make_ph()
+{
+    static instruc_t instructions[MIPS_last] = {};
+    instructions[MIPS_li].feature = CF_CHG1 | CF_USE2;
+
+    static processor_t ph = {};
+    ph.instruc_start = 0;
+    ph.instruc_end = MIPS_last;
+    ph.instruc = instructions;
+    return &ph;
+}
+
+processor_t* get_ph()
+{
+    static processor_t* ph = make_ph();
+    return ph;
+}
+
+uint32 insn_t::get_canon_feature(const processor_t& ph) const
+{
+    if (itype < ph.instruc_start || itype >= ph.instruc_end) return 0;
+    return ph.instruc[itype - ph.instruc_start].feature;
+}
+
+ea_t decode_prev_insn(insn_t* out, ea_t ea)
+{
+    // the stand-in has no flow information.
+    return BADADDR;
+}
+
+bool hook_event_listener(hook_type_t hook_type, event_listener_t* cb, const void* owner, int pri)
+{
+    auto& hooked = listeners[hook_type];
+    if (std::find(hooked.begin(), hooked.end(), cb) == hooked.end()) hooked.push_back(cb);
+    return true;
+}
+
+bool unhook_event_listener(hook_type_t hook_type, event_listener_t* cb)
+{
+    auto& hooked = listeners[hook_type];
+    auto it = std::find(hooked.begin(), hooked.end(), cb);
+    if (it == hooked.end()) return false;
+    hooked.erase(it);
+    return true;
+}
+
+//--------------------------------------------------------------------------
+// dbg.hpp
+bool is_debugger_on()
+{
+    return false;
+}
+
+//--------------------------------------------------------------------------
+// xref.hpp
+bool add_cref(ea_t from, ea_t to, cref_t type)
+{
+    if (crefs_to[to].insert(from).second) num_xrefs++;
+    return true;
+}
+
+bool add_dref(ea_t from, ea_t to, dref_t type)
+{
+    num_xrefs++;
+    return true;
+}
+
+ea_t get_first_cref_to(ea_t to)
+{
+    auto it = crefs_to.find(to);
+    if (it == crefs_to.end() || it->second.empty()) return BADADDR;
+    return *it->second.begin();
+}
+
+ea_t get_next_cref_to(ea_t to, ea_t current)
+{
+    auto it = crefs_to.find(to);
+    if (it == crefs_to.end()) return BADADDR;
+    auto next = it->second.upper_bound(current);
+    return next != it->second.end() ? *next : BADADDR;
+}
+
+//--------------------------------------------------------------------------
+// auto.hpp
+bool auto_make_proc(ea_t ea)
+{
+    procs.insert(ea);
+    return true;
+}
+
+size_t standin_num_procs()
+{
+    return procs.size();
+}
+
+//--------------------------------------------------------------------------
+// bytes.hpp
+ssize_t get_bytes(void* buf, ssize_t size, ea_t ea, int gmb_flags, void* mask)
+{
+    standin_segment_t* segment = find_segment(ea);
+    if (segment == NULL) return -1;
+    size_t offset = ea - segment->seg.start_ea;
+    if (offset >= segment->bytes.size()) return 0;
+    size_t nbytes = std::min<size_t>(size, segment->bytes.size() - offset);
+    memcpy(buf, &segment->bytes[offset], nbytes);
+    return nbytes;
+}
+
+// like IDA, writes the database without any events.
+void put_bytes(ea_t ea, const void* buf, size_t size)
+{
+    standin_segment_t* segment = find_segment(ea);
+    if (segment == NULL) return;
+    size_t offset = ea - segment->seg.start_ea;
+    if (offset >= segment->bytes.size()) return;
+    memcpy(&segment->bytes[offset], buf, std::min(size, segment->bytes.size() - offset));
+}
+
+// nothing in the stand-in database was analyzed yet.
+flags_t get_flags(ea_t ea)
+{
+    return 0;
+}
+
+bool is_code(flags_t flags)
+{
+    return false;
+}
+
+//--------------------------------------------------------------------------
+// segment.hpp
+segment_t* getseg(ea_t ea)
+{
+    standin_segment_t* segment = find_segment(ea);
+    return segment != NULL ? &segment->seg : NULL;
+}
+
+segment_t* getnseg(int n)
+{
+    if (n < 0 || (size_t)n >= segments.size()) return NULL;
+    return &segments[n].seg;
+}
+
+int get_segm_qty()
+{
+    return segments.size();
+}
+
+//--------------------------------------------------------------------------
+// typeinf.hpp
+void switch_info_t::set_jtable_element_size(int size)
+{
+    flags &= ~(SWI_J32 | SWI_JSIZE);
+    switch (size)
+    {
+    case 1: flags |= SWI_JSIZE; break;
+    case 4: flags |= SWI_J32; break;
+    case 8: flags |= SWI_J32 | SWI_JSIZE; break;
+    }
+}
+
+int switch_info_t::get_jtable_element_size() const
+{
+    switch (flags & (SWI_J32 | SWI_JSIZE))
+    {
+    case SWI_JSIZE: return 1;
+    case SWI_J32: return 4;
+    case SWI_J32 | SWI_JSIZE: return 8;
+    default: return 2;
+    }
+}
+
+//--------------------------------------------------------------------------
+// jumptable.hpp
+bool check_for_table_jump(switch_info_t* si, const insn_t& insn, is_pattern_t* const patterns[], size_t qty,
+                          void* table_checker, const char* name)
+{
+    for (size_t i = 0; i < qty; i++)
+    {
+        if (patterns[i](si, insn, nullptr) != JT_NONE) return true;
+    }
+    return false;
+}
+
+bool jump_pattern_t::match(const insn_t& insn)
+{
+    // tracking registers backwards needs decode_prev_insn, so no pattern ever matches.
+    this->insn = insn;
+    return false;
+}
+
+void jump_pattern_t::trackop(const op_t& op, int r_i)
+{
+}
+
+void jump_pattern_t::track(int reg, int r_i, op_dtype_t dtype)
+{
+}
+
+bool jump_pattern_t::equal_ops(const op_t& x, const op_t& y) const
+{
+    return x.type == y.type && x.reg == y.reg && x.addr == y.addr;
+}
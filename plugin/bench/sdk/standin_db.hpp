@@ -0,0 +1,29 @@
+#ifndef __NMIPS_STANDIN_DB_H
+#define __NMIPS_STANDIN_DB_H
+
+#include "standin.hpp"
+
+/**
+ * @brief Replaces the database with the allocated sections of a little endian ELF32 file, one segment each.
+ * @return false if the file could not be read or is not such an ELF file.
+ */
+bool standin_load_elf(const char* path);
+
+/**
+ * @brief Number of code and data cross references added since the last standin_clear_xrefs.
+ */
+size_t standin_num_xrefs();
+
+void standin_clear_xrefs();
+
+/**
+ * @brief Number of distinct addresses passed to auto_make_proc.
+ */
+size_t standin_num_procs();
+
+/**
+ * @brief Sends an event to every listener hooked to the given type, like IDA does.
+ */
+void standin_notify(hook_type_t hook_type, ssize_t code, ...);
+
+#endif /* __NMIPS_STANDIN_DB_H */
@@ -0,0 +1,133 @@
+#define LOG_CATEGORY log_analysis
+#include "decode_cache.hpp"
+#include "bytes.hpp"
+#include "log.hpp"
+
+ssize_t decode_cache_t::on_event(ssize_t code, va_list va)
+{
+    switch (code) {
+    case idb_event::byte_patched:
+    {
+        ea_t ea = va_arg(va, ea_t);
+        // any instruction containing this byte, i.e. starting at most 5 bytes before it.
+        for (ea_t start = ea >= 5 ? ea - 5 : 0; start <= ea; start++)
+        {
+            decode_cache_entry_t& entry = slot(start);
+            if (entry.ea == start) entry.ea = BADADDR;
+        }
+    }
+    break;
+    case idb_event::auto_empty_finally:
+    {
+        log_stats();
+    }
+    break;
+    case idb_event::closebase:
+    {
+        clear();
+    }
+    break;
+    }
+    return 0;
+}
+
+void decode_cache_t::enable_hooks(bool enable)
+{
+    if (enable) {
+        hook_event_listener(HT_IDB, this, this);
+    } else {
+        unhook_event_listener(HT_IDB, this);
+    }
+}
+
+void decode_cache_t::resize(int bits)
+{
+    entries.clear();
+    entries.resize((size_t)1 << bits);
+    mask = ((ea_t)1 << bits) - 1;
+    clear();
+    LOG("Decode cache has %zu entries, %zu KiB", entries.size(), entries.size() * sizeof(decode_cache_entry_t) >> 10);
+}
+
+void decode_cache_t::clear()
+{
+    for (auto &entry : entries)
+    {
+        entry.ea = BADADDR;
+    }
+    hits = misses = stale = 0;
+}
+
+size_t decode_cache_t::decode(ea_t ea, const struct nanomips_opcode** op, nanomips_decoded_op* operands)
+{
+    if (entries.empty()) resize(decode_cache_default_bits);
+
+    size_t avail = 0;
+    const bfd_byte* bytes = mirror.view(ea, 6, &avail);
+    bfd_byte buf[6];
+    if (bytes == NULL)
+    {
+        ssize_t nbytes = get_bytes(buf, sizeof(buf), ea);
+        if (nbytes < 0) return 0;
+        bytes = buf;
+        avail = nbytes;
+    }
+    if (avail < 2) return 0;
+
+    unsigned int first_halfword = decoder.big_endian ? bfd_getb16(bytes) : bfd_getl16(bytes);
+    unsigned int insn_len = nanomips_insn_length(first_halfword);
+    nanomips_decode_result result;
+    // entries are expanded as if there was no relocation, see nanomips_expand_operands.
+    if (relocs.covers(ea, ea + insn_len))
+    {
+        relocs.hits++;
+        size_t size = nanomips_decode(&decoder, bytes, avail, ea, INSN_HAS_RELOC, &result, operands);
+        if (size != 0) *op = result.op;
+        return size;
+    }
+
+    decode_cache_entry_t& entry = slot(ea);
+    if (entry.ea == ea)
+    {
+        if (entry.raw_len <= avail && memcmp(entry.raw, bytes, entry.raw_len) == 0)
+        {
+            hits++;
+            if (entry.length == 0) return 0;
+
+            *op = &nanomips_opcodes[entry.opcode];
+            nanomips_expand_operands(*op, entry.vals, ea, entry.length, operands);
+            return entry.length;
+        }
+        stale++;
+    }
+    misses++;
+
+    size_t size = nanomips_decode(&decoder, bytes, avail, ea, 0, &result, operands);
+    if (size != 0) *op = result.op;
+    // truncated instruction, might become valid once more bytes are loaded.
+    if (avail < insn_len) return size;
+
+    entry.ea = ea;
+    memset(entry.raw, 0, sizeof(entry.raw));
+    memcpy(entry.raw, bytes, insn_len);
+    entry.raw_len = insn_len;
+    entry.length = size;
+    if (size != 0)
+    {
+        entry.opcode = *op - nanomips_opcodes;
+        unsigned int count = nanomips_num_operands(*op);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            entry.vals[i] = operands[i].val;
+        }
+    }
+    return size;
+}
+
+void decode_cache_t::log_stats()
+{
+    uint64 total = hits + misses;
+    LOG("decode cache: %llu hits, %llu misses (%llu stale), %.1f%% hit rate with %llu entries",
+        (unsigned long long)hits, (unsigned long long)misses, (unsigned long long)stale,
+        total ? 100.0 * hits / total : 0.0, (unsigned long long)entries.size());
+}
@@ -0,0 +1,103 @@
+#ifndef __DECODE_CACHE_H
+#define __DECODE_CACHE_H
+
+#include <pro.h>
+#include <idp.hpp>
+#include "constants.hpp"
+#include "mirror.hpp"
+#include "reloc_index.hpp"
+#include "nanomips-dis.h"
+
+/**
+ * @brief Default log2 of the number of entries in the decode cache.
+ * Can be changed with -Onmips:decode_cache_bits=N, between decode_cache_min_bits and decode_cache_max_bits.
+ * Every entry takes sizeof(decode_cache_entry_t) bytes (56 with a 64-bit ea_t), all allocated up front.
+ */
+constexpr int decode_cache_default_bits = 16;
+constexpr int decode_cache_min_bits = 8;
+
+/**
+ * @brief 2^22 entries already take 224 MiB.
+ */
+constexpr int decode_cache_max_bits = 22;
+
+/**
+ * @brief A single decoded instruction, with its operands in raw form.
+ */
+struct decode_cache_entry_t
+{
+    ea_t ea = BADADDR;
+
+    /**
+     * @brief The instruction bytes this entry was decoded from, zero padded.
+     */
+    uchar raw[6] = {};
+    uint8 raw_len = 0;
+
+    /**
+     * @brief Size of the instruction, 0 if the bytes are not a valid instruction.
+     */
+    uint8 length = 0;
+
+    /**
+     * @brief Index into nanomips_opcodes.
+     */
+    uint16 opcode = 0;
+    uint32 vals[MAX_NUM_OPS] = {};
+};
+
+/**
+ * @brief Direct-mapped cache of decoded instructions, keyed by address.
+ * IDA decodes the same address many times, for ana, the mnemonic of unmapped instructions, switch detection and function discovery.
+ * Entries are checked against the current bytes on every lookup, so a stale entry is never returned.
+ * Patched bytes additionally evict the affected entries right away.
+ * Instructions with an unapplied relocation are decoded with INSN_HAS_RELOC every time, and never cached.
+ */
+struct decode_cache_t : public event_listener_t
+{
+public:
+    decode_cache_t(segment_mirror_t& mirror, const nanomips_decoder& decoder, reloc_index_t& relocs) : mirror(mirror), decoder(decoder), relocs(relocs) {};
+
+    virtual ssize_t idaapi on_event(ssize_t code, va_list va) override;
+
+    void enable_hooks(bool enable);
+
+    /**
+     * @brief Sets the number of entries to 2^bits and clears the cache.
+     */
+    void resize(int bits);
+
+    void clear();
+
+    /**
+     * @brief Decodes the instruction at ea, from the cache if possible.
+     * @param ea Address of the instruction.
+     * @param op Set to the matching entry of nanomips_opcodes.
+     * @param operands Receives the decoded operands, needs MAX_NUM_OPS zeroed entries.
+     * @return The size of the instruction in bytes, 0 if it could not be decoded.
+     */
+    size_t decode(ea_t ea, const struct nanomips_opcode** op, nanomips_decoded_op* operands);
+
+    /**
+     * @brief Logs the hit / miss counters, to help with choosing the cache size.
+     */
+    void log_stats();
+
+    uint64 hits = 0;
+    uint64 misses = 0;
+    /**
+     * @brief Misses where the entry was for the same address, but the bytes had changed.
+     */
+    uint64 stale = 0;
+
+private:
+    decode_cache_entry_t& slot(ea_t ea) { return entries[(ea >> 1) & mask]; }
+
+    segment_mirror_t& mirror;
+    const nanomips_decoder& decoder;
+    reloc_index_t& relocs;
+    qvector<decode_cache_entry_t> entries;
+    ea_t mask = 0;
+};
+
+#endif /* __DECODE_CACHE_H */
@@ -1,3 +1,4 @@
+#define LOG_CATEGORY log_loader
 #include "elf_ldr.hpp"
 #include "bytes.hpp"
 #include "constants.hpp"
@@ -6,9 +7,15 @@
 #include "idp.hpp"
 #include "log.hpp"
 #include "name.hpp"
+#include "offset.hpp"
 #include "ua.hpp"
 #include "segregs.hpp"
+#include "xref.hpp"
 #include "nmips.hpp"
+#include "nanomips-reloc.h"
+#include "reloc_fixup.hpp"
+#include <algorithm>
+#include <chrono>
 #include <cstdarg>
 #include <netnode.hpp>
 #include <pro.h>
@@ -16,14 +23,63 @@
 static const char relocations_node_name[] = "$ nanoMIPS relocations";
 static const char relocations_symbol_name[] = "$ nanoMIPS relocation symbols";
 
+/**
+ * @brief Version of the relocation blob, bump whenever its layout changes.
+ */
+static const uint32 relocations_version = 2;
+
+/**
+ * @brief Start of the relocation blob, followed by num_symbols got_symbol_record_t and strings_size bytes of names.
+ * Addresses are always 64 bits and nothing is padded, so the blob does not depend on the size of ea_t.
+ */
+struct relocations_blob_header_t
+{
+    uint32 version;
+    uint32 num_symbols;
+    uint32 strings_size;
+    uint32 reserved;
+    uint64 got_base;
+    uint64 extern_base;
+};
+static_assert(sizeof(relocations_blob_header_t) == 32, "relocations_blob_header_t must not have any padding");
+
+/**
+ * @brief got_symbol_t inside the relocation blob.
+ */
+struct got_symbol_record_t
+{
+    uint64 got_offset;
+    uint64 got_addr;
+    uint64 extern_offset;
+    uint64 extern_addr;
+    /**
+     * @brief Offset of the zero terminated name inside the string table.
+     */
+    uint32 name;
+    uint32 reserved;
+};
+static_assert(sizeof(got_symbol_record_t) == 40, "got_symbol_record_t must not have any padding");
+
+/**
+ * @brief got_symbol_t as saved by older versions, one supval each.
+ */
+struct legacy_got_symbol_t
+{
+    ea_t got_offset;
+    ea_t got_addr;
+    ea_t extern_offset;
+    ea_t extern_addr;
+    const char* name;
+};
+
 elf_nanomips_relocations_t::elf_nanomips_relocations_t()
 {
     bool exists = storage.create(relocations_node_name);
     if (!exists)
     {
-        LOG("relocation storage does not exist");
+        DLOG("relocation storage does not exist");
     } else {
-        LOG("relocation storage already exists");
+        DLOG("relocation storage already exists");
     }
     symbol_storage.create(relocations_symbol_name);
 }
@@ -31,16 +87,19 @@ elf_nanomips_relocations_t::elf_nanomips_relocations_t()
 void elf_nanomips_relocations_t::segments_updated()
 {
     segment_t* ext = get_segm_by_name("extern");
-    if (ext != NULL)
+    if (ext != NULL && ext->start_ea != extern_base)
         this->update_extern_base(ext->start_ea);
     segment_t* got = get_segm_by_name(".got");
-    if (got != NULL)
+    if (got != NULL && got->start_ea != got_base)
         this->update_got_base(got->start_ea);
     if (ext == NULL || got == NULL) {
         //WARN("either GOT or extern segment not found, cannot patch got for relocations!");
         return;
     }
 
+    // neither moved, so every entry still points to the right place.
+    if (got_base == patched_got_base && extern_base == patched_extern_base) return;
+
     this->patch_got();
     // LOG("Updated relocations inside GOT");
 }
@@ -56,6 +115,12 @@ ssize_t elf_nanomips_relocations_t::on_event(ssize_t code, va_list va)
         segments_updated();
     }
     break;
+    // in case the loader never finished.
+    case idb_event::savebase:
+    {
+        end_batch();
+    }
+    break;
     }
     return 0;
 }
@@ -96,29 +161,70 @@ void elf_nanomips_relocations_t::update_extern_base(ea_t new_base)
 
 void elf_nanomips_relocations_t::patch_got()
 {
+    auto start = std::chrono::steady_clock::now();
+
+    qvector<std::pair<ea_t, ea_t>> entries;
+    entries.reserve(relocated_symbols.size());
     for (auto &sym : relocated_symbols)
     {
-        patch_got_symbol(sym);
+        entries.push_back({ got_address(sym), extern_address(sym) });
     }
+    std::sort(entries.begin(), entries.end());
+
+    // the GOT is mostly contiguous, so this ends up as a handful of writes.
+    bool big_endian = inf_is_be();
+    bytevec_t run;
+    ea_t run_start = BADADDR;
+    size_t num_writes = 0;
+    auto flush = [&] {
+        if (run.empty()) return;
+        patch_bytes(run_start, &run[0], run.size());
+        run.clear();
+        num_writes++;
+    };
+    for (auto &entry : entries)
+    {
+        if (run.empty() || entry.first != run_start + run.size())
+        {
+            flush();
+            run_start = entry.first;
+        }
+        uint32 value = entry.second;
+        for (int i = 0; i < 4; i++)
+        {
+            run.push_back(big_endian ? (value >> (24 - 8 * i)) : (value >> (8 * i)));
+        }
+    }
+    flush();
+
+    patched_got_base = got_base;
+    patched_extern_base = extern_base;
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG("Patched %zu GOT entries for got 0x%x, extern 0x%x in %zu writes, %.1f ms", entries.size(), got_base, extern_base, num_writes, ms);
 }
 
 void elf_nanomips_relocations_t::patch_got_symbol(got_symbol_t& symbol)
 {
-    auto got_address = symbol.got_addr;
+    patch_dword(got_address(symbol), extern_address(symbol));
+}
+
+ea_t elf_nanomips_relocations_t::got_address(const got_symbol_t& symbol) const
+{
     if (symbol.got_offset != BADADDR && got_base != BADADDR)
     {
-        got_address = got_base + symbol.got_offset;
+        return got_base + symbol.got_offset;
     }
+    return symbol.got_addr;
+}
 
-    auto extern_address = symbol.extern_addr;
+ea_t elf_nanomips_relocations_t::extern_address(const got_symbol_t& symbol) const
+{
     if (symbol.extern_offset != BADADDR && extern_base != BADADDR)
     {
-        extern_address = extern_base + symbol.extern_offset;
+        return extern_base + symbol.extern_offset;
     }
-
-    LOG("patching symbol %s 0x%x = 0x%x", symbol.name, got_address, extern_address);
-    // get_flags(0);
-    patch_dword(got_address, extern_address);
+    return symbol.extern_addr;
 }
 
 void elf_nanomips_relocations_t::set_offsets(got_symbol_t& got_sym)
@@ -139,55 +245,173 @@ void elf_nanomips_relocations_t::set_offsets(got_symbol_t& got_sym)
 
 void elf_nanomips_relocations_t::save_to_idb()
 {
-    storage.create(relocations_node_name);
-    symbol_storage.create(relocations_symbol_name);
-    int ret = storage.altset(0, got_base);
-    // if (ret != 1) {
-    //     ERR("Failed to store got_base in relocation storage!");
-    // }
-    storage.altset(1, extern_base);
-    storage.altset(2, relocated_symbols.size());
-
-    size_t idx = 0;
+    if (batching)
+    {
+        dirty = true;
+        return;
+    }
+    dirty = false;
+
+    relocations_blob_header_t header = {};
+    header.version = relocations_version;
+    header.num_symbols = relocated_symbols.size();
+    header.got_base = got_base;
+    header.extern_base = extern_base;
+    for (auto &sym : relocated_symbols)
+    {
+        header.strings_size += sym.name.length() + 1;
+    }
+
+    bytevec_t blob;
+    blob.resize(sizeof(header) + header.num_symbols * sizeof(got_symbol_record_t) + header.strings_size);
+    memcpy(&blob[0], &header, sizeof(header));
+    size_t record_pos = sizeof(header);
+    size_t strings_pos = record_pos + header.num_symbols * sizeof(got_symbol_record_t);
+    uint32 name = 0;
     for (auto &sym : relocated_symbols)
     {
-        symbol_storage.supset(idx, &sym, sizeof(sym));
-        idx++;
+        got_symbol_record_t record = {};
+        record.got_offset = sym.got_offset;
+        record.got_addr = sym.got_addr;
+        record.extern_offset = sym.extern_offset;
+        record.extern_addr = sym.extern_addr;
+        record.name = name;
+        memcpy(&blob[record_pos], &record, sizeof(record));
+        record_pos += sizeof(record);
+        memcpy(&blob[strings_pos + name], sym.name.c_str(), sym.name.length() + 1);
+        name += sym.name.length() + 1;
     }
+
+    storage.create(relocations_node_name);
+    storage.delblob(0, 'R');
+    storage.setblob(&blob[0], blob.size(), 0, 'R');
 }
 
 void elf_nanomips_relocations_t::load_from_idb()
 {
     storage.create(relocations_node_name);
+    relocated_symbols.clear();
+
+    bytevec_t blob;
+    if (storage.getblob(&blob, 0, 'R') <= 0)
+    {
+        load_legacy_from_idb();
+        return;
+    }
+
+    // the version comes first in every layout, older blobs can be smaller than the current header.
+    uint32 version = 0;
+    if (blob.size() >= sizeof(version)) memcpy(&version, &blob[0], sizeof(version));
+    if (version != relocations_version)
+    {
+        WARN("Ignoring relocations stored in the database, version %u is not supported", version);
+        return;
+    }
+    relocations_blob_header_t header;
+    if (blob.size() < sizeof(header))
+    {
+        WARN("Ignoring relocations stored in the database, blob has unexpected size 0x%zx", blob.size());
+        return;
+    }
+    memcpy(&header, &blob[0], sizeof(header));
+    size_t strings_pos = sizeof(header) + (size_t)header.num_symbols * sizeof(got_symbol_record_t);
+    if (blob.size() != strings_pos + header.strings_size)
+    {
+        WARN("Ignoring relocations stored in the database, blob has unexpected size 0x%zx", blob.size());
+        return;
+    }
+
+    got_base = header.got_base;
+    extern_base = header.extern_base;
+    relocated_symbols.resize(header.num_symbols);
+    for (size_t idx = 0; idx < header.num_symbols; idx++)
+    {
+        got_symbol_record_t record;
+        memcpy(&record, &blob[sizeof(header) + idx * sizeof(record)], sizeof(record));
+        got_symbol_t& sym = relocated_symbols[idx];
+        sym.got_offset = record.got_offset;
+        sym.got_addr = record.got_addr;
+        sym.extern_offset = record.extern_offset;
+        sym.extern_addr = record.extern_addr;
+        if (record.name < header.strings_size)
+        {
+            const char* name = (const char*)&blob[strings_pos + record.name];
+            sym.name.append(name, strnlen(name, header.strings_size - record.name));
+        }
+    }
+    patched_got_base = got_base;
+    patched_extern_base = extern_base;
+    LOG("Loaded %zu relocated symbols from the database", relocated_symbols.size());
+}
+
+void elf_nanomips_relocations_t::load_legacy_from_idb()
+{
     symbol_storage.create(relocations_symbol_name);
     got_base = storage.altval(0);
     extern_base = storage.altval(1);
     int num_syms = storage.altval(2);
-    relocated_symbols.clear();
+    patched_got_base = got_base;
+    patched_extern_base = extern_base;
 
     for (int idx = 0; idx < num_syms; idx++)
     {
-        got_symbol_t sym;
-        symbol_storage.supval(idx, &sym, sizeof(sym));
-        relocated_symbols.push_back(sym);
+        legacy_got_symbol_t legacy;
+        if (symbol_storage.supval(idx, &legacy, sizeof(legacy)) != sizeof(legacy)) continue;
+        got_symbol_t& sym = relocated_symbols.push_back();
+        sym.got_offset = legacy.got_offset;
+        sym.got_addr = legacy.got_addr;
+        sym.extern_offset = legacy.extern_offset;
+        sym.extern_addr = legacy.extern_addr;
+    }
+    if (num_syms > 0)
+    {
+        LOG("Loaded %zu relocated symbols saved by an older version, without their names", relocated_symbols.size());
+    }
+}
+
+void elf_nanomips_relocations_t::begin_batch()
+{
+    batching = true;
+}
+
+void elf_nanomips_relocations_t::end_batch()
+{
+    batching = false;
+    if (dirty) save_to_idb();
+}
+
+/**
+ * @brief Whether relocation type leaves a plain 32-bit address at its location.
+ * GOT entries are recorded where they are patched, the engine does not apply IRELATIVE.
+ */
+static bool is_data_pointer(uint32 type)
+{
+    switch (type)
+    {
+    case R_NANOMIPS_32:
+    case R_NANOMIPS_RELATIVE:
+        return true;
+    default:
+        return false;
     }
 }
 
 const char *elf_nanomips_t::proc_handle_reloc(const rel_data_t &rel_data, const sym_rel *symbol, const elf_rela_t *reloc, reloc_tools_t *tools)
 {   
-    LOG("handle_relocation(0x%x, 0x%x, 0x%x, t: %d): %s, %s, 0x%x", rel_data.P, rel_data.S, rel_data.Sadd, rel_data.type, symbol->name.c_str(), symbol->original_name.c_str(), symbol->value);
+    TRACE("handle_relocation(0x%x, 0x%x, 0x%x, t: %d): %s, %s, 0x%x", rel_data.P, rel_data.S, rel_data.Sadd, rel_data.type, symbol->name.c_str(), symbol->original_name.c_str(), symbol->value);
     if (rel_data.type == 10 || rel_data.type == 11)
     {
         ea_t got_address = rel_data.P;
         ea_t extern_address = rel_data.S;
-        const char* name = symbol->original_name.c_str();
         got_symbol_t& got_sym = relocations->relocated_symbols.push_back();
-        got_sym.name = name;
+        got_sym.name = symbol->original_name;
         got_sym.got_addr = got_address;
         got_sym.extern_addr = extern_address;
         relocations->set_offsets(got_sym);
         relocations->patch_got_symbol(got_sym);
         relocations->save_to_idb();
+        data_pointers.push_back(got_address);
+        set_reloc_fixup(got_address, rel_data.type, extern_address, NANOMIPS_RELOC_NO_GP);
 
         if (rel_data.type == 10)
         {
@@ -196,6 +420,35 @@ const char *elf_nanomips_t::proc_handle_reloc(const rel_data_t &rel_data, const
         return "R_NANOMIPS_JUMP_SLOT";
     }
 
+    // elf_mips_t does not know any of the nanoMIPS instruction formats.
+    uchar bytes[6];
+    unsigned int size = nanomips_reloc_size(rel_data.type);
+    if (size != 0 && get_bytes(bytes, size, rel_data.P) != size)
+    {
+        reloc_index->add(rel_data.P);
+        return base->proc_handle_reloc(rel_data, symbol, reloc, tools);
+    }
+    uint32 gp = relocations->got_base != BADADDR ? relocations->got_base : NANOMIPS_RELOC_NO_GP;
+    const char* name = nanomips_reloc_name(rel_data.type);
+    switch (nanomips_reloc_apply(decoder.big_endian, rel_data.type, bytes, size, rel_data.P, rel_data.Sadd, gp))
+    {
+    case NANOMIPS_RELOC_OK:
+        put_bytes(rel_data.P, bytes, size);
+        set_reloc_fixup(rel_data.P, rel_data.type, rel_data.Sadd, gp);
+        if (is_data_pointer(rel_data.type)) data_pointers.push_back(rel_data.P);
+        return name;
+    case NANOMIPS_RELOC_IGNORED:
+        return name;
+    case NANOMIPS_RELOC_OVERFLOW:
+        WARN("[0x%x] %s: 0x%x does not fit into the instruction", rel_data.P, name, rel_data.Sadd);
+        reloc_index->add(rel_data.P);
+        return name;
+    default:
+        break;
+    }
+
+    // whatever elf_mips_t does, the instruction still holds the addend.
+    reloc_index->add(rel_data.P);
     return base->proc_handle_reloc(rel_data, symbol, reloc, tools);
 }
 
@@ -234,12 +487,67 @@ bool elf_nanomips_t::proc_is_acceptable_image_type(ushort filetype)
 
 void elf_nanomips_t::proc_on_start_data_loading(elf_ehdr_t &header)
 {
+    relocations->begin_batch();
     base->proc_on_start_data_loading(header);
 }
 
 bool elf_nanomips_t::proc_on_end_data_loading()
 {
-    return base->proc_on_end_data_loading();
+    bool res = base->proc_on_end_data_loading();
+    relocations->end_batch();
+    reloc_index->build();
+    create_data_pointers();
+    insn_index->build();
+    return res;
+}
+
+size_t elf_nanomips_t::create_data_pointers()
+{
+    auto start = std::chrono::steady_clock::now();
+    std::sort(data_pointers.begin(), data_pointers.end());
+    data_pointers.erase(std::unique(data_pointers.begin(), data_pointers.end()), data_pointers.end());
+
+    size_t created = 0;
+    size_t skipped = 0;
+    bytevec_t run;
+    for (size_t i = 0; i < data_pointers.size();)
+    {
+        // pointer tables are read at once.
+        size_t end = i + 1;
+        while (end < data_pointers.size() && data_pointers[end] == data_pointers[end - 1] + 4) end++;
+        run.resize((end - i) * 4);
+        if (get_bytes(&run[0], run.size(), data_pointers[i]) != (ssize_t)run.size())
+        {
+            skipped += end - i;
+            i = end;
+            continue;
+        }
+
+        for (size_t j = i; j < end; j++)
+        {
+            ea_t ea = data_pointers[j];
+            const uchar* bytes = &run[(j - i) * 4];
+            uint32 target = decoder.big_endian ? ((uint32)bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3]
+                                               : ((uint32)bytes[3] << 24) | (bytes[2] << 16) | (bytes[1] << 8) | bytes[0];
+            // never break up code or anything the loader already created, e.g. strings.
+            flags_t flags = get_flags(ea);
+            if (is_code(flags) || (!is_unknown(flags) && !is_dword(flags)) || !is_mapped(target))
+            {
+                skipped++;
+                continue;
+            }
+            create_dword(ea, 4);
+            op_plain_offset(ea, 0, 0);
+            add_dref(ea, target, dr_O);
+            created++;
+        }
+        i = end;
+    }
+    data_pointers.clear();
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG("Created %zu data pointers from relocations in %.1f ms, skipped %zu", created, ms, skipped);
+    return created;
 }
 
 bool elf_nanomips_t::proc_handle_symbol(sym_rel &sym, const char *symname)
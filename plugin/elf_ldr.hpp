@@ -5,8 +5,11 @@
 #include <elf/elfbase.h>
 #include <elf/elf.h>
 #include <idp.hpp>
+#include "nanomips-dis.h"
 
 struct plugin_ctx_t;
+struct insn_index_t;
+struct reloc_index_t;
 
 /**
  * @brief Symbol encountered by the elf_nanomips_t loader
@@ -24,7 +27,7 @@ struct got_symbol_t
      * @brief Actual address of the symbol in the got.
      * We use both, got_symbol_t::got_offset and this, since we might not yet know the start of the got when we encounter a symbol.
      */
-    ea_t got_addr;
+    ea_t got_addr = BADADDR;
 
     /**
      * @brief Offset from the base of the extern section, where this symbol is.
@@ -36,13 +39,13 @@ struct got_symbol_t
      * @brief Actual address of the symbol in the extern section.
      * We use both, got_symbol_t::extern_offset and this, since we might not yet know the start of the extern section when we encounter a symbol.
      */
-    ea_t extern_addr;
+    ea_t extern_addr = BADADDR;
 
     /**
      * @brief Name of the symbol.
      * 
      */
-    const char* name;
+    qstring name;
 };
 
 /**
@@ -50,6 +53,7 @@ struct got_symbol_t
  * This is a separate class to elf_nanomips_t, because we need to have this even without the ELF loader.
  * This happens if we open an existing IDB and want to continue working on something.
  * It saves the relocation information inside th IDB, so we can rebase even loading from an IDB!
+ * While the ELF loader runs, changes are only kept in memory and written once it is done, see begin_batch().
  */
 struct elf_nanomips_relocations_t : public event_listener_t
 {
@@ -65,6 +69,10 @@ public:
 
     void enable_hooks(bool enable);
 
+    /**
+     * @brief Picks up the current GOT and extern bases, and patches the GOT again if either of them moved.
+     * Called for every segment event, most of which do not touch either segment.
+     */
     void segments_updated();
 
     /**
@@ -85,7 +93,7 @@ public:
 
     /**
      * @brief Patches up the symbols in the got, so that they are resolved to the extern symbols.
-     * Can be called whenever really.
+     * Can be called whenever really. Adjacent entries are written together, with a single summary logged.
      */
     void patch_got();
 
@@ -98,10 +106,41 @@ public:
 
     void set_offsets(got_symbol_t& got_sym);
 
+    /**
+     * @brief Writes all symbols as a single blob, with the names in a string table behind them.
+     * Does nothing between begin_batch() and end_batch(), except remembering that there is something to write.
+     */
     void save_to_idb();
     void load_from_idb();
 
+    /**
+     * @brief Defers save_to_idb() until end_batch(), so that loading does not rewrite all symbols for every relocation.
+     */
+    void begin_batch();
+
+    /**
+     * @brief Writes everything changed since begin_batch() to the IDB.
+     */
+    void end_batch();
+
 private:
+    /**
+     * @brief got_base and extern_base the GOT was last patched for.
+     */
+    ea_t patched_got_base = BADADDR;
+    ea_t patched_extern_base = BADADDR;
+
+    ea_t got_address(const got_symbol_t& symbol) const;
+    ea_t extern_address(const got_symbol_t& symbol) const;
+
+    bool batching = false;
+    bool dirty = false;
+
+    /**
+     * @brief Reads the one supval per symbol written by older versions, their names cannot be recovered.
+     */
+    void load_legacy_from_idb();
+
     /**
      * @brief Storage inside the IDB.
      * 
@@ -117,10 +156,37 @@ private:
 struct elf_nanomips_t : public proc_def_t
 {
 public:
-    elf_nanomips_t(elf_mips_t* base, elf_nanomips_relocations_t* relocations) : proc_def_t(base->ldr, base->reader), base(base), relocations(relocations) {};
+    elf_nanomips_t(elf_mips_t* base, elf_nanomips_relocations_t* relocations, reloc_index_t* reloc_index, insn_index_t* insn_index, const nanomips_decoder& decoder) : proc_def_t(base->ldr, base->reader), base(base), relocations(relocations), reloc_index(reloc_index), insn_index(insn_index), decoder(decoder) {};
     elf_mips_t* base;
     elf_nanomips_relocations_t* relocations;
 
+    /**
+     * @brief Gets every relocation that could not be applied, built once all of them were handled.
+     */
+    reloc_index_t* reloc_index;
+
+    /**
+     * @brief Built as soon as the segments are loaded.
+     */
+    insn_index_t* insn_index;
+
+    /**
+     * @brief Only the endianness is needed, to apply relocations to instructions.
+     */
+    const nanomips_decoder& decoder;
+
+    /**
+     * @brief Locations of all absolute data relocations seen while loading, e.g. R_NANOMIPS_32 and R_NANOMIPS_RELATIVE.
+     */
+    qvector<ea_t> data_pointers;
+
+    /**
+     * @brief Turns every location in data_pointers into a dword offset with a data xref, in one pass once all relocations are applied.
+     * So IDA does not have to guess which words in the data segments are pointers.
+     * @return The number of pointers created.
+     */
+    size_t create_data_pointers();
+
     // Overridden from elf_mips_t
     virtual const char *proc_handle_reloc(
             const rel_data_t &rel_data,
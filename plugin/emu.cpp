@@ -1,3 +1,4 @@
+#define LOG_CATEGORY log_analysis
 #include "ida.hpp"
 #include "idp.hpp"
 #include "ins.hpp"
@@ -20,7 +21,7 @@ void decode_phrase(op_t op, int& base, int& scale)
 //-------------------------------------------------------------------------
 // 3 bgeiuc rA, #size, default
 // 2 la      rB, rJumps
-// 1 lwxs    rB, rA(rB)
+// 1 lwxs    rB, rA(rB) // or lhuxs / lbux for smaller tables
 // 0 brsc (jrc) rB // actually jrc, since we map brsc to jrc!
 
 static const char nmips_depends[][4] =
@@ -174,10 +175,23 @@ bool nmips_jump_pattern_t::jpi2()
 
 bool nmips_jump_pattern_t::jpi1()
 {
-    if (insn.itype != MIPS_lwxs) return false;
-
     int base = 0, scale = 0;
-    decode_phrase(insn.Op2, base, scale);
+    switch (insn.itype)
+    {
+    case MIPS_lwxs:
+        decode_phrase(insn.Op2, base, scale);
+        si->set_jtable_element_size(4);
+        break;
+    // only lwxs is switched to the phrase version.
+    case nMIPS_lhuxs:
+    case MIPS_lbux:
+        scale = insn.Op2.reg;
+        base = insn.Op3.reg;
+        si->set_jtable_element_size(insn.itype == nMIPS_lhuxs ? 2 : 1);
+        break;
+    default:
+        return false;
+    }
 
     track(scale, rA, dt_dword);
     track(base, rB, dt_dword);
@@ -286,20 +300,26 @@ static int is_jump_pattern(switch_info_t *si, const insn_t &insn, procmod_t *pm)
 
 bool plugin_ctx_t::is_switch(switch_info_t *si, const insn_t *insn)
 {
-    struct nanomips_opcode op = {};
-    nanomips_decoded_op operands[MAX_NUM_OPS] = {};
-    size_t insn_size = nanomips_disasm_instr(insn->ea, &disasm_info, &op, operands);
-    if (insn_size <= 0) return false;
+    // brsc is mapped to jrc.
+    if (insn->itype != MIPS_jrc) return false;
+    const struct nanomips_opcode* op = get_insn_opcode(*insn);
+    if (op == nullptr || strcmp(op->name, "brsc") != 0) return false;
 
-    if (strcmp(op.name, "brsc") != 0) return false;
+    const switch_cache_entry_t* cached = switch_cache.find(insn->ea);
+    if (cached != nullptr)
+    {
+        if (cached->is_switch) *si = cached->si;
+        return cached->is_switch;
+    }
 
     static is_pattern_t *const patterns[] =
     {
         is_jump_pattern,
     };
     bool res = check_for_table_jump(si, *insn, patterns, qnumber(patterns));
+    switch_cache.add(insn->ea, res ? si : nullptr);
 
-    LOG("[0x%x] is_switch = %s", insn->ea, res ? "true" : "false");
+    TRACE("[0x%x] is_switch = %s", insn->ea, res ? "true" : "false");
     return res;
 }
 
@@ -313,19 +333,33 @@ int plugin_ctx_t::may_be_func(insn_t *insn, int state)
 
     if (state == 0 || state == 1) // creating functions
     {
+        // the sweep after loading saw every direct call, but might have decoded data as well, so only confirmed starts count.
+        if (func_finder.confidence(insn->ea) == 100) return 100;
+
         ea_t cref_addr;
         for ( cref_addr = get_first_cref_to(insn->ea);
               cref_addr != BADADDR;
               cref_addr = get_next_cref_to(insn->ea, cref_addr) )
         {
             insn_t cref_insn;
-            if (decode_insn(&cref_insn, cref_addr) > 0)
+            // the balc half of a move.balc is a fake instruction, which is not in the cache.
+            const fake_secondary_t* fake = fake_secondary_insn.find(cref_addr);
+            if (fake != nullptr)
+            {
+                cref_insn.itype = fake->itype;
+            }
+            else
+            {
+                const struct nanomips_opcode* op = nullptr;
+                nanomips_decoded_op operands[MAX_NUM_OPS] = {};
+                if (decode(cref_addr, &op, operands) == 0) continue;
+                fill_opcode(cref_insn, *op);
+            }
+
+            // if we have a cref that bal's to here, then it must also be a function!
+            if (cref_insn.itype == MIPS_bal || cref_insn.itype == MIPS_jal)
             {
-                // if we have a cref that bal's to here, then it must also be a function!
-                if (cref_insn.itype == MIPS_bal || cref_insn.itype == MIPS_jal)
-                {
-                    return 100;
-                }
+                return 100;
             }
         }
     }
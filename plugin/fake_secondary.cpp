@@ -0,0 +1,253 @@
+#define LOG_CATEGORY log_analysis
+#include "fake_secondary.hpp"
+#include "log.hpp"
+#include <algorithm>
+
+static const char fake_secondary_node_name[] = "$ nanoMIPS fake secondary instructions";
+
+/**
+ * @brief Bumped whenever fake_secondary_record_t changes, older blobs are ignored and rebuilt by reanalysis.
+ */
+static const nodeidx_t fake_secondary_version = 2;
+
+/**
+ * @brief fake_secondary_t inside the blob, with fixed widths and no padding, so it does not depend on the size of ea_t.
+ */
+struct fake_secondary_record_t
+{
+    uint64 ea;
+    uint64 value;
+    uint16 itype;
+    uint8 size;
+    uint8 optype;
+    uint8 dtype;
+    uint8 reserved[3];
+};
+static_assert(sizeof(fake_secondary_record_t) == 24, "fake_secondary_record_t must not have any padding");
+
+void fake_secondary_t::fill(insn_t& insn) const
+{
+    insn.itype = itype;
+    insn.size = size;
+    insn.Op1.type = optype;
+    insn.Op1.dtype = dtype;
+    insn.Op1.set_shown();
+    if (optype == o_reg)
+    {
+        insn.Op1.reg = value;
+    }
+    else
+    {
+        insn.Op1.addr = value;
+    }
+}
+
+static bool ea_less(const fake_secondary_t& secondary, ea_t ea)
+{
+    return secondary.ea < ea;
+}
+
+ssize_t fake_secondary_store_t::on_event(ssize_t code, va_list va)
+{
+    switch (code) {
+    case idb_event::byte_patched:
+    {
+        ea_t ea = va_arg(va, ea_t);
+        // secondaries of any instruction containing this byte. Those are at most 4 bytes long,
+        // so they start at most 3 bytes before it and their secondaries are in [ea - 2, ea + 2).
+        erase_range(ea >= 2 ? ea - 2 : 0, ea + 2);
+    }
+    break;
+    case idb_event::segm_deleted:
+    {
+        ea_t start_ea = va_arg(va, ea_t);
+        ea_t end_ea = va_arg(va, ea_t);
+        erase_range(start_ea, end_ea);
+    }
+    break;
+    case idb_event::segm_moved:
+    {
+        ea_t from = va_arg(va, ea_t);
+        ea_t to = va_arg(va, ea_t);
+        asize_t size = va_arg(va, asize_t);
+        move_range(from, to, size);
+    }
+    break;
+    case idb_event::allsegs_moved:
+    {
+        segm_move_infos_t* info = va_arg(va, segm_move_infos_t*);
+        move_segments(*info);
+    }
+    break;
+    case idb_event::savebase:
+    {
+        save_to_idb();
+    }
+    break;
+    case idb_event::auto_empty_finally:
+    {
+        log_stats();
+    }
+    break;
+    case idb_event::closebase:
+    {
+        clear();
+    }
+    break;
+    }
+    return 0;
+}
+
+void fake_secondary_store_t::enable_hooks(bool enable)
+{
+    if (enable) {
+        hook_event_listener(HT_IDB, this, this);
+    } else {
+        unhook_event_listener(HT_IDB, this);
+    }
+}
+
+void fake_secondary_store_t::add(const fake_secondary_t& secondary)
+{
+    // ana mostly runs in address order, so this is usually an append.
+    if (secondaries.empty() || secondaries.back().ea < secondary.ea)
+    {
+        secondaries.push_back(secondary);
+        return;
+    }
+
+    auto it = std::lower_bound(secondaries.begin(), secondaries.end(), secondary.ea, ea_less);
+    if (it != secondaries.end() && it->ea == secondary.ea)
+    {
+        *it = secondary;
+    }
+    else
+    {
+        secondaries.insert(it, secondary);
+    }
+}
+
+const fake_secondary_t* fake_secondary_store_t::find_slow(ea_t ea) const
+{
+    auto it = std::lower_bound(secondaries.begin(), secondaries.end(), ea, ea_less);
+    if (it == secondaries.end() || it->ea != ea) return nullptr;
+    return &*it;
+}
+
+void fake_secondary_store_t::erase_range(ea_t start, ea_t end)
+{
+    auto first = std::lower_bound(secondaries.begin(), secondaries.end(), start, ea_less);
+    auto last = std::lower_bound(first, secondaries.end(), end, ea_less);
+    if (first != last) secondaries.erase(first, last);
+    // a deleted segment ends a rebase.
+    unmoved_secondaries.clear();
+    pending_moves.clear();
+}
+
+void fake_secondary_store_t::move_range(ea_t from, ea_t to, asize_t size)
+{
+    if (pending_moves.empty()) unmoved_secondaries = secondaries;
+    segm_move_info_t move;
+    move.from = from;
+    move.to = to;
+    move.size = size;
+    pending_moves.push_back(move);
+    remap(unmoved_secondaries, pending_moves);
+}
+
+void fake_secondary_store_t::move_segments(const segm_move_infos_t& moves)
+{
+    remap(pending_moves.empty() ? secondaries : unmoved_secondaries, moves);
+    unmoved_secondaries.clear();
+    pending_moves.clear();
+}
+
+static ea_t move_address(ea_t ea, const segm_move_infos_t& moves)
+{
+    for (const segm_move_info_t& move : moves)
+    {
+        if (ea >= move.from && ea - move.from < move.size) return ea - move.from + move.to;
+    }
+    return ea;
+}
+
+void fake_secondary_store_t::remap(const qvector<fake_secondary_t>& old_secondaries, const segm_move_infos_t& moves)
+{
+    // copied first, old_secondaries may be secondaries itself.
+    qvector<fake_secondary_t> moved = old_secondaries;
+    for (fake_secondary_t& secondary : moved)
+    {
+        secondary.ea = move_address(secondary.ea, moves);
+        if (secondary.optype == o_near) secondary.value = move_address(secondary.value, moves);
+    }
+    std::sort(moved.begin(), moved.end(),
+        [](const fake_secondary_t& a, const fake_secondary_t& b) { return a.ea < b.ea; });
+    secondaries.swap(moved);
+}
+
+void fake_secondary_store_t::clear()
+{
+    secondaries.clear();
+    unmoved_secondaries.clear();
+    pending_moves.clear();
+}
+
+void fake_secondary_store_t::save_to_idb()
+{
+    storage.create(fake_secondary_node_name);
+    storage.altset(0, fake_secondary_version);
+    storage.delblob(0, 'S');
+    if (secondaries.empty()) return;
+
+    bytevec_t blob;
+    blob.resize(secondaries.size() * sizeof(fake_secondary_record_t));
+    for (size_t i = 0; i < secondaries.size(); i++)
+    {
+        const fake_secondary_t& secondary = secondaries[i];
+        fake_secondary_record_t record = {};
+        record.ea = secondary.ea;
+        record.value = secondary.value;
+        record.itype = secondary.itype;
+        record.size = secondary.size;
+        record.optype = secondary.optype;
+        record.dtype = secondary.dtype;
+        memcpy(&blob[i * sizeof(record)], &record, sizeof(record));
+    }
+    storage.setblob(&blob[0], blob.size(), 0, 'S');
+}
+
+void fake_secondary_store_t::load_from_idb()
+{
+    secondaries.clear();
+    storage.create(fake_secondary_node_name);
+    if (storage.altval(0) != fake_secondary_version) return;
+
+    bytevec_t blob;
+    if (storage.getblob(&blob, 0, 'S') <= 0) return;
+    if (blob.size() % sizeof(fake_secondary_record_t) != 0)
+    {
+        WARN("Ignoring fake secondary instructions stored in the database, blob has unexpected size 0x%zx", blob.size());
+        return;
+    }
+
+    secondaries.resize(blob.size() / sizeof(fake_secondary_record_t));
+    for (size_t i = 0; i < secondaries.size(); i++)
+    {
+        fake_secondary_record_t record;
+        memcpy(&record, &blob[i * sizeof(record)], sizeof(record));
+        fake_secondary_t& secondary = secondaries[i];
+        secondary.ea = record.ea;
+        secondary.value = record.value;
+        secondary.itype = record.itype;
+        secondary.size = record.size;
+        secondary.optype = record.optype;
+        secondary.dtype = record.dtype;
+    }
+    LOG("Loaded %zu fake secondary instructions from the database", secondaries.size());
+}
+
+void fake_secondary_store_t::log_stats()
+{
+    LOG("fake secondary instructions: %zu entries, %zu bytes (%zu allocated)",
+        secondaries.size(), secondaries.size() * sizeof(fake_secondary_t), secondaries.capacity() * sizeof(fake_secondary_t));
+}
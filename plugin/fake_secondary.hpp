@@ -0,0 +1,106 @@
+#ifndef __FAKE_SECONDARY_H
+#define __FAKE_SECONDARY_H
+
+#include <pro.h>
+#include <idp.hpp>
+#include <netnode.hpp>
+#include <segment.hpp>
+
+/**
+ * @brief The second half of an instruction that combines two ordinary mips instructions (move.balc, restore.jrc).
+ * It lives at the address of the real instruction + 1 and has a single operand, either a register or a code address.
+ */
+struct fake_secondary_t
+{
+    ea_t ea = BADADDR;
+
+    /**
+     * @brief Register number for o_reg, address otherwise.
+     */
+    ea_t value = 0;
+    uint16 itype = 0;
+    uint8 size = 0;
+    uint8 optype = o_void;
+    uint8 dtype = 0;
+
+    /**
+     * @brief Fills insn with this instruction.
+     */
+    void fill(insn_t& insn) const;
+};
+
+/**
+ * @brief Sorted store of all fake secondary instructions, persisted in the database.
+ * The instruction at ea + 1 is only created by ana of the real instruction at ea,
+ * so without storing them, opening a database would need every combined instruction to be analyzed again.
+ * Entries are dropped when the bytes of the real instruction are patched or its segment is deleted,
+ * and move with their segment, together with the code addresses they refer to.
+ */
+struct fake_secondary_store_t : public event_listener_t
+{
+public:
+    virtual ssize_t idaapi on_event(ssize_t code, va_list va) override;
+
+    void enable_hooks(bool enable);
+
+    /**
+     * @brief Adds the secondary instruction, replacing any previous one at the same address.
+     */
+    void add(const fake_secondary_t& secondary);
+
+    /**
+     * @brief The secondary instruction at ea, nullptr if there is none.
+     */
+    const fake_secondary_t* find(ea_t ea) const
+    {
+        // real instructions are 2 byte aligned, so all secondary instructions are at odd addresses.
+        if ((ea & 1) == 0 || secondaries.empty()) return nullptr;
+        return find_slow(ea);
+    }
+
+    /**
+     * @brief Removes all secondary instructions in [start, end).
+     */
+    void erase_range(ea_t start, ea_t end);
+
+    /**
+     * @brief Called for every segm_moved, moves the secondary instructions in [from, from + size) to to.
+     */
+    void move_range(ea_t from, ea_t to, asize_t size);
+
+    /**
+     * @brief Called for allsegs_moved once the program was rebased, moves the secondary instructions of every segment in moves.
+     */
+    void move_segments(const segm_move_infos_t& moves);
+
+    void clear();
+
+    void save_to_idb();
+    void load_from_idb();
+
+    /**
+     * @brief Logs the number of secondary instructions and the memory used for them.
+     */
+    void log_stats();
+
+private:
+    const fake_secondary_t* find_slow(ea_t ea) const;
+
+    /**
+     * @brief Replaces secondaries with old_secondaries, moving every address by the first of moves whose source contains it.
+     */
+    void remap(const qvector<fake_secondary_t>& old_secondaries, const segm_move_infos_t& moves);
+
+    qvector<fake_secondary_t> secondaries;
+
+    /**
+     * @brief The secondary instructions before the first segm_moved since the last allsegs_moved, and the segments moved since.
+     * Like reloc_index_t, every move of a rebase is applied to the addresses from before it,
+     * so nothing that was moved onto the old place of another segment is moved twice.
+     */
+    qvector<fake_secondary_t> unmoved_secondaries;
+    segm_move_infos_t pending_moves;
+    netnode storage;
+};
+
+#endif /* __FAKE_SECONDARY_H */
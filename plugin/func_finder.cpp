@@ -0,0 +1,251 @@
+#define LOG_CATEGORY log_analysis
+#include "func_finder.hpp"
+#include "auto.hpp"
+#include "bytes.hpp"
+#include "log.hpp"
+#include "segment.hpp"
+#include <chrono>
+
+static bool is_code_segment(const segment_t* seg)
+{
+    return seg != NULL && ((seg->perm & SEGPERM_EXEC) != 0 || seg->type == SEG_CODE);
+}
+
+ssize_t func_finder_t::on_event(ssize_t code, va_list va)
+{
+    switch (code) {
+    // after the loader, so branch targets in code have been relocated.
+    case idb_event::loader_finished:
+    {
+        discover();
+    }
+    break;
+    // IDA decided this is code, so what the sweep derived from it holds.
+    case idb_event::make_code:
+    {
+        const insn_t* insn = va_arg(va, const insn_t*);
+        confirm_source(insn->ea);
+    }
+    break;
+    case idb_event::auto_empty_finally:
+    {
+        log_stats();
+    }
+    break;
+    case idb_event::closebase:
+    {
+        clear();
+    }
+    break;
+    }
+    return 0;
+}
+
+void func_finder_t::enable_hooks(bool enable)
+{
+    if (enable) {
+        hook_event_listener(HT_IDB, this, this);
+    } else {
+        unhook_event_listener(HT_IDB, this);
+        clear();
+    }
+}
+
+static bool candidate_less(const func_candidate_t& a, const func_candidate_t& b)
+{
+    return a.start != b.start ? a.start < b.start : a.source < b.source;
+}
+
+size_t func_finder_t::discover()
+{
+    clear();
+
+    auto start = std::chrono::steady_clock::now();
+    bytevec_t bytes;
+    int qty = get_segm_qty();
+    for (int i = 0; i < qty; i++)
+    {
+        segment_t* seg = getnseg(i);
+        if (!is_code_segment(seg)) continue;
+
+        bytes.resize(seg->size());
+        ssize_t nbytes = get_bytes(&bytes[0], seg->size(), seg->start_ea);
+        if (nbytes < 2) continue;
+        sweep(seg->start_ea, &bytes[0], nbytes);
+    }
+
+    // call targets can point anywhere, e.g. when data in a code segment was swept.
+    std::sort(candidates.begin(), candidates.end(), candidate_less);
+    auto end = std::unique(candidates.begin(), candidates.end(),
+        [](const func_candidate_t& a, const func_candidate_t& b) { return a.start == b.start && a.source == b.source; });
+    end = std::remove_if(candidates.begin(), end,
+        [](const func_candidate_t& c) { return (c.start & 1) != 0 || !is_code_segment(getseg(c.start)); });
+    candidates.resize(end - candidates.begin());
+    confirmed.resize(candidates.size());
+
+    by_source.resize(candidates.size());
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        by_source[i] = i;
+    }
+    std::sort(by_source.begin(), by_source.end(), [&](uint32 a, uint32 b) { return candidates[a].source < candidates[b].source; });
+
+    size_t num_starts = 0;
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        ea_t ea = candidates[i].start;
+        bool first = i == 0 || candidates[i - 1].start != ea;
+        num_starts += first;
+        if (!is_code(get_flags(candidates[i].source)))
+        {
+            // a save that is called from elsewhere, two rules agreeing is unlikely in data.
+            bool is_save = false;
+            bool is_called = false;
+            for (size_t j = i; j < candidates.size() && candidates[j].start == ea; j++)
+            {
+                if (candidates[j].source == ea) is_save = true;
+                else is_called = true;
+            }
+            for (size_t j = i; j > 0 && candidates[j - 1].start == ea; j--)
+            {
+                if (candidates[j - 1].source == ea) is_save = true;
+                else is_called = true;
+            }
+            if (!is_save || !is_called) continue;
+        }
+        confirm(i);
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG("Found %zu function starts in %.1f ms, %llu confirmed", num_starts, ms, (unsigned long long)num_confirmed);
+    return num_starts;
+}
+
+void func_finder_t::confirm(size_t index)
+{
+    if (confirmed[index]) return;
+    ea_t ea = candidates[index].start;
+    // every candidate for the same start counts as planned.
+    for (size_t i = index; i < candidates.size() && candidates[i].start == ea; i++)
+    {
+        confirmed[i] = 1;
+    }
+    for (size_t i = index; i > 0 && candidates[i - 1].start == ea; i--)
+    {
+        confirmed[i - 1] = 1;
+    }
+    auto_make_proc(ea);
+    num_confirmed++;
+}
+
+void func_finder_t::confirm_source(ea_t ea)
+{
+    auto it = std::lower_bound(by_source.begin(), by_source.end(), ea,
+        [&](uint32 index, ea_t source) { return candidates[index].source < source; });
+    for (; it != by_source.end() && candidates[*it].source == ea; ++it)
+    {
+        confirm(*it);
+    }
+}
+
+int func_finder_t::confidence(ea_t ea) const
+{
+    func_candidate_t key;
+    key.start = ea;
+    key.source = 0;
+    auto it = std::lower_bound(candidates.begin(), candidates.end(), key, candidate_less);
+    if (it == candidates.end() || it->start != ea) return 0;
+    return confirmed[it - candidates.begin()] ? 100 : 0;
+}
+
+void func_finder_t::sweep(ea_t start_ea, const uchar* bytes, size_t size)
+{
+    if (kinds.empty())
+    {
+        kinds.resize(bfd_nanomips_num_opcodes);
+        for (int i = 0; i < bfd_nanomips_num_opcodes; i++)
+        {
+            const char* name = nanomips_opcodes[i].name;
+            if (strcmp(name, "save") == 0) kinds[i] = func_insn_save;
+            else if (strcmp(name, "balc") == 0 || strcmp(name, "move.balc") == 0) kinds[i] = func_insn_call;
+            else if (strcmp(name, "restore.jrc") == 0) kinds[i] = func_insn_return;
+            else if (strcmp(name, "nop") == 0) kinds[i] = func_insn_padding;
+        }
+    }
+
+    nanomips_insn_stream stream;
+    nanomips_stream_init(&stream);
+    if (nanomips_decode_range(&decoder, bytes, size, start_ea, &stream) == (size_t)-1)
+    {
+        ERR("Out of memory sweeping 0x%x for functions", start_ea);
+        nanomips_stream_free(&stream);
+        return;
+    }
+
+    // a restore.jrc can also be an early return, only nops after it make sure the function ended.
+    // anything undecodable means the sweep ran into data, which is neither padding nor a function.
+    ea_t return_ea = BADADDR;
+    bool padded = false;
+    for (size_t i = 0; i < stream.count; i++)
+    {
+        uint16 opcode = stream.opcode[i];
+        if (opcode == NANOMIPS_STREAM_INVALID)
+        {
+            return_ea = BADADDR;
+            padded = false;
+            continue;
+        }
+        uint8 kind = kinds[opcode];
+        if (kind == func_insn_padding)
+        {
+            padded = return_ea != BADADDR;
+            continue;
+        }
+
+        ea_t ea = start_ea + stream.offset[i];
+        if (padded)
+        {
+            candidates.push_back({ ea, return_ea });
+            num_after_return++;
+        }
+        return_ea = BADADDR;
+        padded = false;
+
+        switch (kind)
+        {
+        case func_insn_save:
+            candidates.push_back({ ea, ea });
+            num_saves++;
+            break;
+        case func_insn_call:
+            if (stream.target[i] != NANOMIPS_NO_TARGET)
+            {
+                candidates.push_back({ (ea_t)stream.target[i], ea });
+                num_call_targets++;
+            }
+            break;
+        case func_insn_return:
+            return_ea = ea;
+            break;
+        }
+    }
+    nanomips_stream_free(&stream);
+}
+
+void func_finder_t::clear()
+{
+    candidates.clear();
+    confirmed.clear();
+    by_source.clear();
+    num_saves = 0;
+    num_call_targets = 0;
+    num_after_return = 0;
+    num_confirmed = 0;
+}
+
+void func_finder_t::log_stats()
+{
+    LOG("function finder: %zu candidates, from %llu saves, %llu call targets and %llu after returns, %llu starts confirmed",
+        candidates.size(), (unsigned long long)num_saves, (unsigned long long)num_call_targets, (unsigned long long)num_after_return,
+        (unsigned long long)num_confirmed);
+}
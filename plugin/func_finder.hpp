@@ -0,0 +1,124 @@
+#ifndef __FUNC_FINDER_H
+#define __FUNC_FINDER_H
+
+#include <pro.h>
+#include <idp.hpp>
+#include <algorithm>
+#include "nanomips-dis.h"
+
+/**
+ * @brief What an opcode tells about the function boundaries around it.
+ */
+enum func_finder_kind_t : uint8
+{
+    func_insn_other = 0,
+    /**
+     * @brief save, always the first instruction of a function.
+     */
+    func_insn_save,
+    /**
+     * @brief balc and move.balc, the target starts a function.
+     */
+    func_insn_call,
+    /**
+     * @brief restore.jrc, the last instruction of a function.
+     */
+    func_insn_return,
+    /**
+     * @brief nop, used to align the next function.
+     */
+    func_insn_padding,
+};
+
+/**
+ * @brief A function start found by the sweep.
+ */
+struct func_candidate_t
+{
+    ea_t start = BADADDR;
+
+    /**
+     * @brief The instruction the start was derived from, the save itself, the balc or the restore.jrc.
+     */
+    ea_t source = BADADDR;
+};
+
+/**
+ * @brief Finds function starts in a single linear sweep over the code segments, once the loader is done.
+ * Otherwise, IDA asks may_be_func about every candidate, which walks all code references to it and decodes each of them.
+ * A function might start at every save, at every target of a balc or move.balc, and after the nops following a restore.jrc.
+ * The sweep cannot tell code from data, so only confirmed starts are planned:
+ * those whose source instruction IDA already created, and saves that are also called.
+ * The others are planned one at a time, once IDA creates their source instruction. Until then they count for nothing,
+ * the linear sweep also decodes literal pools and jump tables, and may_be_func walks the code references as before.
+ */
+struct func_finder_t : public event_listener_t
+{
+public:
+    func_finder_t(const nanomips_decoder& decoder) : decoder(decoder) {};
+
+    virtual ssize_t idaapi on_event(ssize_t code, va_list va) override;
+
+    void enable_hooks(bool enable);
+
+    /**
+     * @brief Sweeps all executable segments and plans a function at every confirmed start.
+     * @return The number of function starts found, confirmed or not.
+     */
+    size_t discover();
+
+    /**
+     * @brief Sweeps the size bytes located at start_ea and adds the function starts in there to the candidates.
+     * Candidates are only sorted, checked against the segments and confirmed by discover.
+     */
+    void sweep(ea_t start_ea, const uchar* bytes, size_t size);
+
+    /**
+     * @brief How likely a function starts at ea according to the sweep, 100 if it is a confirmed start and 0 otherwise.
+     */
+    int confidence(ea_t ea) const;
+
+    /**
+     * @brief Plans the starts derived from the instruction at ea, which IDA just created.
+     */
+    void confirm_source(ea_t ea);
+
+    void clear();
+
+    /**
+     * @brief Logs the number of function starts found by each rule, and how many were confirmed.
+     */
+    void log_stats();
+
+    uint64 num_saves = 0;
+    uint64 num_call_targets = 0;
+    uint64 num_after_return = 0;
+    uint64 num_confirmed = 0;
+
+private:
+    void confirm(size_t index);
+
+    const nanomips_decoder& decoder;
+
+    /**
+     * @brief Sorted by start, then source.
+     */
+    qvector<func_candidate_t> candidates;
+
+    /**
+     * @brief Whether the start of each entry in candidates was planned already.
+     */
+    qvector<uint8> confirmed;
+
+    /**
+     * @brief Indices into candidates, sorted by source.
+     */
+    qvector<uint32> by_source;
+
+    /**
+     * @brief func_finder_kind_t of every entry of nanomips_opcodes.
+     */
+    qvector<uint8> kinds;
+};
+
+#endif /* __FUNC_FINDER_H */
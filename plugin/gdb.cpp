@@ -1,3 +1,4 @@
+#define LOG_CATEGORY log_debugger
 #include "gdb.hpp"
 #include "nmips.hpp"
 #include "log.hpp"
@@ -16,8 +17,8 @@ const char* test_handler(lexer_t* lex, const token_t &keyword, const token_t &va
     int linenum = 0;
     const char* lineptr = NULL;
     lex_get_file_line(lex, &linenum, &lineptr, 0);
-    LOG("Handler: %s / %d", keyword.str.c_str(), value.type);
-    LOG("Line: %d: %s", linenum, lineptr);
+    DLOG("Handler: %s / %d", keyword.str.c_str(), value.type);
+    DLOG("Line: %d: %s", linenum, lineptr);
     return NULL;
 }
 
@@ -335,7 +336,7 @@ const char* config_patcher_t::handle(lexer_t *lx, const token_t &keyword, const
     append_missing_lines(startline);
     qstring token_str;
     lex_print_token(&token_str, &value);
-    LOG("Handler: %s / %s", keyword.str.c_str(), token_str.c_str());
+    DLOG("Handler: %s / %s", keyword.str.c_str(), token_str.c_str());
 
     qstring key = keyword.str;
 
@@ -2,118 +2,133 @@
 #define __INS_H
 
 #include <idp.hpp>
-#include <map>
-#include <string>
+#include "constants.hpp"
 
-enum nanomips_extra_inst_t : uint16
+enum nanomips_branch_t : uint8
 {
-    nMIPS_todo = CUSTOM_INSN_ITYPE,
-
-    // save / restore
-    nMIPS_save,
-    nMIPS_restore_jrc,
-
-    // branch instructions
-    nMIPS_bc,
-    nMIPS_beqic,
-    nMIPS_bgeic,
-    nMIPS_bgeiuc,
-    nMIPS_bltic,
-    nMIPS_bltiuc,
-    nMIPS_bneic,
-
-    nMIPS_bltc,
-    nMIPS_bltuc,
-    nMIPS_bgec,
-    nMIPS_bgeuc,
-    nMIPS_beqc,
-    nMIPS_bnec,
-
-    nMIPS_bgezc,
-    nMIPS_blezc,
-
-    // combined instructions
-    nMIPS_move_balc,
-
-    // Math ops
-    nMIPS_muh,
-
-    // TODO: Actually implement these!
-    nMIPS_align,
-
-    nMIPS_bbeqzc,
-    nMIPS_bbneqzc,
-
-    nMIPS_bitrevb,
-    nMIPS_bitrevw,
-    nMIPS_bitswap,
-    nMIPS_byterevh,
-    nMIPS_byterevw,
-
-    nMIPS_crc32b,
-    nMIPS_crc32cb,
-    nMIPS_crc32ch,
-    nMIPS_crc32cw,
-    nMIPS_crc32h,
-    nMIPS_crc32w,
-
-    nMIPS_extw,
-    nMIPS_ginvi,
-    nMIPS_ginvt,
-
-    nMIPS_lhuxs,
-    nMIPS_lhxs,
-    nMIPS_llwp,
-    nMIPS_llwpe,
-
-    nMIPS_mfhc0,
-    nMIPS_mthc0,
-
-    nMIPS_mod,
-    nMIPS_modu,
-    nMIPS_muhu,
-    nMIPS_mulu,
-
-    nMIPS_rotx,
-
-    nMIPS_sbx,
-    nMIPS_scwp,
-    nMIPS_scwpe,
-    nMIPS_shx,
-    nMIPS_shxs,
-    nMIPS_swx,
-    nMIPS_swxs,
-
-    nMIPS_sigrie,
+    nmips_branch_none,
+    // unconditional jump
+    nmips_branch_uncond,
+    // conditional, comparing two operands (register / register or register / immediate)
+    nmips_branch_cmp,
+    // conditional, comparing one register against zero
+    nmips_branch_zero,
+};
 
-    nMIPS_sov,
+/**
+ * All custom instructions, in itype order.
+ * X(name, mnemonic, features, branch kind)
+ * The enum and the metadata table below are both generated from this, so they can never get out of sync.
+ */
+#define NANOMIPS_EXTRA_INSNS(X) \
+    X(todo, "todo", 0, nmips_branch_none) \
+    /* save / restore */ \
+    X(save, "save", 0, nmips_branch_none) \
+    X(restore_jrc, "restore.jrc", 0, nmips_branch_none) \
+    /* branch instructions */ \
+    X(bc, "bc", CF_JUMP, nmips_branch_uncond) \
+    X(beqic, "beqic", CF_JUMP | CCF_COND, nmips_branch_cmp) \
+    X(bgeic, "bgeic", CF_JUMP | CCF_COND, nmips_branch_cmp) \
+    X(bgeiuc, "bgeiuc", CF_JUMP | CCF_COND, nmips_branch_cmp) \
+    X(bltic, "bltic", CF_JUMP | CCF_COND, nmips_branch_cmp) \
+    X(bltiuc, "bltiuc", CF_JUMP | CCF_COND, nmips_branch_cmp) \
+    X(bneic, "bneic", CF_JUMP | CCF_COND, nmips_branch_cmp) \
+    X(bltc, "bltc", CF_JUMP | CCF_COND, nmips_branch_cmp) \
+    X(bltuc, "bltuc", CF_JUMP | CCF_COND, nmips_branch_cmp) \
+    X(bgec, "bgec", CF_JUMP | CCF_COND, nmips_branch_cmp) \
+    X(bgeuc, "bgeuc", CF_JUMP | CCF_COND, nmips_branch_cmp) \
+    X(beqc, "beqc", CF_JUMP | CCF_COND, nmips_branch_cmp) \
+    X(bnec, "bnec", CF_JUMP | CCF_COND, nmips_branch_cmp) \
+    X(bgezc, "bgezc", CF_JUMP | CCF_COND, nmips_branch_zero) \
+    X(blezc, "blezc", CF_JUMP | CCF_COND, nmips_branch_zero) \
+    /* combined instructions */ \
+    X(move_balc, "move.balc", 0, nmips_branch_none) \
+    /* Math ops */ \
+    X(muh, "muh", 0, nmips_branch_none) \
+    /* TODO: Actually implement these! */ \
+    X(align, "align", 0, nmips_branch_none) \
+    X(bbeqzc, "bbeqzc", CF_JUMP | CCF_COND, nmips_branch_cmp) \
+    X(bbneqzc, "bbneqzc", CF_JUMP | CCF_COND, nmips_branch_cmp) \
+    X(bitrevb, "bitrevb", 0, nmips_branch_none) \
+    X(bitrevw, "bitrevw", 0, nmips_branch_none) \
+    X(bitswap, "bitswap", 0, nmips_branch_none) \
+    X(byterevh, "byterevh", 0, nmips_branch_none) \
+    X(byterevw, "byterevw", 0, nmips_branch_none) \
+    X(crc32b, "crc32b", 0, nmips_branch_none) \
+    X(crc32cb, "crc32cb", 0, nmips_branch_none) \
+    X(crc32ch, "crc32ch", 0, nmips_branch_none) \
+    X(crc32cw, "crc32cw", 0, nmips_branch_none) \
+    X(crc32h, "crc32h", 0, nmips_branch_none) \
+    X(crc32w, "crc32w", 0, nmips_branch_none) \
+    X(extw, "extw", 0, nmips_branch_none) \
+    X(ginvi, "ginvi", 0, nmips_branch_none) \
+    X(ginvt, "ginvt", 0, nmips_branch_none) \
+    X(lhuxs, "lhuxs", 0, nmips_branch_none) \
+    X(lhxs, "lhxs", 0, nmips_branch_none) \
+    X(llwp, "llwp", 0, nmips_branch_none) \
+    X(llwpe, "llwpe", 0, nmips_branch_none) \
+    X(mfhc0, "mfhc0", 0, nmips_branch_none) \
+    X(mthc0, "mthc0", 0, nmips_branch_none) \
+    X(mod, "mod", 0, nmips_branch_none) \
+    X(modu, "modu", 0, nmips_branch_none) \
+    X(muhu, "muhu", 0, nmips_branch_none) \
+    X(mulu, "mulu", 0, nmips_branch_none) \
+    X(rotx, "rotx", 0, nmips_branch_none) \
+    X(sbx, "sbx", 0, nmips_branch_none) \
+    X(scwp, "scwp", 0, nmips_branch_none) \
+    X(scwpe, "scwpe", 0, nmips_branch_none) \
+    X(shx, "shx", 0, nmips_branch_none) \
+    X(shxs, "shxs", 0, nmips_branch_none) \
+    X(swx, "swx", 0, nmips_branch_none) \
+    X(swxs, "swxs", 0, nmips_branch_none) \
+    X(sigrie, "sigrie", 0, nmips_branch_none) \
+    X(sov, "sov", 0, nmips_branch_none) \
+    X(tlbinv, "tlbinv", 0, nmips_branch_none) \
+    X(tlbinvf, "tlbinvf", 0, nmips_branch_none)
+
+#define NANOMIPS_EXTRA_INSN_ENUM(name, mnemonic, features, branch) nMIPS_ ## name,
+#define NANOMIPS_EXTRA_INSN_INFO(name, mnemonic, features, branch) {mnemonic, features, branch},
 
-    nMIPS_tlbinv,
-    nMIPS_tlbinvf,
+enum nanomips_extra_inst_t : uint16
+{
+    nMIPS_first_extra = CUSTOM_INSN_ITYPE - 1,
+    NANOMIPS_EXTRA_INSNS(NANOMIPS_EXTRA_INSN_ENUM)
+    nMIPS_last,
 };
 
 struct nanomips_insn_t
 {
-    nanomips_extra_inst_t itype;
     const char* mnemonic;
     uint32 features;
+    nanomips_branch_t branch;
 };
 
-extern std::map<nanomips_extra_inst_t, nanomips_insn_t> nanomips_insn;
+/**
+ * Metadata of all custom instructions, indexed by itype - CUSTOM_INSN_ITYPE.
+ */
+inline constexpr nanomips_insn_t nanomips_insn[] = {
+    NANOMIPS_EXTRA_INSNS(NANOMIPS_EXTRA_INSN_INFO)
+};
+
+static_assert(nMIPS_todo == CUSTOM_INSN_ITYPE, "custom instructions have to start at CUSTOM_INSN_ITYPE");
+static_assert(sizeof(nanomips_insn) / sizeof(nanomips_insn[0]) == nMIPS_last - CUSTOM_INSN_ITYPE, "nanomips_insn is indexed by itype");
+
+#undef NANOMIPS_EXTRA_INSN_ENUM
+#undef NANOMIPS_EXTRA_INSN_INFO
 
-#define CASE_BRANCH_COND     case nMIPS_bltic: \
-    case nMIPS_bltiuc: \
-    case nMIPS_beqic: \
-    case nMIPS_bgeic: \
-    case nMIPS_bgeiuc: \
-    case nMIPS_bneic: \
-    case nMIPS_bltc: \
-    case nMIPS_bltuc: \
-    case nMIPS_bgec: \
-    case nMIPS_bgeuc: \
-    case nMIPS_beqc: \
-    case nMIPS_bnec: \
-    case nMIPS_bbeqzc: \
-    case nMIPS_bbneqzc:
+/**
+ * @brief Metadata of a custom instruction.
+ * @return nullptr if itype is not one of ours.
+ */
+constexpr const nanomips_insn_t* get_nanomips_insn(uint16 itype)
+{
+    return itype >= CUSTOM_INSN_ITYPE && itype < nMIPS_last ? &nanomips_insn[itype - CUSTOM_INSN_ITYPE] : nullptr;
+}
+
+constexpr nanomips_branch_t get_nanomips_branch(uint16 itype)
+{
+    const nanomips_insn_t* insn = get_nanomips_insn(itype);
+    return insn != nullptr ? insn->branch : nmips_branch_none;
+}
 
 #endif /* __INS_H */
@@ -0,0 +1,375 @@
+#define LOG_CATEGORY log_analysis
+#include "insn_index.hpp"
+#include "bytes.hpp"
+#include "dbg.hpp"
+#include "log.hpp"
+#include "segment.hpp"
+#include "nanomips-len.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <thread>
+
+/**
+ * @brief Segments smaller than this are decoded in one piece, starting threads would take longer.
+ */
+constexpr size_t insn_index_min_chunk_bytes = 64 * 1024;
+
+/**
+ * @brief Chunks per thread, so threads that get easier chunks do not sit idle at the end.
+ */
+constexpr size_t insn_index_chunks_per_thread = 4;
+
+static uint64 hash_page(const uchar* bytes, size_t size)
+{
+    // FNV-1a
+    uint64 hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Calls task(0) up to task(num_tasks - 1), on at most threads threads including the calling one.
+ */
+template<class Task>
+static void run_parallel(size_t threads, size_t num_tasks, Task task)
+{
+    std::atomic<size_t> next_task{0};
+    auto worker = [&]() {
+        for (size_t i = next_task++; i < num_tasks; i = next_task++)
+        {
+            task(i);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < std::min(threads, num_tasks); i++)
+    {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool)
+    {
+        thread.join();
+    }
+}
+
+ssize_t insn_index_t::on_event(ssize_t code, va_list va)
+{
+    switch (code) {
+    case idb_event::byte_patched:
+    {
+        ea_t ea = va_arg(va, ea_t);
+        indexed_segment_t* seg = find(ea);
+        if (seg != nullptr) seg->stale[(ea - seg->start_ea) >> mirror_page_bits] = 1;
+    }
+    break;
+    // relocations may have been applied to code after the data was loaded.
+    case idb_event::loader_finished:
+    {
+        verify();
+    }
+    break;
+    case idb_event::auto_empty_finally:
+    {
+        log_stats();
+    }
+    break;
+    case idb_event::segm_added:
+    case idb_event::segm_deleted:
+    case idb_event::segm_start_changed:
+    case idb_event::segm_end_changed:
+    case idb_event::segm_moved:
+    case idb_event::allsegs_moved:
+    case idb_event::closebase:
+    {
+        clear();
+    }
+    break;
+    }
+    return 0;
+}
+
+ssize_t insn_index_dbg_listener_t::on_event(ssize_t code, va_list va)
+{
+    switch (code) {
+    // decode does not use the index while debugging, memory snapshots may have changed the bytes since.
+    case dbg_process_exit:
+    case dbg_process_detach:
+    {
+        index.verify();
+    }
+    break;
+    }
+    return 0;
+}
+
+void insn_index_t::enable_hooks(bool enable)
+{
+    if (enable) {
+        hook_event_listener(HT_IDB, this, this);
+        hook_event_listener(HT_DBG, &dbg_listener, this);
+    } else {
+        unhook_event_listener(HT_IDB, this);
+        unhook_event_listener(HT_DBG, &dbg_listener);
+        clear();
+    }
+}
+
+void insn_index_t::build()
+{
+    clear();
+    if (threads < 0) return;
+
+    auto start = std::chrono::steady_clock::now();
+    size_t count = 0;
+    bytevec_t bytes;
+    int qty = get_segm_qty();
+    for (int i = 0; i < qty; i++)
+    {
+        segment_t* seg = getnseg(i);
+        if (seg == NULL) continue;
+        if ((seg->perm & SEGPERM_EXEC) == 0 && seg->type != SEG_CODE) continue;
+
+        // without GMB_READALL, get_bytes stops at the first uninitialized byte.
+        bytes.resize(seg->size());
+        ssize_t nbytes = get_bytes(&bytes[0], seg->size(), seg->start_ea);
+        if (nbytes < 2) continue;
+        count += build_segment(seg->start_ea, &bytes[0], nbytes, threads);
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG("Pre-decoded %zu instructions in %zu segments in %.1f ms", count, segments.size(), ms);
+}
+
+size_t insn_index_t::build_segment(ea_t start_ea, const uchar* bytes, size_t size, int threads)
+{
+    size &= ~(size_t)1;
+    size_t num_halfwords = size / 2;
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // chunk boundaries have to be instruction boundaries, which only needs the lengths.
+    qvector<uint32> boundaries;
+    boundaries.push_back(0);
+    size_t num_chunks = std::min<size_t>(threads * insn_index_chunks_per_thread, size / insn_index_min_chunk_bytes);
+    if (num_chunks > 1)
+    {
+        qvector<uint8> lengths;
+        qvector<uint32> insn_starts;
+        lengths.resize(num_halfwords);
+        insn_starts.resize(num_halfwords);
+        nanomips_classify_lengths(bytes, size, decoder.big_endian, &lengths[0]);
+        size_t num_starts = nanomips_insn_starts(&lengths[0], num_halfwords, 0, &insn_starts[0], num_halfwords);
+        for (size_t i = 1; i < num_chunks; i++)
+        {
+            uint32 boundary = insn_starts[num_starts * i / num_chunks];
+            if (boundary > boundaries.back()) boundaries.push_back(boundary);
+        }
+    }
+    boundaries.push_back(size);
+    num_chunks = boundaries.size() - 1;
+
+    // decode every chunk into a stream of its own.
+    qvector<nanomips_insn_stream> streams;
+    streams.resize(num_chunks);
+    run_parallel(threads, num_chunks, [&](size_t i) {
+        nanomips_stream_init(&streams[i]);
+        nanomips_decode_range(&decoder, bytes + boundaries[i], boundaries[i + 1] - boundaries[i],
+                              start_ea + boundaries[i], &streams[i]);
+    });
+
+    qvector<size_t> first_slot, first_val;
+    size_t count = 0, num_vals = 0;
+    for (auto& stream : streams)
+    {
+        first_slot.push_back(count);
+        first_val.push_back(num_vals);
+        count += stream.count;
+        num_vals += stream.num_vals;
+    }
+
+    indexed_segment_t& seg = segments.push_back();
+    seg.start_ea = start_ea;
+    seg.end_ea = start_ea + size;
+    seg.starts.resize((num_halfwords + 63) / 64);
+    seg.rank.resize(seg.starts.size());
+    seg.opcode.resize(count);
+    seg.length.resize(count);
+    seg.vals_start.resize(count + 1);
+    seg.vals.resize(num_vals);
+    seg.vals_start[count] = num_vals;
+
+    size_t num_pages = (size + mirror_page_bytes - 1) >> mirror_page_bits;
+    seg.page_hash.resize(num_pages);
+    seg.stale.resize(num_pages);
+
+    // then copy them into place, each chunk has its own range of slots, values and pages.
+    // only the first and last word of starts can be shared with the neighbouring chunks, those are merged afterwards.
+    qvector<uint64> edge_words;
+    edge_words.resize(num_chunks * 2);
+    run_parallel(threads, num_chunks, [&](size_t i) {
+        nanomips_insn_stream& stream = streams[i];
+        size_t first_word = boundaries[i] / 128;
+        size_t last_word = (boundaries[i + 1] - 1) / 128;
+        size_t word = first_word;
+        uint64 bits = 0;
+        auto flush = [&]() {
+            if (word == first_word) edge_words[2 * i] = bits;
+            else if (word == last_word) edge_words[2 * i + 1] = bits;
+            else seg.starts[word] = bits;
+        };
+
+        size_t slot = first_slot[i];
+        for (size_t j = 0; j < stream.count; j++, slot++)
+        {
+            size_t halfword = (boundaries[i] + stream.offset[j]) / 2;
+            if (halfword / 64 != word)
+            {
+                flush();
+                word = halfword / 64;
+                bits = 0;
+            }
+            bits |= (uint64)1 << (halfword % 64);
+            seg.opcode[slot] = stream.opcode[j];
+            seg.length[slot] = stream.length[j];
+            seg.vals_start[slot] = first_val[i] + stream.vals_start[j];
+        }
+        flush();
+        if (stream.num_vals != 0) memcpy(&seg.vals[first_val[i]], stream.vals, stream.num_vals * sizeof(uint32));
+        nanomips_stream_free(&stream);
+
+        size_t first_page = (boundaries[i] + mirror_page_bytes - 1) >> mirror_page_bits;
+        size_t end_page = (boundaries[i + 1] + mirror_page_bytes - 1) >> mirror_page_bits;
+        for (size_t page = first_page; page < end_page; page++)
+        {
+            size_t offset = page << mirror_page_bits;
+            seg.page_hash[page] = hash_page(bytes + offset, std::min(mirror_page_bytes, size - offset));
+        }
+    });
+    for (size_t i = 0; i < num_chunks; i++)
+    {
+        seg.starts[boundaries[i] / 128] |= edge_words[2 * i];
+        seg.starts[(boundaries[i + 1] - 1) / 128] |= edge_words[2 * i + 1];
+    }
+
+    uint32 rank = 0;
+    for (size_t i = 0; i < seg.starts.size(); i++)
+    {
+        seg.rank[i] = rank;
+        rank += std::popcount(seg.starts[i]);
+    }
+
+    // build adds segments in address order, but build_segment can be called by itself.
+    std::sort(segments.begin(), segments.end(),
+        [](const indexed_segment_t& a, const indexed_segment_t& b) { return a.start_ea < b.start_ea; });
+    last_hit = 0;
+    return count;
+}
+
+indexed_segment_t* insn_index_t::find(ea_t ea)
+{
+    if (segments.empty()) return nullptr;
+
+    indexed_segment_t* seg = &segments[last_hit];
+    if (ea >= seg->start_ea && ea < seg->end_ea) return seg;
+
+    auto it = std::upper_bound(segments.begin(), segments.end(), ea,
+        [](ea_t addr, const indexed_segment_t& s) { return addr < s.start_ea; });
+    if (it == segments.begin()) return nullptr;
+    --it;
+    if (ea >= it->end_ea) return nullptr;
+
+    last_hit = it - segments.begin();
+    return &*it;
+}
+
+bool insn_index_t::lookup(ea_t ea, const struct nanomips_opcode** op, nanomips_decoded_op* operands, size_t* size)
+{
+    // instructions are 2 byte aligned, odd addresses are fake secondary instructions.
+    if (segments.empty() || (ea & 1) != 0) return false;
+
+    indexed_segment_t* seg = find(ea);
+    if (seg == nullptr)
+    {
+        misses++;
+        return false;
+    }
+
+    size_t halfword = (ea - seg->start_ea) / 2;
+    uint64 word = seg->starts[halfword / 64];
+    uint64 below = word & (((uint64)1 << (halfword % 64)) - 1);
+    if ((word >> (halfword % 64) & 1) == 0)
+    {
+        misses++;
+        return false;
+    }
+
+    size_t slot = seg->rank[halfword / 64] + std::popcount(below);
+    size_t length = seg->length[slot];
+    size_t first_page = (ea - seg->start_ea) >> mirror_page_bits;
+    size_t last_page = (ea + length - 1 - seg->start_ea) >> mirror_page_bits;
+    if (seg->stale[first_page] || seg->stale[last_page])
+    {
+        misses++;
+        return false;
+    }
+
+    hits++;
+    uint16 opcode = seg->opcode[slot];
+    if (opcode == NANOMIPS_STREAM_INVALID)
+    {
+        *size = 0;
+        return true;
+    }
+    *op = &nanomips_opcodes[opcode];
+    nanomips_expand_operands(*op, &seg->vals[seg->vals_start[slot]], ea, length, operands);
+    *size = length;
+    return true;
+}
+
+void insn_index_t::verify()
+{
+    bytevec_t bytes;
+    bytes.resize(mirror_page_bytes);
+    size_t num_stale = 0;
+    for (auto& seg : segments)
+    {
+        for (size_t page = 0; page < seg.page_hash.size(); page++)
+        {
+            if (seg.stale[page]) continue;
+            ea_t start = seg.start_ea + (page << mirror_page_bits);
+            size_t size = std::min<size_t>(mirror_page_bytes, seg.end_ea - start);
+            ssize_t nbytes = get_bytes(&bytes[0], size, start);
+            if (nbytes != (ssize_t)size || hash_page(&bytes[0], size) != seg.page_hash[page])
+            {
+                seg.stale[page] = 1;
+                num_stale++;
+            }
+        }
+    }
+    if (num_stale != 0) LOG("%zu pages of pre-decoded instructions changed since they were decoded", num_stale);
+}
+
+void insn_index_t::clear()
+{
+    segments.clear();
+    last_hit = 0;
+    hits = misses = 0;
+}
+
+void insn_index_t::log_stats()
+{
+    size_t count = 0, bytes = 0;
+    for (auto& seg : segments)
+    {
+        count += seg.opcode.size();
+        bytes += seg.starts.size() * (sizeof(uint64) + sizeof(uint32)) + seg.opcode.size() * (sizeof(uint16) + sizeof(uint8) + sizeof(uint32))
+            + seg.vals.size() * sizeof(uint32) + seg.page_hash.size() * (sizeof(uint64) + sizeof(uint8));
+    }
+    LOG("instruction index: %zu instructions in %zu bytes, %llu hits, %llu misses",
+        count, bytes, (unsigned long long)hits, (unsigned long long)misses);
+}
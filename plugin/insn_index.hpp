@@ -0,0 +1,140 @@
+#ifndef __INSN_INDEX_H
+#define __INSN_INDEX_H
+
+#include <pro.h>
+#include <idp.hpp>
+#include "mirror.hpp"
+#include "nanomips-dis.h"
+
+/**
+ * @brief Default number of threads used to build the instruction index, 0 for one per core.
+ * Can be changed with -Onmips:predecode_threads=N, where N = -1 disables the index.
+ */
+constexpr int insn_index_default_threads = 0;
+
+/**
+ * @brief Pre-decoded instructions of a single executable segment, in the format of nanomips_insn_stream.
+ */
+struct indexed_segment_t
+{
+    ea_t start_ea = BADADDR;
+    ea_t end_ea = BADADDR;
+
+    /**
+     * @brief Bit i is set if a decoded instruction starts at start_ea + 2 * i.
+     */
+    qvector<uint64> starts;
+
+    /**
+     * @brief Number of bits set in starts before each of its words, so the slot of an instruction is found without searching.
+     */
+    qvector<uint32> rank;
+
+    /**
+     * @brief Index into nanomips_opcodes, or NANOMIPS_STREAM_INVALID.
+     */
+    qvector<uint16> opcode;
+    qvector<uint8> length;
+
+    /**
+     * @brief Raw operand values of slot i are vals[vals_start[i]] up to vals[vals_start[i + 1]].
+     */
+    qvector<uint32> vals_start;
+    qvector<uint32> vals;
+
+    /**
+     * @brief Hash of the bytes of every page (of mirror_page_bytes) when the segment was decoded.
+     */
+    qvector<uint64> page_hash;
+
+    /**
+     * @brief Pages whose bytes changed since, instructions touching them are not served anymore.
+     */
+    qvector<uint8> stale;
+};
+
+struct insn_index_t;
+
+/**
+ * @brief Follows the debugger for insn_index_t, debugger notifications use their own event codes.
+ */
+struct insn_index_dbg_listener_t : public event_listener_t
+{
+public:
+    insn_index_dbg_listener_t(insn_index_t& index) : index(index) {};
+
+    virtual ssize_t idaapi on_event(ssize_t code, va_list va) override;
+
+private:
+    insn_index_t& index;
+};
+
+/**
+ * @brief Index of all instructions of the executable segments, decoded in parallel right after the ELF loader is done.
+ * IDA analyzes a new file by calling ana one address at a time, on a single thread.
+ * Instead, every code segment is split into chunks at instruction boundaries, which are decoded on a pool of threads.
+ * ana then gets its instructions from here, and only goes to the decode cache for anything the linear sweep did not cover.
+ * The decoded data is never changed after building, bytes that change later just stop the affected instructions from being served.
+ * Memory snapshots taken while debugging change the bytes without any events, so the pages are checked again once the process is gone.
+ */
+struct insn_index_t : public event_listener_t
+{
+public:
+    insn_index_t(const nanomips_decoder& decoder) : decoder(decoder), dbg_listener(*this) {};
+
+    virtual ssize_t idaapi on_event(ssize_t code, va_list va) override;
+
+    void enable_hooks(bool enable);
+
+    /**
+     * @brief Decodes all executable segments, replacing the previous index.
+     */
+    void build();
+
+    /**
+     * @brief Decodes size bytes located at start_ea and adds them to the index as a segment.
+     * @param threads Number of threads to use, 0 for one per core.
+     * @return The number of instructions added.
+     */
+    size_t build_segment(ea_t start_ea, const uchar* bytes, size_t size, int threads);
+
+    /**
+     * @brief Looks up the instruction at ea.
+     * @param ea Address of the instruction.
+     * @param op Set to the matching entry of nanomips_opcodes.
+     * @param operands Receives the decoded operands, needs MAX_NUM_OPS zeroed entries.
+     * @param size Set to the size of the instruction in bytes, 0 if the bytes are not a valid instruction.
+     * @return Whether the index has the instruction at ea. If not, it has to be decoded normally.
+     */
+    bool lookup(ea_t ea, const struct nanomips_opcode** op, nanomips_decoded_op* operands, size_t* size);
+
+    /**
+     * @brief Compares the page hashes against the current bytes and marks the changed pages stale.
+     */
+    void verify();
+
+    void clear();
+
+    /**
+     * @brief Logs the hit / miss counters and the memory used.
+     */
+    void log_stats();
+
+    /**
+     * @brief Threads used by build, -1 if the index is disabled.
+     */
+    int threads = insn_index_default_threads;
+
+    uint64 hits = 0;
+    uint64 misses = 0;
+
+private:
+    indexed_segment_t* find(ea_t ea);
+
+    const nanomips_decoder& decoder;
+    qvector<indexed_segment_t> segments;
+    size_t last_hit = 0;
+    insn_index_dbg_listener_t dbg_listener;
+};
+
+#endif /* __INSN_INDEX_H */
@@ -0,0 +1,215 @@
+#include "log.hpp"
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+std::atomic<uint8> log_levels[log_num_categories] = {
+    log_default_level, log_default_level, log_default_level, log_default_level, log_default_level,
+};
+static_assert(log_num_categories == 5, "log_levels needs a default for every category");
+
+static const char* const log_category_names[log_num_categories] = {
+    "general", "loader", "analysis", "microcode", "debugger",
+};
+
+static const char* const log_level_names[] = {
+    "error", "warning", "info", "debug", "trace",
+};
+
+/**
+ * @brief A queued message.
+ * sequence is the position the slot can be written at next, and that position + 1 once the message can be read.
+ */
+struct log_entry_t
+{
+    std::atomic<uint64> sequence;
+    const char* file;
+    uint32 line;
+    uint8 category;
+    uint8 level;
+    char text[log_message_bytes];
+};
+
+static_assert((log_queue_entries & (log_queue_entries - 1)) == 0, "log_queue_entries must be a power of two");
+
+/**
+ * @brief Bounded queue, any thread writes and only the flusher reads.
+ * Writers claim a position with a single compare and swap on head, and never wait for each other or the flusher.
+ */
+static log_entry_t log_queue[log_queue_entries];
+static std::atomic<uint64> log_head{0};
+static uint64 log_tail = 0;
+static std::atomic<uint64> log_dropped{0};
+
+static std::mutex log_thread_lock;
+static std::thread log_thread;
+static std::atomic<bool> log_running{false};
+static std::atomic<bool> log_stopping{false};
+
+static int parse_level(const char* name, size_t len)
+{
+    for (size_t i = 0; i < qnumber(log_level_names); i++)
+    {
+        if (strlen(log_level_names[i]) == len && strncmp(log_level_names[i], name, len) == 0) return i;
+    }
+    return -1;
+}
+
+void log_configure(const char* options)
+{
+    if (options == nullptr) return;
+
+    const char* part = options;
+    while (*part != '\0')
+    {
+        const char* end = strchr(part, ',');
+        size_t len = end != nullptr ? end - part : strlen(part);
+        const char* colon = (const char*)memchr(part, ':', len);
+        if (colon == nullptr)
+        {
+            int level = parse_level(part, len);
+            if (level < 0) WARN("Unknown log level %.*s", (int)len, part);
+            else for (auto& category_level : log_levels) category_level.store(level);
+        }
+        else
+        {
+            int level = parse_level(colon + 1, part + len - colon - 1);
+            size_t category = 0;
+            while (category < log_num_categories
+                && !(strlen(log_category_names[category]) == (size_t)(colon - part) && strncmp(log_category_names[category], part, colon - part) == 0))
+            {
+                category++;
+            }
+            if (level < 0 || category == log_num_categories) WARN("Unknown log category or level %.*s", (int)len, part);
+            else log_levels[category].store(level);
+        }
+        if (end == nullptr) break;
+        part = end + 1;
+    }
+}
+
+/**
+ * @brief Writes out a single message, only ever called from the flusher.
+ */
+static void log_output(const log_entry_t& entry)
+{
+    const char* category = log_category_names[entry.category];
+    switch (entry.level)
+    {
+    case log_error:
+        msg("[!] %s\n", entry.text);
+        loguru::log(loguru::Verbosity_ERROR, entry.file, entry.line, "[%s] %s", category, entry.text);
+        break;
+    case log_warning:
+        msg("[!] %s\n", entry.text);
+        loguru::log(loguru::Verbosity_WARNING, entry.file, entry.line, "[%s] %s", category, entry.text);
+        break;
+    case log_info:
+        msg("[*] %s\n", entry.text);
+        loguru::log(loguru::Verbosity_INFO, entry.file, entry.line, "[%s] %s", category, entry.text);
+        break;
+    default:
+        loguru::log(entry.level - log_info, entry.file, entry.line, "[%s] %s", category, entry.text);
+        break;
+    }
+}
+
+/**
+ * @brief Writes out everything that is queued, returns the number of messages.
+ */
+static size_t log_drain()
+{
+    size_t count = 0;
+    for (;;)
+    {
+        log_entry_t& entry = log_queue[log_tail & (log_queue_entries - 1)];
+        if (entry.sequence.load(std::memory_order_acquire) != log_tail + 1) break;
+        log_output(entry);
+        entry.sequence.store(log_tail + log_queue_entries, std::memory_order_release);
+        log_tail++;
+        count++;
+    }
+
+    uint64 dropped = log_dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped != 0)
+    {
+        msg("[!] %llu log messages dropped\n", (unsigned long long)dropped);
+        LOG_F(WARNING, "%llu log messages dropped", (unsigned long long)dropped);
+    }
+    return count;
+}
+
+static void log_flusher()
+{
+    while (!log_stopping.load(std::memory_order_acquire))
+    {
+        if (log_drain() == 0) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    log_drain();
+}
+
+static void log_start()
+{
+    std::lock_guard<std::mutex> guard(log_thread_lock);
+    if (log_running.load(std::memory_order_relaxed)) return;
+
+    static bool initialized = false;
+    if (!initialized)
+    {
+        for (size_t i = 0; i < log_queue_entries; i++)
+        {
+            log_queue[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        initialized = true;
+    }
+    log_stopping.store(false);
+    log_thread = std::thread(log_flusher);
+    log_running.store(true, std::memory_order_release);
+}
+
+void log_write(log_category_t category, log_level_t level, const char* file, unsigned int line, const char* format, ...)
+{
+    if (!log_running.load(std::memory_order_acquire)) log_start();
+
+    uint64 pos = log_head.load(std::memory_order_relaxed);
+    log_entry_t* entry;
+    for (;;)
+    {
+        entry = &log_queue[pos & (log_queue_entries - 1)];
+        int64 diff = (int64)(entry->sequence.load(std::memory_order_acquire) - pos);
+        if (diff == 0)
+        {
+            if (log_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        }
+        else if (diff < 0)
+        {
+            // the flusher has not caught up, analysis must not wait for it.
+            log_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = log_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    entry->file = file;
+    entry->line = line;
+    entry->category = category;
+    entry->level = level;
+    va_list va;
+    va_start(va, format);
+    qvsnprintf(entry->text, sizeof(entry->text), format, va);
+    va_end(va);
+    entry->sequence.store(pos + 1, std::memory_order_release);
+}
+
+void log_shutdown()
+{
+    std::lock_guard<std::mutex> guard(log_thread_lock);
+    if (!log_running.load(std::memory_order_relaxed)) return;
+
+    log_stopping.store(true, std::memory_order_release);
+    log_thread.join();
+    log_running.store(false, std::memory_order_release);
+}
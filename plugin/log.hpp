@@ -3,20 +3,94 @@
 
 #include <pro.h>
 #include <kernwin.hpp>
+#include <atomic>
 #include "loguru.hpp"
 
+/**
+ * @brief Part of the plugin a message comes from, each has its own level.
+ * A source file picks its category by defining LOG_CATEGORY before any include.
+ */
+enum log_category_t : uint8
+{
+    log_general,
+    // elf_ldr, relocations.
+    log_loader,
+    // ana, emu and the caches and sweeps they use.
+    log_analysis,
+    // mgen, mopt.
+    log_microcode,
+    // gdb configuration.
+    log_debugger,
+    log_num_categories,
+};
+
+enum log_level_t : uint8
+{
+    log_error,
+    log_warning,
+    log_info,
+    // only written to the log file.
+    log_debug,
+    log_trace,
+};
+
+/**
+ * @brief Default level of every category.
+ */
+constexpr log_level_t log_default_level = log_info;
+
+/**
+ * @brief Messages that can be queued, before new ones are dropped.
+ */
+constexpr size_t log_queue_entries = 1024;
+
+/**
+ * @brief Longer messages are cut off.
+ */
+constexpr size_t log_message_bytes = 256;
+
+extern std::atomic<uint8> log_levels[log_num_categories];
+
+static inline bool log_enabled(log_category_t category, log_level_t level)
+{
+    return level <= log_levels[category].load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Sets the levels from -Onmips_log=..., either a single level for everything or a comma separated list of category:level.
+ * e.g. -Onmips_log=debug or -Onmips_log=loader:trace,analysis:warning
+ */
+void log_configure(const char* options);
+
+/**
+ * @brief Formats the message and queues it, it is written to the output window and loguru by a background thread.
+ * Never blocks, if the queue is full the message is dropped and counted.
+ */
+void log_write(log_category_t category, log_level_t level, const char* file, unsigned int line, const char* format, ...) AS_PRINTF(5, 6);
+
+/**
+ * @brief Writes out everything queued so far and stops the background thread, which is started again by the next message.
+ */
+void log_shutdown();
+
+#ifndef LOG_CATEGORY
+#define LOG_CATEGORY log_general
+#endif
+
 #if defined(_MSC_VER)
 #define VA_ARGS(...) , ## __VA_ARGS__
 #else
 #define VA_ARGS(...) __VA_OPT__(,) ##__VA_ARGS__
 #endif
+#define LOG_AT(level, message, ...) do { if (log_enabled(LOG_CATEGORY, level)) log_write(LOG_CATEGORY, level, __FILE__, __LINE__, message VA_ARGS(__VA_ARGS__)); } while (0)
 #ifdef DEBUG
-#define TRACE(message,...) msg("")
+#define TRACE(message,...) LOG_AT(log_trace, message VA_ARGS(__VA_ARGS__))
 #else
-#define TRACE(message,...) do {} while (0); 
+#define TRACE(message,...) do {} while (0)
 #endif
-#define LOG(message,...) msg("[*] " message "\n" VA_ARGS(__VA_ARGS__)); LOG_F(INFO, message VA_ARGS(__VA_ARGS__))
-#define WARN(message,...) msg("[!] " message "\n" VA_ARGS(__VA_ARGS__)); LOG_F(WARNING, message VA_ARGS(__VA_ARGS__))
-#define ERR(message,...) msg("[!] " message "\n" VA_ARGS(__VA_ARGS__)); LOG_F(ERROR, message VA_ARGS(__VA_ARGS__))
+#define DLOG(message,...) LOG_AT(log_debug, message VA_ARGS(__VA_ARGS__))
+#define LOG(message,...) LOG_AT(log_info, message VA_ARGS(__VA_ARGS__))
+#define WARN(message,...) LOG_AT(log_warning, message VA_ARGS(__VA_ARGS__))
+#define ERR(message,...) LOG_AT(log_error, message VA_ARGS(__VA_ARGS__))
 
 #endif /* __LOG_H */
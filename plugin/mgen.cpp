@@ -1,3 +1,4 @@
+#define LOG_CATEGORY log_microcode
 #include "mgen.hpp"
 #include "hexrays.hpp"
 #include "ins.hpp"
@@ -52,14 +53,7 @@ merror_t nmips_microcode_gen_t::apply(codegen_t &cdg)
     * @note   cdg.emit (the advanced version using pointers) copies the mop_t* arguments, so we can safely pass pointers to local variables.
     */
 
-    switch (cdg.insn.itype) {
-    case nMIPS_bc:
-    {
-        cdg.emit(m_goto, 4, cdg.insn.Op1.addr, 0, 0, 0);
-        return MERR_OK;
-    }
-    break;
-    CASE_BRANCH_COND
+    if (get_nanomips_branch(cdg.insn.itype) == nmips_branch_cmp)
     {
         auto mop1 = cdg.load_operand(0);
         auto mop2 = cdg.load_operand(1);
@@ -67,6 +61,13 @@ merror_t nmips_microcode_gen_t::apply(codegen_t &cdg)
         cdg.emit(code_for_jcnd((nanomips_extra_inst_t)cdg.insn.itype), 4, mop1, mop2, cdg.insn.Op3.addr, 0);
         return MERR_OK;
     }
+
+    switch (cdg.insn.itype) {
+    case nMIPS_bc:
+    {
+        cdg.emit(m_goto, 4, cdg.insn.Op1.addr, 0, 0, 0);
+        return MERR_OK;
+    }
     break;
     case nMIPS_bgezc:
     case nMIPS_blezc:
@@ -124,7 +125,7 @@ nmips_microcode_gen_t::nmips_microcode_gen_t()
         {
             qstring tmp_buf;
             get_mreg_name(&tmp_buf, bit, width);
-            LOG("saving temp %d.%d (%s)", bit, width, tmp_buf.c_str());
+            DLOG("saving temp %d.%d (%s)", bit, width, tmp_buf.c_str());
             // TODO: save width?
             temps.add(bit);
         }
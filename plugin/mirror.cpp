@@ -0,0 +1,191 @@
+#define LOG_CATEGORY log_analysis
+#include "mirror.hpp"
+#include "bytes.hpp"
+#include "dbg.hpp"
+#include "log.hpp"
+#include "segment.hpp"
+#include <algorithm>
+
+ssize_t segment_mirror_t::on_event(ssize_t code, va_list va)
+{
+    switch (code) {
+    case idb_event::byte_patched:
+    {
+        ea_t ea = va_arg(va, ea_t);
+        invalidate_range(ea, ea + 1);
+    }
+    break;
+    case idb_event::segm_added:
+    case idb_event::segm_deleted:
+    case idb_event::segm_start_changed:
+    case idb_event::segm_end_changed:
+    case idb_event::segm_moved:
+    case idb_event::allsegs_moved:
+    case idb_event::segm_attrs_updated:
+    // the loader writes the segment contents without any events.
+    case idb_event::loader_finished:
+    case idb_event::closebase:
+    {
+        invalidate();
+    }
+    break;
+    }
+    return 0;
+}
+
+ssize_t mirror_dbg_listener_t::on_event(ssize_t code, va_list va)
+{
+    switch (code) {
+    case dbg_process_start:
+    case dbg_process_attach:
+    {
+        mirror.set_debugging(true);
+    }
+    break;
+    case dbg_process_exit:
+    case dbg_process_detach:
+    {
+        mirror.set_debugging(false);
+    }
+    break;
+    }
+    return 0;
+}
+
+void segment_mirror_t::enable_hooks(bool enable)
+{
+    if (enable) {
+        hook_event_listener(HT_IDB, this, this);
+        hook_event_listener(HT_DBG, &dbg_listener, this);
+    } else {
+        unhook_event_listener(HT_IDB, this);
+        unhook_event_listener(HT_DBG, &dbg_listener);
+    }
+    // the plugin might be enabled while a process is already debugged.
+    debugging_process = enable && is_debugger_on();
+    invalidate();
+}
+
+void segment_mirror_t::set_debugging(bool debugging)
+{
+    debugging_process = debugging;
+    // memory snapshots are written to the database without any events.
+    invalidate();
+}
+
+void segment_mirror_t::invalidate()
+{
+    segments.clear();
+    last_hit = 0;
+    dirty = true;
+}
+
+void segment_mirror_t::invalidate_range(ea_t start, ea_t end)
+{
+    if (dirty) return;
+
+    for (auto &seg : segments)
+    {
+        if (seg.end_ea <= start || seg.start_ea >= end) continue;
+
+        size_t first = (std::max(start, seg.start_ea) - seg.start_ea) >> mirror_page_bits;
+        size_t last = (std::min(end, seg.end_ea) - 1 - seg.start_ea) >> mirror_page_bits;
+        for (size_t page = first; page <= last; page++)
+        {
+            seg.loaded[page] = mirror_page_unfetched;
+        }
+    }
+}
+
+void segment_mirror_t::rebuild()
+{
+    segments.clear();
+    last_hit = 0;
+    dirty = false;
+
+    int qty = get_segm_qty();
+    for (int i = 0; i < qty; i++)
+    {
+        segment_t* seg = getnseg(i);
+        if (seg == NULL) continue;
+        if ((seg->perm & SEGPERM_EXEC) == 0 && seg->type != SEG_CODE) continue;
+
+        mirrored_segment_t& mirrored = segments.push_back();
+        mirrored.start_ea = seg->start_ea;
+        mirrored.end_ea = seg->end_ea;
+        mirrored.bytes.resize(seg->size());
+        mirrored.loaded.resize((seg->size() + mirror_page_bytes - 1) >> mirror_page_bits, mirror_page_unfetched);
+    }
+}
+
+mirrored_segment_t* segment_mirror_t::find(ea_t ea)
+{
+    if (dirty) rebuild();
+    if (segments.empty()) return NULL;
+
+    mirrored_segment_t* seg = &segments[last_hit];
+    if (ea >= seg->start_ea && ea < seg->end_ea) return seg;
+
+    // segments are sorted, since getnseg returns them in address order.
+    auto it = std::upper_bound(segments.begin(), segments.end(), ea,
+        [](ea_t addr, const mirrored_segment_t& s) { return addr < s.start_ea; });
+    if (it == segments.begin()) return NULL;
+    --it;
+    if (ea >= it->end_ea) return NULL;
+
+    last_hit = it - segments.begin();
+    return &*it;
+}
+
+void segment_mirror_t::fill_page(mirrored_segment_t& seg, size_t page)
+{
+    size_t offset = page << mirror_page_bits;
+    ea_t start = seg.start_ea + offset;
+    size_t size = std::min<size_t>(mirror_page_bytes, seg.end_ea - start);
+
+    // without GMB_READALL, get_bytes stops at the first uninitialized byte.
+    ssize_t nbytes = get_bytes(&seg.bytes[offset], size, start);
+    seg.loaded[page] = nbytes < 0 ? 0 : (uint16)nbytes;
+}
+
+const uchar* segment_mirror_t::view(ea_t ea, size_t len, size_t* avail)
+{
+    *avail = 0;
+    if (debugging_process) return NULL;
+    mirrored_segment_t* seg = find(ea);
+    if (seg == NULL) return NULL;
+
+    size_t offset = ea - seg->start_ea;
+    size_t want = std::min<size_t>(len, seg->end_ea - ea);
+    size_t got = 0;
+    while (got < want)
+    {
+        size_t pos = offset + got;
+        size_t page = pos >> mirror_page_bits;
+        if (seg->loaded[page] == mirror_page_unfetched) fill_page(*seg, page);
+
+        size_t page_offset = pos & (mirror_page_bytes - 1);
+        if (seg->loaded[page] <= page_offset) break;
+
+        got += std::min<size_t>(want - got, seg->loaded[page] - page_offset);
+        // stopped before the end of the page, so the rest of it is uninitialized.
+        if (got < want && ((offset + got) & (mirror_page_bytes - 1)) != 0) break;
+    }
+
+    *avail = got;
+    return &seg->bytes[offset];
+}
+
+size_t segment_mirror_t::read(ea_t ea, uchar* out, size_t len)
+{
+    size_t avail = 0;
+    const uchar* bytes = view(ea, len, &avail);
+    if (bytes == NULL)
+    {
+        ssize_t nbytes = get_bytes(out, len, ea);
+        return nbytes < 0 ? 0 : nbytes;
+    }
+
+    memcpy(out, bytes, avail);
+    return avail;
+}
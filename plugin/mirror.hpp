@@ -0,0 +1,118 @@
+#ifndef __MIRROR_H
+#define __MIRROR_H
+
+#include <pro.h>
+#include <idp.hpp>
+
+/**
+ * @brief Log2 of the granularity at which segment bytes are fetched and invalidated.
+ */
+constexpr int mirror_page_bits = 12;
+constexpr size_t mirror_page_bytes = (size_t)1 << mirror_page_bits;
+
+/**
+ * @brief Marks a page of a mirrored segment that was not fetched from the database yet.
+ */
+constexpr uint16 mirror_page_unfetched = 0xFFFF;
+
+/**
+ * @brief Contiguous copy of a single executable segment.
+ */
+struct mirrored_segment_t
+{
+    ea_t start_ea = BADADDR;
+    ea_t end_ea = BADADDR;
+
+    /**
+     * @brief Bytes of [start_ea, end_ea), only valid inside the loaded part of fetched pages.
+     */
+    bytevec_t bytes;
+
+    /**
+     * @brief Number of initialized bytes at the start of each page, or mirror_page_unfetched.
+     */
+    qvector<uint16> loaded;
+};
+
+struct segment_mirror_t;
+
+/**
+ * @brief Follows the debugger for segment_mirror_t, debugger notifications use their own event codes.
+ */
+struct mirror_dbg_listener_t : public event_listener_t
+{
+public:
+    mirror_dbg_listener_t(segment_mirror_t& mirror) : mirror(mirror) {};
+
+    virtual ssize_t idaapi on_event(ssize_t code, va_list va) override;
+
+private:
+    segment_mirror_t& mirror;
+};
+
+/**
+ * @brief Read-only mirror of the bytes of all executable segments.
+ * IDA calls ana on the same addresses over and over again, and every call used to go through get_bytes.
+ * This keeps a copy of each code segment, which is filled lazily one page at a time.
+ * Patched bytes and segment changes are picked up through IDB events.
+ * Bytes written with put_bytes and friends do not generate events, so whoever does that to code has to call invalidate_range.
+ * While a process is debugged, get_bytes reads its memory, which changes without any events, so the mirror is bypassed.
+ */
+struct segment_mirror_t : public event_listener_t
+{
+public:
+    segment_mirror_t() : dbg_listener(*this) {};
+
+    virtual ssize_t idaapi on_event(ssize_t code, va_list va) override;
+
+    void enable_hooks(bool enable);
+
+    /**
+     * @brief Returns a pointer to the mirrored bytes at ea.
+     * Fetches any missing pages covering [ea, ea+len) first.
+     * @param ea Address to read.
+     * @param len Number of bytes wanted.
+     * @param avail Set to the number of initialized bytes available at the returned pointer, at most len.
+     * @return Pointer into the mirror, or NULL if ea is not inside an executable segment or a process is debugged.
+     */
+    const uchar* view(ea_t ea, size_t len, size_t* avail);
+
+    /**
+     * @brief Copies up to len bytes at ea into out, falling back to get_bytes outside of the mirror.
+     * @return Number of bytes read.
+     */
+    size_t read(ea_t ea, uchar* out, size_t len);
+
+    /**
+     * @brief Drops all mirrored segments, they are rebuilt on the next access.
+     */
+    void invalidate();
+
+    /**
+     * @brief Forces the pages covering [start, end) to be fetched again.
+     */
+    void invalidate_range(ea_t start, ea_t end);
+
+    /**
+     * @brief Whether a process is debugged, anything decoded from the database bytes before may be outdated then.
+     */
+    bool debugging() const { return debugging_process; }
+
+    /**
+     * @brief Called by mirror_dbg_listener_t when a process starts or stops being debugged.
+     */
+    void set_debugging(bool debugging);
+
+private:
+    mirrored_segment_t* find(ea_t ea);
+    void rebuild();
+    void fill_page(mirrored_segment_t& seg, size_t page);
+
+    qvector<mirrored_segment_t> segments;
+    size_t last_hit = 0;
+    bool dirty = true;
+    bool debugging_process = false;
+    mirror_dbg_listener_t dbg_listener;
+};
+
+#endif /* __MIRROR_H */
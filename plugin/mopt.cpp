@@ -1,3 +1,4 @@
+#define LOG_CATEGORY log_microcode
 #include "mopt.hpp"
 #include "funcs.hpp"
 #include "hexrays.hpp"
@@ -141,7 +142,7 @@ int large_stk_opt_t::func(mblock_t *blk, minsn_t *ins, int optflags)
     loc = ins->ea;
     if (blk == NULL)
     {
-        LOG("[0x%x] blk == NULL", loc);
+        DLOG("[0x%x] blk == NULL", loc);
         return 0;
     }
     if (blk->mba->maturity != MMAT_GLBOPT1)
@@ -1,164 +1,955 @@
 #include "nanomips-dis.h"
+#include <stdlib.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
 
-size_t nanomips_disasm_instr(bfd_vma memaddr_base, disassemble_info *info, struct nanomips_opcode *out_op, nanomips_decoded_op* out_operands)
+/* All tables below are built exactly once, by nanomips_init_dispatch, and
+   never written afterwards.  Decoding only reads them, so any number of
+   threads can decode at the same time.  */
+
+/* Dispatch index over nanomips_opcodes[].
+   The major opcode (top 6 bits of the first halfword) also determines the
+   length class of an instruction, so it is enough to key the index on it.
+   Each bucket holds the indices of all rows that can match an instruction
+   with that major opcode, in table order, so first-match semantics are kept.
+   Rows that can never be chosen by the disassembler (macros, rows outside of
+   our ISA / ASE selection and rows converted to compact form) are dropped.  */
+
+#define NANOMIPS_NUM_MAJORS 64
+
+static const unsigned short *dispatch_index = NULL;
+static unsigned int dispatch_start[NANOMIPS_NUM_MAJORS + 1];
+
+/* Lookup table for all 16-bit encodings.
+   A halfword is a 16-bit instruction exactly when bit 12 is set, so the
+   table is keyed on the remaining 15 bits.  Each entry holds the matching
+   opcode row and the already extracted operand values; the operand
+   descriptors themselves only depend on the row and are kept per opcode.
+   The table is built without INSN_HAS_RELOC, since that flag changes both
+   validation and the PC-relative base.  */
+
+#define NANOMIPS_LUT16_SIZE 0x8000
+#define NANOMIPS_LUT16_MAX_OPS 4
+
+/* Entry is not a valid instruction.  */
+#define LUT16_INVALID -1
+/* Entry does not fit the table, decode it the slow way.  */
+#define LUT16_SLOW -2
+
+struct nanomips_lut16_entry
 {
-    const struct nanomips_opcode *op, *opend;
-    void *is = info->stream;
-    bfd_byte buffer[2];
-    bfd_uint64_t higher = 0;
-    unsigned int length;
-    int status;
-    bfd_uint64_t insn;
-    const struct nanomips_arch_choice *chosen_arch;
+    short opcode;
+    unsigned short val[NANOMIPS_LUT16_MAX_OPS];
+};
 
-    int nanomips_processor;
-    int nanomips_ase;
-    int nanomips_isa;
+static const struct nanomips_lut16_entry *lut16 = NULL;
 
-    nanomips_isa = ISA_NANOMIPS32R6;
-    nanomips_processor = CPU_NANOMIPS32R6;
-    nanomips_ase = ASE_xNMS | ASE_TLB; // Standard stuff;
+/* Argument strings of all opcode rows, compiled into flat operand lists.
+   Validation and extraction of the operands is done in a single pass over
+   these, so the per-instruction path never has to parse opcode->args.  */
 
-    bfd_vma memaddr = memaddr_base;
+enum nanomips_operand_check
+{
+    CHECK_NONE,
+    /* Register, remembered for later CHECK_PREV operands.  */
+    CHECK_REG,
+    /* Like CHECK_REG, but must also be a valid CP0 register + select.  */
+    CHECK_CP0_REG,
+    CHECK_PREV,
+    CHECK_MAPPED_PREV,
+    CHECK_NON_ZERO,
+    CHECK_NON_ZERO_PCREL,
+    CHECK_SAVE_RESTORE
+};
 
-    info->bytes_per_chunk = 2;
-    info->display_endian = info->endian;
-    info->insn_info_valid = 1;
-    info->branch_delay_insns = 0;
-    info->data_size = 0;
-    info->insn_type = dis_nonbranch;
-    info->target = 0;
-    info->target2 = 0;
+enum nanomips_operand_extract
+{
+    EXTRACT_NONE,
+    EXTRACT_FIELD,
+    /* 32-bit immediate of a 48-bit instruction.  */
+    EXTRACT_WORD
+};
 
-    status = (*info->read_memory_func) (memaddr, buffer, 2, info);
-    if (status != 0)
+struct nanomips_compiled_operand
+{
+    const struct nanomips_operand *operand;
+    unsigned char check;
+    unsigned char extract;
+    /* Whether the operand is relative to the end of the instruction.  */
+    unsigned char pcrel;
+};
+
+/* pcrel_operand of an opcode without PC-relative operands.  */
+#define NO_PCREL_OPERAND 0xff
+
+struct nanomips_compiled_opcode
+{
+    unsigned short first;
+    unsigned char count;
+    unsigned char insn_type;
+    /* Index of the first PC-relative operand, which gives the target.  */
+    unsigned char pcrel_operand;
+};
+
+static const struct nanomips_compiled_operand *compiled_operands = NULL;
+static const struct nanomips_compiled_opcode *compiled_opcodes = NULL;
+
+/* Bitmap of valid CP0 register + select combinations, indexed by the
+   10-bit operand value.  */
+static unsigned int cp0_valid[(1 << 10) / 32];
+
+static unsigned int
+nanomips_lut16_key (bfd_uint64_t insn)
+{
+    return ((insn >> 1) & 0x7000) | (insn & 0xfff);
+}
+
+unsigned int nanomips_insn_length (unsigned int first_halfword)
+{
+    if ((first_halfword & 0xfc00) == 0x6000)
+        return 6;
+    if ((first_halfword & 0x1000) == 0)
+        return 4;
+    return 2;
+}
+
+/* Length in bytes of an instruction whose first halfword has major opcode MAJOR.  */
+
+static unsigned int
+nanomips_major_length (unsigned int major)
+{
+    return nanomips_insn_length (major << 10);
+}
+
+/* Whether opcode row OP can match an instruction with major opcode MAJOR.  */
+
+static bfd_boolean
+nanomips_opcode_in_bucket (const struct nanomips_opcode *op, unsigned int major)
+{
+    unsigned int length = nanomips_major_length (major);
+    unsigned int shift;
+
+    if (length == 4)
     {
-        (*info->memory_error_func) (status, memaddr, info);
-        return -1;
+        if ((op->mask & 0xffff0000) == 0)
+            return FALSE;
+        shift = 26;
+    }
+    else
+    {
+        if ((op->mask & 0xffff0000) != 0)
+            return FALSE;
+        shift = 10;
     }
 
-    length = 2;
+    return ((major ^ (op->match >> shift)) & (op->mask >> shift) & 0x3f) == 0;
+}
 
-    if (info->endian == BFD_ENDIAN_BIG)
-        insn = bfd_getb16 (buffer);
-    else
-        insn = bfd_getl16 (buffer);
+static bfd_boolean
+nanomips_opcode_selectable (const struct nanomips_opcode *op)
+{
+    if (op->pinfo == INSN_MACRO)
+        return FALSE;
+    if (op->pinfo2 & INSN2_CONVERTED_TO_COMPACT)
+        return FALSE;
+    return nanomips_opcode_is_member (op, ISA_NANOMIPS32R6,
+                                      ASE_xNMS | ASE_TLB, CPU_NANOMIPS32R6);
+}
+
+static void
+nanomips_build_dispatch (void)
+{
+    unsigned short *index;
+    unsigned int major, count = 0;
+    int i;
+
+    for (major = 0; major < NANOMIPS_NUM_MAJORS; major++)
+        for (i = 0; i < bfd_nanomips_num_opcodes; i++)
+            if (nanomips_opcode_selectable (&nanomips_opcodes[i])
+                && nanomips_opcode_in_bucket (&nanomips_opcodes[i], major))
+                count++;
 
-    if ((insn & 0xfc00) == 0x6000)
+    index = (unsigned short *) malloc (count * sizeof (*index));
+    count = 0;
+    for (major = 0; major < NANOMIPS_NUM_MAJORS; major++)
     {
-        unsigned imm;
-        /* This is a 48-bit nanoMIPS instruction. */
-        status = (*info->read_memory_func) (memaddr + 2, buffer, 2, info);
-        if (status != 0)
-        {
-            (*info->memory_error_func) (status, memaddr + 2, info);
-            return -1;
-        }
-        if (info->endian == BFD_ENDIAN_BIG)
-            imm = bfd_getb16 (buffer);
+        dispatch_start[major] = count;
+        for (i = 0; i < bfd_nanomips_num_opcodes; i++)
+            if (nanomips_opcode_selectable (&nanomips_opcodes[i])
+                && nanomips_opcode_in_bucket (&nanomips_opcodes[i], major))
+                index[count++] = (unsigned short) i;
+    }
+    dispatch_start[NANOMIPS_NUM_MAJORS] = count;
+    dispatch_index = index;
+}
+
+/* Figure out instruction type and branch delay information.  */
+
+static enum dis_insn_type
+nanomips_insn_type (const struct nanomips_opcode *op)
+{
+    if ((op->pinfo2 & INSN2_UNCOND_BRANCH) != 0)
+    {
+        if ((op->pinfo & (INSN_WRITE_GPR_31 | INSN_WRITE_1)) != 0)
+            return dis_jsr;
+        return dis_branch;
+    }
+    if ((op->pinfo2 & INSN2_COND_BRANCH) != 0)
+    {
+        if ((op->pinfo & INSN_WRITE_GPR_31) != 0)
+            return dis_condjsr;
+        return dis_condbranch;
+    }
+    if ((op->pinfo & (INSN_STORE_MEMORY | INSN_LOAD_MEMORY)) != 0)
+        return dis_dref;
+    return dis_nonbranch;
+}
+
+/* Check if register+select map to a valid CP0 select sequence.
+   Only used to build cp0_valid.  */
+
+static bfd_boolean
+validate_cp0_reg_operand (unsigned int uval)
+{
+  int i;
+  unsigned int regno, selnum;
+  regno = uval >> NANOMIPSOP_SH_CP0SEL;
+  selnum = uval & NANOMIPSOP_MASK_CP0SEL;
+
+  for (i = 0; nanomips_cp0_3264r6[i].name; i++)
+    if (regno == nanomips_cp0_3264r6[i].num
+	&& selnum == nanomips_cp0_3264r6[i].sel)
+      break;
+    else if (regno < nanomips_cp0_3264r6[i].num)
+      return FALSE;
+
+  if (nanomips_cp0_3264r6[i].name == NULL)
+    return FALSE;
+
+  return TRUE;
+}
+
+static void
+nanomips_compile_operand (const struct nanomips_opcode *opcode,
+                          const struct nanomips_operand *operand,
+                          struct nanomips_compiled_operand *out)
+{
+    out->operand = operand;
+
+    switch (operand->type)
+    {
+    case OP_REG:
+        if (((const struct nanomips_reg_operand *) operand)->reg_type == OP_REG_CP0)
+            out->check = CHECK_CP0_REG;
         else
-            imm = bfd_getl16 (buffer);
-        higher = (imm << 16);
+            out->check = CHECK_REG;
+        break;
+    case OP_OPTIONAL_REG:
+    case OP_BASE_CHECK_OFFSET:
+        out->check = CHECK_REG;
+        break;
+    case OP_CHECK_PREV:
+        out->check = CHECK_PREV;
+        break;
+    case OP_MAPPED_CHECK_PREV:
+        out->check = CHECK_MAPPED_PREV;
+        break;
+    case OP_NON_ZERO_REG:
+        out->check = CHECK_NON_ZERO;
+        break;
+    case OP_NON_ZERO_PCREL_S1:
+        out->check = CHECK_NON_ZERO_PCREL;
+        break;
+    case OP_SAVE_RESTORE_LIST:
+        /* The operand for SAVE/RESTORE is split into 3 pieces
+           rather than just 2 but we only support a 2-way split
+           decode the last bit of the instruction here.  */
+        out->check = opcode->mask >> 16 != 0 ? CHECK_SAVE_RESTORE : CHECK_NONE;
+        break;
+    default:
+        out->check = CHECK_NONE;
+        break;
+    }
 
-        status = (*info->read_memory_func) (memaddr + 4, buffer, 2, info);
-        if (status != 0)
+    switch (operand->type)
+    {
+    case OP_INT_WORD:
+    case OP_UINT_WORD:
+    case OP_PC_WORD:
+    case OP_GPREL_WORD:
+    case OP_IMM_WORD:
+        out->extract = EXTRACT_WORD;
+        break;
+    case OP_DONT_CARE:
+        out->extract = EXTRACT_NONE;
+        break;
+    default:
+        out->extract = EXTRACT_FIELD;
+        break;
+    }
+
+    out->pcrel = (operand->type == OP_PCREL
+                  || operand->type == OP_HI20_PCREL
+                  || operand->type == OP_NON_ZERO_PCREL_S1
+                  || operand->type == OP_PC_WORD);
+}
+
+static void
+nanomips_compile_opcodes (void)
+{
+    struct nanomips_compiled_operand *operands;
+    struct nanomips_compiled_opcode *opcodes;
+    const struct nanomips_operand *operand;
+    const char *s;
+    unsigned int count = 0, uval;
+    int i;
+
+    for (uval = 0; uval < (1 << 10); uval++)
+        if (validate_cp0_reg_operand (uval))
+            cp0_valid[uval / 32] |= 1u << (uval % 32);
+
+    /* Every operand takes at least one character.  */
+    for (i = 0; i < bfd_nanomips_num_opcodes; i++)
+        count += strlen (nanomips_opcodes[i].args);
+
+    operands = (struct nanomips_compiled_operand *) calloc (count, sizeof (*operands));
+    opcodes = (struct nanomips_compiled_opcode *) calloc (bfd_nanomips_num_opcodes, sizeof (*opcodes));
+
+    count = 0;
+    for (i = 0; i < bfd_nanomips_num_opcodes; i++)
+    {
+        const struct nanomips_opcode *opcode = &nanomips_opcodes[i];
+        struct nanomips_compiled_opcode *compiled = &opcodes[i];
+
+        compiled->first = count;
+        compiled->insn_type = nanomips_insn_type (opcode);
+        compiled->pcrel_operand = NO_PCREL_OPERAND;
+        if (opcode->pinfo == INSN_MACRO)
+            continue;
+
+        for (s = opcode->args; *s; ++s)
         {
-            (*info->memory_error_func) (status, memaddr + 4, info);
-            return -1;
-        }
+            switch (*s)
+            {
+            case ',':
+            case '(':
+            case ')':
+                break;
 
-        if (info->endian == BFD_ENDIAN_BIG)
-            imm = bfd_getb16 (buffer);
-        else
-            imm = bfd_getl16 (buffer);
-        higher = higher | imm;
+            case '#':
+                ++s;
+                break;
+
+            default:
+                operand = decode_nanomips_operand (s);
+                if (operand == NULL)
+                    continue;
 
-        length += 4;
+                nanomips_compile_operand (opcode, operand, &operands[count++]);
+
+                if (*s == 'm' || *s == '+' || *s == '-' || *s == '`')
+                    ++s;
+                break;
+            }
+        }
+        compiled->count = count - compiled->first;
+        for (uval = 0; uval < compiled->count; uval++)
+            if (operands[compiled->first + uval].pcrel)
+            {
+                compiled->pcrel_operand = uval;
+                break;
+            }
     }
-    else if ((insn & 0x1000) == 0x0)
+    compiled_operands = operands;
+    compiled_opcodes = opcodes;
+}
+
+/* Validate and extract the operands of INSN, which is described by OPCODE,
+   in a single pass over its compiled operands.
+   On failure, the OUT_OPERANDS entries written so far are cleared again.  */
+
+static bfd_boolean
+nanomips_decode_operands (const struct nanomips_opcode *opcode, bfd_uint64_t insn,
+                          bfd_vma insn_pc, unsigned int length,
+                          bfd_boolean have_reloc, nanomips_decoded_op *out_operands)
+{
+    const struct nanomips_compiled_opcode *compiled = &compiled_opcodes[opcode - nanomips_opcodes];
+    const struct nanomips_compiled_operand *cop = &compiled_operands[compiled->first];
+    const struct nanomips_compiled_operand *cend = cop + compiled->count;
+    nanomips_decoded_op *out = out_operands;
+    unsigned int last_regno = 0;
+    unsigned int uval;
+
+    for (; cop < cend; cop++, out++)
     {
-        /* This is a 32-bit nanoMIPS instruction.  */
-        higher = insn;
+        const struct nanomips_operand *operand = cop->operand;
 
-        status = (*info->read_memory_func) (memaddr + 2, buffer, 2, info);
-        if (status != 0)
+        uval = nanomips_extract_operand (operand, insn);
+        switch (cop->check)
         {
-            (*info->memory_error_func) (status, memaddr + 2, info);
-            return -1;
+        case CHECK_CP0_REG:
+            if ((cp0_valid[uval / 32] & (1u << (uval % 32))) == 0)
+                goto invalid;
+            /* fall-through */
+        case CHECK_REG:
+            last_regno = nanomips_decode_reg_operand ((const struct nanomips_reg_operand *) operand, uval);
+            break;
+
+        case CHECK_PREV:
+            {
+                const struct nanomips_check_prev_operand *prev_op
+                    = (const struct nanomips_check_prev_operand *) operand;
+
+                if (!prev_op->zero_ok && uval == 0)
+                    goto invalid;
+
+                if (!((prev_op->less_than_ok && uval < last_regno)
+                      || (prev_op->greater_than_ok && uval > last_regno)
+                      || (prev_op->equal_ok && uval == last_regno)))
+                    goto invalid;
+            }
+            break;
+
+        case CHECK_MAPPED_PREV:
+            {
+                const struct nanomips_mapped_check_prev_operand *prev_op
+                    = (const struct nanomips_mapped_check_prev_operand *) operand;
+                unsigned int last_uval = nanomips_encode_reg_operand (operand, last_regno);
+
+                if (!((prev_op->less_than_ok && uval < last_uval)
+                      || (prev_op->greater_than_ok && uval > last_uval)
+                      || (prev_op->equal_ok && uval == last_uval)))
+                    goto invalid;
+            }
+            break;
+
+        case CHECK_NON_ZERO:
+            if (uval == 0)
+                goto invalid;
+            break;
+
+        case CHECK_NON_ZERO_PCREL:
+            if (uval == 0 && !have_reloc)
+                goto invalid;
+            break;
+
+        case CHECK_SAVE_RESTORE:
+            if (((insn >> 20) & 0x1) != 0)
+                goto invalid;
+            break;
         }
 
-        if (info->endian == BFD_ENDIAN_BIG)
-            insn = bfd_getb16 (buffer);
-        else
-            insn = bfd_getl16 (buffer);
+        out->op = (struct nanomips_operand *) operand;
+        out->base_pc = 0;
+        if (!have_reloc)
+            out->base_pc = insn_pc + (cop->pcrel ? length : 0);
+
+        if (cop->extract == EXTRACT_WORD)
+            out->val = insn >> 32;
+        else if (cop->extract == EXTRACT_FIELD)
+            out->val = uval;
+    }
+    return TRUE;
 
-        insn = insn | (higher << 16);
+invalid:
+    memset (out_operands, 0, (out - out_operands) * sizeof (*out_operands));
+    return FALSE;
+}
+
+/* Find the first opcode row matching INSN of LENGTH bytes at INSN_PC and
+   decode its operands into OUT_OPERANDS.  Returns NULL if nothing matches.
+   HAVE_RELOC is set if a relocation applies to the instruction.  */
+
+static const struct nanomips_opcode *
+nanomips_find_opcode (bfd_uint64_t insn, unsigned int length, bfd_vma insn_pc,
+                      bfd_boolean have_reloc, nanomips_decoded_op *out_operands)
+{
+    const struct nanomips_opcode *op;
+    unsigned int major, idx;
 
-        length += 2;
+    // ISA / ASE membership was already checked when building the index.
+    if (length == 4)
+        major = (insn >> 26) & 0x3f;
+    else
+        major = (insn >> 10) & 0x3f;
+
+    for (idx = dispatch_start[major]; idx < dispatch_start[major + 1]; idx++)
+    {
+        op = &nanomips_opcodes[dispatch_index[idx]];
+        if ((insn & op->mask) == op->match
+            && nanomips_decode_operands (op, insn, insn_pc, length, have_reloc, out_operands))
+            return op;
     }
 
+    return NULL;
+}
 
-    const struct nanomips_opcode *opcodes;
-    int num_opcodes;
-    struct nanomips_operand const *(*decode) (const char *);
+static void
+nanomips_build_lut16 (void)
+{
+    nanomips_decoded_op operands[16];
+    const struct nanomips_opcode *op;
+    struct nanomips_lut16_entry *table, *entry;
+    unsigned int key, insn, num_ops, i;
 
-    opcodes = nanomips_opcodes;
-    num_opcodes = bfd_nanomips_num_opcodes;
-    decode = decode_nanomips_operand;
+    table = (struct nanomips_lut16_entry *) calloc (NANOMIPS_LUT16_SIZE, sizeof (*table));
 
-    opend = opcodes + num_opcodes;
-    for (op = opcodes; op < opend; op++)
+    for (key = 0; key < NANOMIPS_LUT16_SIZE; key++)
     {
-        if (op->pinfo != INSN_MACRO
-        && (insn & op->mask) == op->match
-        && ((length == 2 && (op->mask & 0xffff0000) == 0)
-            || (length == 6
-            && (op->mask & 0xffff0000) == 0)
-            || (length == 4 && (op->mask & 0xffff0000) != 0)))
+        insn = ((key & 0x7000) << 1) | 0x1000 | (key & 0xfff);
+        entry = &table[key];
+
+        memset (operands, 0, sizeof (operands));
+        op = nanomips_find_opcode (insn, 2, 0, FALSE, operands);
+        if (op == NULL)
         {
-        if (!nanomips_opcode_is_member (op, nanomips_isa, nanomips_ase,
-                        nanomips_processor)
-            || (op->pinfo2 & INSN2_CONVERTED_TO_COMPACT))
+            entry->opcode = LUT16_INVALID;
             continue;
+        }
 
-        if (!validate_insn_args (op, decode, insn, info))
+        num_ops = compiled_opcodes[op - nanomips_opcodes].count;
+        entry->opcode = LUT16_SLOW;
+        if (num_ops > NANOMIPS_LUT16_MAX_OPS)
+            continue;
+        for (i = 0; i < num_ops; i++)
+            if (operands[i].val > 0xffff)
+                break;
+        if (i < num_ops)
             continue;
 
-        if (length == 6)
-            insn |= (higher << 32);
+        for (i = 0; i < num_ops; i++)
+            entry->val[i] = operands[i].val;
+        entry->opcode = op - nanomips_opcodes;
+    }
+    lut16 = table;
+}
+
+static void
+nanomips_build_tables (void)
+{
+    nanomips_build_dispatch ();
+    nanomips_compile_opcodes ();
+    nanomips_build_lut16 ();
+}
+
+#ifdef _WIN32
+static INIT_ONCE tables_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK
+nanomips_build_tables_once (PINIT_ONCE once, PVOID param, PVOID *context)
+{
+    nanomips_build_tables ();
+    return TRUE;
+}
+
+void nanomips_init_dispatch (void)
+{
+    InitOnceExecuteOnce (&tables_once, nanomips_build_tables_once, NULL, NULL);
+}
+#else
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+void nanomips_init_dispatch (void)
+{
+    pthread_once (&tables_once, nanomips_build_tables);
+}
+#endif
+
+/* Address referenced by the PC-relative OPERAND with raw value UVAL,
+   relative to BASE_PC.  Mirrors the way the plugin resolves these.  */
+
+static bfd_vma
+nanomips_pcrel_target (const struct nanomips_operand *operand, bfd_vma base_pc,
+                       unsigned int uval)
+{
+    switch (operand->type)
+    {
+    case OP_PCREL:
+        return nanomips_decode_pcrel_operand ((const struct nanomips_pcrel_operand *) operand,
+                                              base_pc, uval);
+    case OP_HI20_PCREL:
+        return nanomips_decode_hi20_pcrel_operand (operand, base_pc, uval);
+    case OP_NON_ZERO_PCREL_S1:
+        {
+            const struct nanomips_pcrel_operand pcrel_op = {
+                {{OP_PCREL, operand->size, operand->lsb, 0, 0},
+                 (1 << operand->size) - 1, 0, 1, TRUE}, 0, 0, 0
+            };
+            return nanomips_decode_pcrel_operand (&pcrel_op, base_pc, uval);
+        }
+    case OP_PC_WORD:
+        return base_pc + (((uval >> 16) & 0xffff) | (uval << 16));
+    default:
+        return base_pc;
+    }
+}
+
+/* Decode the 16-bit instruction INSN at MEMADDR from the lookup table.
+   Returns the length like nanomips_decode, or -1 if the entry has to
+   go through the slow path.  */
+
+static int
+nanomips_decode_lut16 (bfd_uint64_t insn, bfd_vma memaddr, const struct nanomips_opcode **out_op,
+                       nanomips_decoded_op *out_operands)
+{
+    const struct nanomips_lut16_entry *entry = &lut16[nanomips_lut16_key (insn)];
+    const struct nanomips_compiled_opcode *compiled;
+    const struct nanomips_compiled_operand *cop;
+    unsigned int i;
+
+    if (entry->opcode == LUT16_INVALID)
+        return 0;
+    if (entry->opcode == LUT16_SLOW)
+        return -1;
+
+    compiled = &compiled_opcodes[entry->opcode];
+    cop = &compiled_operands[compiled->first];
+    for (i = 0; i < compiled->count; i++, cop++)
+    {
+        out_operands[i].op = (struct nanomips_operand *) cop->operand;
+        out_operands[i].val = entry->val[i];
+        out_operands[i].base_pc = memaddr + (cop->pcrel ? 2 : 0);
+    }
+
+    *out_op = &nanomips_opcodes[entry->opcode];
+    return 2;
+}
+
+static unsigned int
+nanomips_read16 (const bfd_byte *bytes, int big_endian)
+{
+    if (big_endian)
+        return bfd_getb16 (bytes);
+    return bfd_getl16 (bytes);
+}
+
+/* Assemble the LENGTH byte instruction at BYTES into the layout the
+   opcode table matches against.  */
+
+static bfd_uint64_t
+nanomips_read_insn (const bfd_byte *bytes, unsigned int length, int big_endian)
+{
+    bfd_uint64_t insn = nanomips_read16 (bytes, big_endian);
+    bfd_uint64_t higher;
+
+    if (length == 6)
+    {
+        /* This is a 48-bit nanoMIPS instruction. */
+        higher = nanomips_read16 (bytes + 2, big_endian) << 16;
+        higher |= nanomips_read16 (bytes + 4, big_endian);
+        insn |= (higher << 32);
+    }
+    else if (length == 4)
+    {
+        /* This is a 32-bit nanoMIPS instruction.  */
+        insn = (insn << 16) | nanomips_read16 (bytes + 2, big_endian);
+    }
+    return insn;
+}
+
+size_t nanomips_decode (const nanomips_decoder *decoder, const uint8_t *bytes, size_t avail, bfd_vma pc,
+                        unsigned int flags, nanomips_decode_result *result, nanomips_decoded_op *out_operands)
+{
+    const struct nanomips_compiled_opcode *compiled;
+    const struct nanomips_opcode *op;
+    bfd_boolean have_reloc = (flags & INSN_HAS_RELOC) != 0;
+    unsigned int length, i;
+    bfd_uint64_t insn;
+
+    result->op = NULL;
+    result->insn_type = dis_noninsn;
+    result->target = NANOMIPS_NO_TARGET;
+
+    if (avail < 2)
+        return 0;
+
+    insn = nanomips_read16 (bytes, decoder->big_endian);
+    length = nanomips_insn_length (insn);
+    if (avail < length)
+        return 0;
+
+    nanomips_init_dispatch ();
+
+    op = NULL;
+    if (length == 2 && !have_reloc
+        && nanomips_decode_lut16 (insn, pc, &op, out_operands) == 0)
+        return 0;
+
+    if (op == NULL)
+    {
+        insn = nanomips_read_insn (bytes, length, decoder->big_endian);
+        op = nanomips_find_opcode (insn, length, pc, have_reloc, out_operands);
+        if (op == NULL)
+            return 0;
+    }
+
+    compiled = &compiled_opcodes[op - nanomips_opcodes];
+    i = compiled->pcrel_operand;
+    /* With a relocation, the operands are not relative to PC yet.  */
+    if (i != NO_PCREL_OPERAND && !have_reloc)
+        result->target = nanomips_pcrel_target (compiled_operands[compiled->first + i].operand,
+                                                out_operands[i].base_pc, out_operands[i].val);
+
+    result->insn_type = (enum dis_insn_type) compiled->insn_type;
+    result->op = op;
+    return length;
+}
+
+size_t nanomips_decode_buf(const uint8_t *bytes, size_t avail, bfd_vma pc, disassemble_info *info, const struct nanomips_opcode **out_op, nanomips_decoded_op *out_operands)
+{
+    nanomips_decoder decoder;
+    nanomips_decode_result result;
+    size_t length;
+
+    decoder.big_endian = info->endian == BFD_ENDIAN_BIG;
+    length = nanomips_decode (&decoder, bytes, avail, pc, info->flags, &result, out_operands);
+
+    info->bytes_per_chunk = 2;
+    info->display_endian = info->endian;
+    info->insn_info_valid = 1;
+    info->branch_delay_insns = 0;
+    info->data_size = 0;
+    info->insn_type = result.insn_type;
+    info->target = result.target != NANOMIPS_NO_TARGET ? result.target : 0;
+    info->target2 = 0;
 
-        if (op->args[0])
-            nanomips_disasm_operands(info, op, insn, memaddr, length, out_operands);
+    if (length != 0)
+        *out_op = result.op;
+    return length;
+}
+
+void nanomips_stream_init (nanomips_insn_stream *stream)
+{
+    memset (stream, 0, sizeof (*stream));
+}
+
+void nanomips_stream_free (nanomips_insn_stream *stream)
+{
+    free (stream->offset);
+    free (stream->length);
+    free (stream->opcode);
+    free (stream->vals_start);
+    free (stream->target);
+    free (stream->vals);
+    nanomips_stream_init (stream);
+}
+
+#define STREAM_GROW(ptr, n) \
+    ((ptr) = realloc ((ptr), (n) * sizeof (*(ptr))))
+
+static bfd_boolean
+nanomips_stream_reserve (nanomips_insn_stream *stream, size_t slots, size_t vals)
+{
+    if (slots > stream->capacity)
+    {
+        if (slots < stream->capacity * 2)
+            slots = stream->capacity * 2;
+        if (!STREAM_GROW (stream->offset, slots)
+            || !STREAM_GROW (stream->length, slots)
+            || !STREAM_GROW (stream->opcode, slots)
+            || !STREAM_GROW (stream->target, slots)
+            /* One extra entry, so the operands of the last slot are bounded too.  */
+            || !STREAM_GROW (stream->vals_start, slots + 1))
+            return FALSE;
+        stream->capacity = slots;
+    }
+    if (vals > stream->vals_capacity)
+    {
+        if (vals < stream->vals_capacity * 2)
+            vals = stream->vals_capacity * 2;
+        if (!STREAM_GROW (stream->vals, vals))
+            return FALSE;
+        stream->vals_capacity = vals;
+    }
+    return TRUE;
+}
+
+#undef STREAM_GROW
+
+size_t nanomips_decode_range (const nanomips_decoder *decoder, const uint8_t *buf, size_t len,
+                              bfd_vma base_pc, nanomips_insn_stream *out)
+{
+    nanomips_decoded_op operands[NANOMIPS_STREAM_MAX_OPS];
+    const struct nanomips_lut16_entry *entry;
+    const struct nanomips_opcode *op;
+    const struct nanomips_compiled_opcode *compiled;
+    const struct nanomips_compiled_operand *cop;
+    size_t pos = 0, slot = 0, nvals = 0;
+    unsigned int length, i;
+    uint32_t *offsets, *vals_start, *targets, *vals;
+    uint8_t *lengths;
+    uint16_t *opcodes;
+    uint32_t target;
+    int opcode;
+    bfd_uint64_t insn;
+    bfd_vma pc;
+
+    nanomips_init_dispatch ();
+
+    out->base_pc = base_pc;
+    out->count = 0;
+    out->num_vals = 0;
+    out->end = 0;
+
+    /* Most code is made of 16 and 32-bit instructions.  */
+    if (!nanomips_stream_reserve (out, len / 3 + 1, len / 2 + 1))
+        return (size_t) -1;
+
+    /* The arrays are only reloaded when they grow, keeping the stores
+       below from forcing reloads of the stream fields.  */
+#define STREAM_LOAD() \
+    (offsets = out->offset, lengths = out->length, opcodes = out->opcode, \
+     vals_start = out->vals_start, targets = out->target, vals = out->vals)
+    STREAM_LOAD ();
+
+    while (len - pos >= 2)
+    {
+        if (slot >= out->capacity || nvals + NANOMIPS_STREAM_MAX_OPS > out->vals_capacity)
+        {
+            if (!nanomips_stream_reserve (out, slot + 1, nvals + NANOMIPS_STREAM_MAX_OPS))
+                return (size_t) -1;
+            STREAM_LOAD ();
+        }
 
-        // if (op->args[0])
-        //     print_insn_args (info, op, decode, insn, memaddr, length);
+        insn = nanomips_read16 (buf + pos, decoder->big_endian);
+        length = nanomips_insn_length (insn);
+        /* Truncated instruction at the end of the range.  */
+        if (len - pos < length)
+            break;
 
-        /* Figure out instruction type and branch delay information.  */
-        if ((op->pinfo2 & INSN2_UNCOND_BRANCH) != 0)
+        pc = base_pc + pos;
+        target = NANOMIPS_NO_TARGET;
+        opcode = NANOMIPS_STREAM_INVALID;
+        vals_start[slot] = nvals;
+
+        /* Unlike nanomips_decode, write the values straight into the
+           stream instead of expanding the operands first.  */
+        entry = length == 2 ? &lut16[nanomips_lut16_key (insn)] : NULL;
+        if (entry != NULL && entry->opcode >= 0)
+        {
+            compiled = &compiled_opcodes[entry->opcode];
+            cop = &compiled_operands[compiled->first];
+            for (i = 0; i < compiled->count; i++, cop++)
             {
-            if ((op->pinfo & (INSN_WRITE_GPR_31 | INSN_WRITE_1)) != 0)
-            info->insn_type = dis_jsr;
-            else
-            info->insn_type = dis_branch;
+                vals[nvals++] = entry->val[i];
+                if (cop->pcrel && target == NANOMIPS_NO_TARGET)
+                    target = nanomips_pcrel_target (cop->operand, pc + 2, entry->val[i]);
             }
-        else if ((op->pinfo2 & INSN2_COND_BRANCH) != 0)
+            opcode = entry->opcode;
+        }
+        else if (entry == NULL || entry->opcode == LUT16_SLOW)
+        {
+            insn = nanomips_read_insn (buf + pos, length, decoder->big_endian);
+            /* Relocation information is per instruction and cannot apply to a whole range.  */
+            op = nanomips_find_opcode (insn, length, pc, FALSE, operands);
+            if (op != NULL)
             {
-            if ((op->pinfo & INSN_WRITE_GPR_31) != 0)
-            info->insn_type = dis_condjsr;
-            else
-            info->insn_type = dis_condbranch;
+                compiled = &compiled_opcodes[op - nanomips_opcodes];
+                cop = &compiled_operands[compiled->first];
+                for (i = 0; i < compiled->count; i++, cop++)
+                {
+                    /* Don't-care operands are never written by the decoder.  */
+                    vals[nvals++] = cop->extract == EXTRACT_NONE ? 0 : operands[i].val;
+                    if (cop->pcrel && target == NANOMIPS_NO_TARGET)
+                        target = nanomips_pcrel_target (cop->operand, operands[i].base_pc, operands[i].val);
+                }
+                opcode = op - nanomips_opcodes;
             }
-        else if ((op->pinfo & (INSN_STORE_MEMORY | INSN_LOAD_MEMORY)) != 0)
-            info->insn_type = dis_dref;
+        }
 
-        memcpy(out_op, op, sizeof(*op));
+        /* Undecodable halfwords get a 2 byte slot, so the sweep resyncs.  */
+        if (opcode == NANOMIPS_STREAM_INVALID)
+            length = 2;
+        offsets[slot] = pos;
+        lengths[slot] = length;
+        opcodes[slot] = opcode;
+        targets[slot] = target;
+        pos += length;
+        slot++;
+    }
+#undef STREAM_LOAD
+
+    vals_start[slot] = nvals;
+    out->count = slot;
+    out->num_vals = nvals;
+    out->end = pos;
+    return slot;
+}
 
-        return length;
+unsigned int nanomips_num_operands (const struct nanomips_opcode *op)
+{
+    nanomips_init_dispatch ();
+    return compiled_opcodes[op - nanomips_opcodes].count;
+}
+
+unsigned int nanomips_expand_operands (const struct nanomips_opcode *op, const uint32_t *vals,
+                                       bfd_vma pc, unsigned int length, nanomips_decoded_op *out_operands)
+{
+    const struct nanomips_compiled_opcode *compiled;
+    const struct nanomips_compiled_operand *cop;
+    unsigned int i;
+
+    nanomips_init_dispatch ();
+
+    compiled = &compiled_opcodes[op - nanomips_opcodes];
+    cop = &compiled_operands[compiled->first];
+    for (i = 0; i < compiled->count; i++, cop++)
+    {
+        out_operands[i].op = (struct nanomips_operand *) cop->operand;
+        out_operands[i].val = vals[i];
+        out_operands[i].base_pc = pc + (cop->pcrel ? length : 0);
+    }
+    return compiled->count;
+}
+
+unsigned int nanomips_stream_operands (const nanomips_insn_stream *stream, size_t slot,
+                                       nanomips_decoded_op *out_operands)
+{
+    if (stream->opcode[slot] == NANOMIPS_STREAM_INVALID)
+        return 0;
+
+    return nanomips_expand_operands (&nanomips_opcodes[stream->opcode[slot]],
+                                     &stream->vals[stream->vals_start[slot]],
+                                     stream->base_pc + stream->offset[slot],
+                                     stream->length[slot], out_operands);
+}
+
+size_t nanomips_disasm_instr(bfd_vma memaddr_base, disassemble_info *info, struct nanomips_opcode *out_op, nanomips_decoded_op* out_operands)
+{
+    const struct nanomips_opcode *op = NULL;
+    bfd_byte buffer[6];
+    unsigned int length;
+    int status;
+
+    bfd_vma memaddr = memaddr_base;
+
+    status = (*info->read_memory_func) (memaddr, buffer, 2, info);
+    if (status != 0)
+    {
+        (*info->memory_error_func) (status, memaddr, info);
+        return -1;
+    }
+
+    length = nanomips_insn_length (nanomips_read16 (buffer, info->endian == BFD_ENDIAN_BIG));
+    if (length > 2)
+    {
+        status = (*info->read_memory_func) (memaddr + 2, buffer + 2, length - 2, info);
+        if (status != 0)
+        {
+            (*info->memory_error_func) (status, memaddr + 2, info);
+            return -1;
         }
     }
 
-  info->insn_type = dis_noninsn;
-  return 0;
+    length = nanomips_decode_buf (buffer, length, memaddr, info, &op, out_operands);
+    if (length != 0)
+        memcpy(out_op, op, sizeof(*op));
+
+    return length;
 }
 
 void nanomips_disasm_operands (struct disassemble_info *info,
@@ -1,6 +1,7 @@
 #ifndef __NANOMIPS_DIS_H
 #define __NANOMIPS_DIS_H
 
+#include <stdint.h>
 #include <string.h>
 #define PACKAGE 1
 #define PACKAGE_VERSION 1
@@ -18,6 +19,100 @@ typedef struct nanomips_decoded_op {
 } nanomips_decoded_op;
 
 
+/* Build the lookup tables shared by all decoders.  Safe to call from
+   several threads at once, only the first call does any work.  Called on
+   first decode, but should be called once at startup.  */
+void nanomips_init_dispatch(void);
+
+/* Length in bytes (2, 4 or 6) of the instruction starting with FIRST_HALFWORD.  */
+unsigned int nanomips_insn_length(unsigned int first_halfword);
+
+/* Target of an instruction without a PC-relative operand.  */
+#define NANOMIPS_NO_TARGET 0xffffffffu
+
+/* Decoder settings.  Unlike disassemble_info, the decoder never writes to
+   this, so one instance can be shared by any number of threads.  */
+typedef struct nanomips_decoder {
+    /* Nonzero if instructions are stored big-endian.  */
+    int big_endian;
+} nanomips_decoder;
+
+/* What is known about a decoded instruction, besides its operands.  */
+typedef struct nanomips_decode_result {
+    /* Entry of nanomips_opcodes[], NULL if nothing was decoded.  */
+    const struct nanomips_opcode *op;
+    /* dis_branch, dis_condjsr, dis_dref and so on.  */
+    enum dis_insn_type insn_type;
+    /* Address referenced by the first PC-relative operand, or NANOMIPS_NO_TARGET.  */
+    bfd_vma target;
+} nanomips_decode_result;
+
+/* Decode the instruction at PC from the AVAIL bytes at BYTES into RESULT
+   and OUT_OPERANDS, which both belong to the caller.  FLAGS may contain
+   INSN_HAS_RELOC, if a relocation applies to the instruction.
+   Returns the instruction length, or 0 if the bytes are not a valid
+   instruction or AVAIL is too short.  Reentrant.  */
+size_t nanomips_decode(const nanomips_decoder *decoder, const uint8_t *bytes, size_t avail, bfd_vma pc, unsigned int flags, nanomips_decode_result *result, nanomips_decoded_op *out_operands);
+
+/* nanomips_decode, with the settings taken from INFO and the result
+   stored back into it like the binutils disassembler does.  Since INFO is
+   written, it cannot be shared between threads.  On success, *OUT_OP
+   points into nanomips_opcodes[].  */
+size_t nanomips_decode_buf(const uint8_t* bytes, size_t avail, bfd_vma pc, disassemble_info *info, const struct nanomips_opcode **out_op, nanomips_decoded_op* out_operands);
+
+/* Opcode index of a stream slot that holds an undecodable halfword.  */
+#define NANOMIPS_STREAM_INVALID 0xffff
+/* Upper bound on the number of operands of a single instruction.  */
+#define NANOMIPS_STREAM_MAX_OPS 8
+
+/* A linearly decoded range, as parallel arrays indexed by slot.
+   Slot I is the instruction at base_pc + offset[I].  Its raw operand values
+   are vals[vals_start[I]] up to vals[vals_start[I + 1]], in the order of the
+   operands of nanomips_opcodes[opcode[I]].  */
+typedef struct nanomips_insn_stream {
+    bfd_vma base_pc;
+    size_t count;
+    /* Number of bytes covered by the slots.  A truncated instruction at the
+       end of the range is not part of the stream.  */
+    size_t end;
+    uint32_t *offset;
+    /* 2, 4 or 6.  */
+    uint8_t *length;
+    /* Index into nanomips_opcodes, or NANOMIPS_STREAM_INVALID.  */
+    uint16_t *opcode;
+    uint32_t *vals_start;
+    /* Address referenced by the first PC-relative operand, or NANOMIPS_NO_TARGET.  */
+    uint32_t *target;
+    uint32_t *vals;
+    size_t num_vals;
+
+    size_t capacity;
+    size_t vals_capacity;
+} nanomips_insn_stream;
+
+void nanomips_stream_init(nanomips_insn_stream *stream);
+void nanomips_stream_free(nanomips_insn_stream *stream);
+
+/* Decode the LEN bytes at BUF, which are located at BASE_PC, into OUT,
+   replacing its previous contents.  Undecodable halfwords get a slot of
+   their own, so the sweep stays in sync.  No relocations are applied.
+   Reentrant, as long as every thread has its own OUT.
+   Returns the number of slots, or (size_t) -1 if allocation failed.  */
+size_t nanomips_decode_range(const nanomips_decoder *decoder, const uint8_t *buf, size_t len, bfd_vma base_pc, nanomips_insn_stream *out);
+
+/* Expand SLOT of STREAM into the nanomips_decode operand format.
+   Returns the number of operands written.  */
+unsigned int nanomips_stream_operands(const nanomips_insn_stream *stream, size_t slot, nanomips_decoded_op *out_operands);
+
+/* Number of operands nanomips_decode produces for OP.  */
+unsigned int nanomips_num_operands(const struct nanomips_opcode *op);
+
+/* Rebuild the operands of OP, an instruction of LENGTH bytes at PC, from
+   their raw VALS, as nanomips_decode would have produced them without
+   INSN_HAS_RELOC.  Returns the number of operands written.  */
+unsigned int nanomips_expand_operands(const struct nanomips_opcode *op, const uint32_t *vals, bfd_vma pc, unsigned int length, nanomips_decoded_op *out_operands);
+
+/* nanomips_decode_buf on the bytes read through info->read_memory_func.  */
 size_t nanomips_disasm_instr(bfd_vma memaddr_base, disassemble_info *info, struct nanomips_opcode *op, nanomips_decoded_op* out_operands);
 void nanomips_disasm_operands (struct disassemble_info *info,
 		 const struct nanomips_opcode *opcode,
@@ -48,183 +143,6 @@ init_print_arg_state (struct nanomips_print_arg_state *state)
   memset (state, 0, sizeof (*state));
 }
 
-/* Record information about a register operand.  */
-
-static void
-nanomips_seen_register (struct nanomips_print_arg_state *state,
-			unsigned int regno,
-			enum nanomips_reg_operand_type reg_type)
-{
-  state->last_reg_type = reg_type;
-  state->last_regno = regno;
-
-  if (!state->seen_dest)
-    {
-      state->seen_dest = 1;
-      state->dest_regno = regno;
-    }
-}
-
-
-/* Check if register+select map to a valid CP0 select sequence.  */
-
-static bfd_boolean
-validate_cp0_reg_operand (unsigned int uval)
-{
-  int i;
-  unsigned int regno, selnum;
-  regno = uval >> NANOMIPSOP_SH_CP0SEL;
-  selnum = uval & NANOMIPSOP_MASK_CP0SEL;
-
-  for (i = 0; nanomips_cp0_3264r6[i].name; i++)
-    if (regno == nanomips_cp0_3264r6[i].num
-	&& selnum == nanomips_cp0_3264r6[i].sel)
-      break;
-    else if (regno < nanomips_cp0_3264r6[i].num)
-      return FALSE;
-
-  if (nanomips_cp0_3264r6[i].name == NULL)
-    return FALSE;
-
-  return TRUE;
-}
-
-/* Validate the arguments for INSN, which is described by OPCODE.
-   Use DECODE_OPERAND to get the encoding of each operand.  */
-
-static bfd_boolean
-validate_insn_args (const struct nanomips_opcode *opcode,
-		    const struct nanomips_operand *(*decode_operand) (const char *),
-		    unsigned int insn, struct disassemble_info *info)
-{
-  struct nanomips_print_arg_state state;
-  const struct nanomips_operand *operand;
-  const char *s;
-  unsigned int uval;
-
-  init_print_arg_state (&state);
-  for (s = opcode->args; *s; ++s)
-    {
-      switch (*s)
-	{
-	case ',':
-	case '(':
-	case ')':
-	  break;
-
-	case '#':
-	  ++s;
-	  break;
-
-	default:
-	  operand = decode_operand (s);
-
-	  if (!operand)
-	    continue;
-
-	  uval = nanomips_extract_operand (operand, insn);
-	  switch (operand->type)
-	    {
-	    case OP_REG:
-	    case OP_OPTIONAL_REG:
-	    case OP_BASE_CHECK_OFFSET:
-	      {
-		const struct nanomips_reg_operand *reg_op;
-
-		reg_op = (const struct nanomips_reg_operand *) operand;
-
-		if (operand->type == OP_REG
-		    && reg_op->reg_type == OP_REG_CP0
-		    && !validate_cp0_reg_operand (uval))
-		  return FALSE;
-
-		uval = nanomips_decode_reg_operand (reg_op, uval);
-		nanomips_seen_register (&state, uval, reg_op->reg_type);
-	      }
-	      break;
-
-	    case OP_CHECK_PREV:
-	      {
-		const struct nanomips_check_prev_operand *prev_op
-		  = (const struct nanomips_check_prev_operand *) operand;
-
-		if (!prev_op->zero_ok && uval == 0)
-		  return FALSE;
-
-		if (((prev_op->less_than_ok && uval < state.last_regno)
-		     || (prev_op->greater_than_ok && uval > state.last_regno)
-		     || (prev_op->equal_ok && uval == state.last_regno)))
-		  break;
-
-		return FALSE;
-	      }
-
-	    case OP_MAPPED_CHECK_PREV:
-	      {
-		const struct nanomips_mapped_check_prev_operand *prev_op =
-		  (const struct nanomips_mapped_check_prev_operand *) operand;
-		unsigned int last_uval =
-		  nanomips_encode_reg_operand (operand, state.last_regno);
-
-		if (((prev_op->less_than_ok && uval < last_uval)
-		     || (prev_op->greater_than_ok && uval > last_uval)
-		     || (prev_op->equal_ok && uval == last_uval)))
-		  break;
-
-		return FALSE;
-	      }
-
-	    case OP_NON_ZERO_REG:
-	      if (uval == 0)
-		return FALSE;
-	      break;
-
-	    case OP_NON_ZERO_PCREL_S1:
-	      if (uval == 0 && (info->flags & INSN_HAS_RELOC) == 0)
-		return FALSE;
-	      break;
-
-	    case OP_SAVE_RESTORE_LIST:
-	      {
-		/* The operand for SAVE/RESTORE is split into 3 pieces
-		   rather than just 2 but we only support a 2-way split
-		   decode the last bit of the instruction here.  */
-		if (opcode->mask >> 16 != 0 && ((insn >> 20) & 0x1) != 0)
-		  return FALSE;
-	      }
-	      break;
-
-	    case OP_IMM_INT:
-	    case OP_IMM_WORD:
-	    case OP_NEG_INT:
-	    case OP_INT:
-	    case OP_MAPPED_INT:
-	    case OP_MSB:
-	    case OP_REG_PAIR:
-	    case OP_PCREL:
-	    case OP_REPEAT_PREV_REG:
-	    case OP_REPEAT_DEST_REG:
-	    case OP_SAVE_RESTORE_FP_LIST:
-	    case OP_HI20_INT:
-	    case OP_HI20_PCREL:
-	    case OP_INT_WORD:
-	    case OP_UINT_WORD:
-	    case OP_PC_WORD:
-	    case OP_GPREL_WORD:
-	    case OP_DONT_CARE:
-	    case OP_HI20_SCALE:
-	    case OP_COPY_BITS:
-	    case OP_CP0SEL:
-	      break;
-	    }
-
-	  if (*s == 'm' || *s == '+' || *s == '-' || *s == '`')
-	    ++s;
-	}
-    }
-  return TRUE;
-}
-
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,166 @@
+#include "nanomips-len.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(_MSC_VER)
+#define NANOMIPS_LEN_X86 1
+#include <immintrin.h>
+#endif
+
+/* Same rules as nanomips_insn_length: 48-bit if (hw & 0xfc00) == 0x6000,
+   32-bit if bit 12 is clear and 16-bit otherwise.  Written without branches,
+   so the compiler is free to vectorize it on its own as well.  */
+
+static inline uint8_t
+nanomips_halfword_length (unsigned int hw)
+{
+    return 2 + 2 * ((hw & 0x1000) == 0) + 2 * ((hw & 0xfc00) == 0x6000);
+}
+
+void nanomips_classify_lengths_scalar (const uint8_t *bytes, size_t len, int big_endian, uint8_t *out)
+{
+    size_t i, count = len / 2;
+
+    if (big_endian)
+    {
+        for (i = 0; i < count; i++)
+            out[i] = nanomips_halfword_length ((bytes[2 * i] << 8) | bytes[2 * i + 1]);
+        return;
+    }
+
+    for (i = 0; i < count; i++)
+        out[i] = nanomips_halfword_length (bytes[2 * i] | (bytes[2 * i + 1] << 8));
+}
+
+#ifdef NANOMIPS_LEN_X86
+
+/* SSE2 is part of x86-64, so this one needs no runtime check there.
+   Each 16-bit lane becomes 2 + (bit 12 clear ? 2 : 0) + (48-bit ? 2 : 0),
+   after which the lanes are narrowed to bytes.  */
+
+__attribute__ ((target ("sse2")))
+static size_t
+nanomips_classify_lengths_sse2 (const uint8_t *bytes, size_t count, uint8_t *out)
+{
+    const __m128i bit12 = _mm_set1_epi16 (0x1000);
+    const __m128i major_mask = _mm_set1_epi16 ((short) 0xfc00);
+    const __m128i major_48 = _mm_set1_epi16 (0x6000);
+    const __m128i two = _mm_set1_epi16 (2);
+    const __m128i zero = _mm_setzero_si128 ();
+    size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16)
+    {
+        __m128i hw[2], len[2];
+        int j;
+
+        hw[0] = _mm_loadu_si128 ((const __m128i *) (bytes + 2 * i));
+        hw[1] = _mm_loadu_si128 ((const __m128i *) (bytes + 2 * i + 16));
+        for (j = 0; j < 2; j++)
+        {
+            __m128i is32 = _mm_cmpeq_epi16 (_mm_and_si128 (hw[j], bit12), zero);
+            __m128i is48 = _mm_cmpeq_epi16 (_mm_and_si128 (hw[j], major_mask), major_48);
+            len[j] = _mm_add_epi16 (two, _mm_and_si128 (is32, two));
+            len[j] = _mm_add_epi16 (len[j], _mm_and_si128 (is48, two));
+        }
+        _mm_storeu_si128 ((__m128i *) (out + i), _mm_packus_epi16 (len[0], len[1]));
+    }
+    return i;
+}
+
+__attribute__ ((target ("avx2")))
+static size_t
+nanomips_classify_lengths_avx2 (const uint8_t *bytes, size_t count, uint8_t *out)
+{
+    const __m256i bit12 = _mm256_set1_epi16 (0x1000);
+    const __m256i major_mask = _mm256_set1_epi16 ((short) 0xfc00);
+    const __m256i major_48 = _mm256_set1_epi16 (0x6000);
+    const __m256i two = _mm256_set1_epi16 (2);
+    const __m256i zero = _mm256_setzero_si256 ();
+    size_t i;
+
+    for (i = 0; i + 32 <= count; i += 32)
+    {
+        __m256i hw[2], len[2], packed;
+        int j;
+
+        hw[0] = _mm256_loadu_si256 ((const __m256i *) (bytes + 2 * i));
+        hw[1] = _mm256_loadu_si256 ((const __m256i *) (bytes + 2 * i + 32));
+        for (j = 0; j < 2; j++)
+        {
+            __m256i is32 = _mm256_cmpeq_epi16 (_mm256_and_si256 (hw[j], bit12), zero);
+            __m256i is48 = _mm256_cmpeq_epi16 (_mm256_and_si256 (hw[j], major_mask), major_48);
+            len[j] = _mm256_add_epi16 (two, _mm256_and_si256 (is32, two));
+            len[j] = _mm256_add_epi16 (len[j], _mm256_and_si256 (is48, two));
+        }
+        /* packus works within 128-bit lanes, put the quadwords back in order.  */
+        packed = _mm256_packus_epi16 (len[0], len[1]);
+        packed = _mm256_permute4x64_epi64 (packed, 0xd8);
+        _mm256_storeu_si256 ((__m256i *) (out + i), packed);
+    }
+    return i;
+}
+
+#endif
+
+typedef size_t (*nanomips_classify_kernel) (const uint8_t *bytes, size_t count, uint8_t *out);
+
+static nanomips_classify_kernel classify_kernel = NULL;
+static const char *classify_kernel_name = "scalar";
+static int classify_kernel_selected = 0;
+
+static void
+nanomips_select_kernel (void)
+{
+    classify_kernel_selected = 1;
+#ifdef NANOMIPS_LEN_X86
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2"))
+    {
+        classify_kernel_name = "avx2";
+        classify_kernel = nanomips_classify_lengths_avx2;
+        return;
+    }
+    if (__builtin_cpu_supports ("sse2"))
+    {
+        classify_kernel_name = "sse2";
+        classify_kernel = nanomips_classify_lengths_sse2;
+        return;
+    }
+#endif
+}
+
+const char *nanomips_classify_lengths_kernel (void)
+{
+    if (!classify_kernel_selected)
+        nanomips_select_kernel ();
+    return classify_kernel_name;
+}
+
+void nanomips_classify_lengths (const uint8_t *bytes, size_t len, int big_endian, uint8_t *out)
+{
+    size_t done = 0;
+
+    if (!classify_kernel_selected)
+        nanomips_select_kernel ();
+
+    /* The vector kernels only handle little-endian code, which is what
+       nanoMIPS firmware is in practice.  */
+    if (classify_kernel != NULL && !big_endian)
+        done = classify_kernel (bytes, len / 2, out);
+
+    nanomips_classify_lengths_scalar (bytes + 2 * done, len - 2 * done, big_endian, out + done);
+}
+
+size_t nanomips_insn_starts (const uint8_t *lengths, size_t num_halfwords, size_t start, uint32_t *starts, size_t max)
+{
+    size_t hw = start / 2, count = 0;
+
+    while (hw < num_halfwords && count < max)
+    {
+        size_t next = hw + lengths[hw] / 2;
+        if (next > num_halfwords)
+            break;
+        starts[count++] = hw * 2;
+        hw = next;
+    }
+    return count;
+}
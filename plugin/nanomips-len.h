@@ -0,0 +1,38 @@
+#ifndef __NANOMIPS_LEN_H
+#define __NANOMIPS_LEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bulk instruction length classification.
+   The length of a nanoMIPS instruction only depends on its first halfword,
+   so the length of an instruction starting at every halfword of a segment
+   can be computed without decoding anything.  */
+
+/* Write the length (2, 4 or 6) of an instruction starting at each of the
+   LEN / 2 halfwords at BYTES to OUT.  Uses the widest vector unit the CPU
+   supports.  */
+void nanomips_classify_lengths(const uint8_t *bytes, size_t len, int big_endian, uint8_t *out);
+
+/* Same as nanomips_classify_lengths, without any vector instructions.  */
+void nanomips_classify_lengths_scalar(const uint8_t *bytes, size_t len, int big_endian, uint8_t *out);
+
+/* Name of the kernel used by nanomips_classify_lengths on this CPU.  */
+const char *nanomips_classify_lengths_kernel(void);
+
+/* Follow the instruction chain through LENGTHS (NUM_HALFWORDS entries, as
+   produced by nanomips_classify_lengths), starting at byte offset START.
+   Writes the byte offsets of up to MAX instruction starts to STARTS and
+   returns how many were written.  An instruction running past the end of
+   the range is not included.  */
+size_t nanomips_insn_starts(const uint8_t *lengths, size_t num_halfwords, size_t start, uint32_t *starts, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANOMIPS_LEN_H */
@@ -0,0 +1,626 @@
+#include "nanomips-reloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define ET_REL 1
+#define SHT_RELA 4
+#define SHT_NOBITS 8
+#define SHT_REL 9
+#define SHF_ALLOC 0x2
+#define SHN_LORESERVE 0xff00
+#define ELF32_EHDR_SIZE 52
+#define ELF32_SHDR_SIZE 40
+#define ELF32_SYM_SIZE 16
+
+/* How the value of a relocation is stored at its location.  */
+enum nanomips_reloc_form {
+    /* Not a static relocation.  */
+    FORM_UNSUPPORTED,
+    /* A linker hint, nothing to patch.  */
+    FORM_IGNORED,
+    FORM_DATA_UNSIGNED,
+    FORM_DATA_SIGNED,
+    FORM_DATA,
+    /* Signed, halfword aligned branch offset of BITS + 1 bits, whose top
+       bit is stored in bit 0 of the instruction and the rest in place.  */
+    FORM_BRANCH_SPLIT,
+    /* 4-bit, nonzero halfword offset of BEQC[16] and BNEC[16].  */
+    FORM_BRANCH_4,
+    /* Unsigned field of BITS bits at LSB, holding the value >> SHIFT.  */
+    FORM_FIELD,
+    /* Low 12 bits, never overflows.  */
+    FORM_LO12,
+    /* Upper 20 bits, scattered over the instruction like in LUI.  */
+    FORM_HI20,
+    /* 32-bit immediate of a 48-bit instruction.  */
+    FORM_WORD48
+};
+
+/* What is subtracted from S + A.  */
+enum nanomips_reloc_base {
+    BASE_NONE,
+    /* The address after the instruction.  */
+    BASE_PC,
+    /* The 4 KiB page of the address after the instruction, for ALUIPC.  */
+    BASE_PC_PAGE,
+    BASE_GP
+};
+
+struct nanomips_reloc_howto {
+    const char *name;
+    /* Bytes at the location, 0 if nothing is patched.  */
+    uint8_t size;
+    uint8_t form;
+    uint8_t base;
+    uint8_t bits;
+    uint8_t shift;
+    uint8_t lsb;
+};
+
+#define HOWTO(TYPE, SIZE, FORM, BASE, BITS, SHIFT, LSB) \
+    [R_NANOMIPS_##TYPE] = { "R_NANOMIPS_" #TYPE, SIZE, FORM_##FORM, BASE_##BASE, BITS, SHIFT, LSB }
+#define UNSUPPORTED(TYPE) HOWTO (TYPE, 0, UNSUPPORTED, NONE, 0, 0, 0)
+#define IGNORED(TYPE) HOWTO (TYPE, 0, IGNORED, NONE, 0, 0, 0)
+
+static const struct nanomips_reloc_howto nanomips_reloc_howtos[] = {
+    IGNORED (NONE),
+    HOWTO (32, 4, DATA, NONE, 32, 0, 0),
+    UNSUPPORTED (64),
+    UNSUPPORTED (NEG),
+    UNSUPPORTED (ASHIFTR_1),
+    HOWTO (UNSIGNED_8, 1, DATA_UNSIGNED, NONE, 8, 0, 0),
+    HOWTO (SIGNED_8, 1, DATA_SIGNED, NONE, 8, 0, 0),
+    HOWTO (UNSIGNED_16, 2, DATA_UNSIGNED, NONE, 16, 0, 0),
+    HOWTO (SIGNED_16, 2, DATA_SIGNED, NONE, 16, 0, 0),
+    /* S is the load base here.  */
+    HOWTO (RELATIVE, 4, DATA, NONE, 32, 0, 0),
+    HOWTO (GLOBAL, 4, DATA, NONE, 32, 0, 0),
+    HOWTO (JUMP_SLOT, 4, DATA, NONE, 32, 0, 0),
+    UNSUPPORTED (IRELATIVE),
+    HOWTO (PC25_S1, 4, BRANCH_SPLIT, PC, 25, 1, 0),
+    HOWTO (PC21_S1, 4, BRANCH_SPLIT, PC, 21, 1, 0),
+    HOWTO (PC14_S1, 4, BRANCH_SPLIT, PC, 14, 1, 0),
+    HOWTO (PC11_S1, 4, BRANCH_SPLIT, PC, 11, 1, 0),
+    HOWTO (PC10_S1, 2, BRANCH_SPLIT, PC, 10, 1, 0),
+    HOWTO (PC7_S1, 2, BRANCH_SPLIT, PC, 7, 1, 0),
+    HOWTO (PC4_S1, 2, BRANCH_4, PC, 4, 1, 0),
+    HOWTO (GPREL19_S2, 4, FIELD, GP, 19, 2, 2),
+    UNSUPPORTED (GPREL18_S3),
+    HOWTO (GPREL18, 4, FIELD, GP, 18, 0, 0),
+    HOWTO (GPREL17_S1, 4, FIELD, GP, 17, 1, 1),
+    UNSUPPORTED (GPREL16_S2),
+    HOWTO (GPREL7_S2, 2, FIELD, GP, 7, 2, 0),
+    HOWTO (GPREL_HI20, 4, HI20, GP, 20, 12, 0),
+    HOWTO (PCHI20, 4, HI20, PC_PAGE, 20, 12, 0),
+    HOWTO (HI20, 4, HI20, NONE, 20, 12, 0),
+    HOWTO (LO12, 4, LO12, NONE, 12, 0, 0),
+    HOWTO (GPREL_I32, 6, WORD48, GP, 32, 0, 0),
+    HOWTO (PC_I32, 6, WORD48, PC, 32, 0, 0),
+    HOWTO (I32, 6, WORD48, NONE, 32, 0, 0),
+    UNSUPPORTED (GOT_DISP),
+    UNSUPPORTED (GOTPC_I32),
+    UNSUPPORTED (GOTPC_HI20),
+    UNSUPPORTED (GOT_LO12),
+    UNSUPPORTED (GOT_CALL),
+    UNSUPPORTED (GOT_PAGE),
+    UNSUPPORTED (GOT_OFST),
+    UNSUPPORTED (LO4_S2),
+    UNSUPPORTED (RESERVED1),
+    HOWTO (GPREL_LO12, 4, LO12, GP, 12, 0, 0),
+    UNSUPPORTED (SCN_DISP),
+    /* Only matters when actually running the program.  */
+    IGNORED (COPY),
+    IGNORED (ALIGN),
+    IGNORED (FILL),
+    IGNORED (MAX),
+    IGNORED (INSN32),
+    IGNORED (FIXED),
+    IGNORED (NORELAX),
+    IGNORED (RELAX),
+    IGNORED (SAVERESTORE),
+    IGNORED (INSN16),
+    IGNORED (JALR32),
+    IGNORED (JALR16),
+    IGNORED (JUMPTABLE_LOAD),
+    IGNORED (FRAME_REG),
+    IGNORED (NOTRAP),
+    UNSUPPORTED (TLS_DTPMOD),
+    UNSUPPORTED (TLS_DTPREL),
+    UNSUPPORTED (TLS_TPREL),
+};
+
+#define NUM_HOWTOS (sizeof (nanomips_reloc_howtos) / sizeof (nanomips_reloc_howtos[0]))
+
+static const struct nanomips_reloc_howto *
+nanomips_reloc_howto (unsigned int type)
+{
+    if (type >= NUM_HOWTOS || nanomips_reloc_howtos[type].name == NULL)
+        return NULL;
+    return &nanomips_reloc_howtos[type];
+}
+
+const char *nanomips_reloc_name (unsigned int type)
+{
+    const struct nanomips_reloc_howto *howto = nanomips_reloc_howto (type);
+    return howto != NULL ? howto->name : NULL;
+}
+
+unsigned int nanomips_reloc_size (unsigned int type)
+{
+    const struct nanomips_reloc_howto *howto = nanomips_reloc_howto (type);
+    return howto != NULL ? howto->size : 0;
+}
+
+int nanomips_reloc_uses_gp (unsigned int type)
+{
+    const struct nanomips_reloc_howto *howto = nanomips_reloc_howto (type);
+    return howto != NULL && howto->base == BASE_GP;
+}
+
+static uint32_t
+read16 (const uint8_t *p, int big_endian)
+{
+    return big_endian ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8);
+}
+
+static void
+write16 (uint8_t *p, uint32_t value, int big_endian)
+{
+    p[big_endian ? 1 : 0] = value;
+    p[big_endian ? 0 : 1] = value >> 8;
+}
+
+static uint32_t
+read32 (const uint8_t *p, int big_endian)
+{
+    return big_endian ? ((uint32_t) read16 (p, 1) << 16) | read16 (p + 2, 1)
+                      : read16 (p, 0) | ((uint32_t) read16 (p + 2, 0) << 16);
+}
+
+static void
+write32 (uint8_t *p, uint32_t value, int big_endian)
+{
+    write16 (p + (big_endian ? 2 : 0), value, big_endian);
+    write16 (p + (big_endian ? 0 : 2), value >> 16, big_endian);
+}
+
+/* The field of a 16 or 32-bit instruction.  Stores the bits to set into
+   *FIELD and the bits they replace into *MASK.  */
+
+static enum nanomips_reloc_status
+nanomips_reloc_field (const struct nanomips_reloc_howto *howto, uint32_t value, uint32_t *field, uint32_t *mask)
+{
+    int32_t offset = (int32_t) value;
+    uint32_t limit;
+
+    switch (howto->form)
+    {
+    case FORM_BRANCH_SPLIT:
+        limit = (uint32_t) 1 << howto->bits;
+        if ((value & 1) != 0 || offset < -(int32_t) limit || offset > (int32_t) limit - 2)
+            return NANOMIPS_RELOC_OVERFLOW;
+        *field = (value & (limit - 2)) | ((value >> howto->bits) & 1);
+        *mask = limit - 1;
+        return NANOMIPS_RELOC_OK;
+    case FORM_BRANCH_4:
+        if ((value & 1) != 0 || value < 2 || value > 30)
+            return NANOMIPS_RELOC_OVERFLOW;
+        *field = value >> 1;
+        *mask = 0xf;
+        return NANOMIPS_RELOC_OK;
+    case FORM_FIELD:
+        limit = (uint32_t) 1 << howto->bits;
+        if ((value & ((1u << howto->shift) - 1)) != 0 || (value >> howto->shift) >= limit)
+            return NANOMIPS_RELOC_OVERFLOW;
+        *field = (value >> howto->shift) << howto->lsb;
+        *mask = (limit - 1) << howto->lsb;
+        return NANOMIPS_RELOC_OK;
+    case FORM_LO12:
+        *field = value & 0xfff;
+        *mask = 0xfff;
+        return NANOMIPS_RELOC_OK;
+    case FORM_HI20:
+        /* s[20:12] in place, s[30:21] at bits 11..2 and s[31] at bit 0.  */
+        *field = (value & 0x001ff000) | ((value >> 19) & 0xffc) | (value >> 31);
+        *mask = 0x001ffffd;
+        return NANOMIPS_RELOC_OK;
+    default:
+        return NANOMIPS_RELOC_UNSUPPORTED;
+    }
+}
+
+enum nanomips_reloc_status
+nanomips_reloc_apply (int big_endian, unsigned int type, uint8_t *loc, size_t avail, uint32_t p, uint32_t value,
+                      uint32_t gp)
+{
+    const struct nanomips_reloc_howto *howto = nanomips_reloc_howto (type);
+    enum nanomips_reloc_status status;
+    uint32_t field, mask, insn;
+
+    if (howto == NULL || howto->form == FORM_UNSUPPORTED)
+        return NANOMIPS_RELOC_UNSUPPORTED;
+    if (howto->form == FORM_IGNORED)
+        return NANOMIPS_RELOC_IGNORED;
+    if (avail < howto->size)
+        return NANOMIPS_RELOC_OUT_OF_RANGE;
+
+    switch (howto->base)
+    {
+    case BASE_PC:
+        value -= p + howto->size;
+        break;
+    case BASE_PC_PAGE:
+        value -= (p + howto->size) & ~(uint32_t) 0xfff;
+        break;
+    case BASE_GP:
+        if (gp == NANOMIPS_RELOC_NO_GP)
+            return NANOMIPS_RELOC_UNSUPPORTED;
+        value -= gp;
+        break;
+    }
+
+    switch (howto->form)
+    {
+    case FORM_DATA:
+        write32 (loc, value, big_endian);
+        return NANOMIPS_RELOC_OK;
+    case FORM_DATA_UNSIGNED:
+    case FORM_DATA_SIGNED:
+        if (howto->form == FORM_DATA_UNSIGNED
+            ? value >> howto->bits != 0
+            : (int32_t) value < -(1 << (howto->bits - 1)) || (int32_t) value >= 1 << (howto->bits - 1))
+            return NANOMIPS_RELOC_OVERFLOW;
+        if (howto->size == 1)
+            loc[0] = value;
+        else
+            write16 (loc, value, big_endian);
+        return NANOMIPS_RELOC_OK;
+    case FORM_WORD48:
+        /* The immediate is stored low halfword first, whatever the endianness.  */
+        write16 (loc + 2, value, big_endian);
+        write16 (loc + 4, value >> 16, big_endian);
+        return NANOMIPS_RELOC_OK;
+    }
+
+    status = nanomips_reloc_field (howto, value, &field, &mask);
+    if (status != NANOMIPS_RELOC_OK)
+        return status;
+    if (howto->size == 2)
+    {
+        write16 (loc, (read16 (loc, big_endian) & ~mask) | field, big_endian);
+        return NANOMIPS_RELOC_OK;
+    }
+    /* The first halfword holds the upper bits.  */
+    insn = (read16 (loc, big_endian) << 16) | read16 (loc + 2, big_endian);
+    insn = (insn & ~mask) | field;
+    write16 (loc, insn >> 16, big_endian);
+    write16 (loc + 2, insn, big_endian);
+    return NANOMIPS_RELOC_OK;
+}
+
+void nanomips_reloc_list_init (nanomips_reloc_list *list)
+{
+    memset (list, 0, sizeof (*list));
+}
+
+void nanomips_reloc_list_free (nanomips_reloc_list *list)
+{
+    free (list->address);
+    free (list->symbol);
+    free (list->addend);
+    free (list->value);
+    free (list->type);
+    nanomips_reloc_list_init (list);
+}
+
+static int
+grow (void **ptr, size_t count, size_t size)
+{
+    void *grown = realloc (*ptr, count * size);
+    if (grown == NULL)
+        return 0;
+    *ptr = grown;
+    return 1;
+}
+
+static int
+nanomips_reloc_list_reserve (nanomips_reloc_list *list, size_t count)
+{
+    if (count <= list->capacity)
+        return 1;
+    if (count < list->capacity * 2)
+        count = list->capacity * 2;
+    if (!grow ((void **) &list->address, count, sizeof (*list->address))
+        || !grow ((void **) &list->symbol, count, sizeof (*list->symbol))
+        || !grow ((void **) &list->addend, count, sizeof (*list->addend))
+        || !grow ((void **) &list->value, count, sizeof (*list->value))
+        || !grow ((void **) &list->type, count, sizeof (*list->type)))
+        return 0;
+    list->capacity = count;
+    return 1;
+}
+
+void nanomips_reloc_resolve (nanomips_reloc_list *list)
+{
+    const uint32_t *symbol = list->symbol, *addend = list->addend;
+    uint32_t *value = list->value;
+    size_t i, count = list->count;
+
+    for (i = 0; i < count; i++)
+        value[i] = symbol[i] + addend[i];
+}
+
+size_t nanomips_reloc_apply_list (int big_endian, const nanomips_reloc_list *list, uint8_t *bytes, size_t size,
+                                  uint32_t address, uint32_t gp, size_t counts[NANOMIPS_RELOC_NUM_STATUS])
+{
+    size_t i, applied = 0;
+
+    for (i = 0; i < list->count; i++)
+    {
+        uint32_t offset = list->address[i] - address;
+        enum nanomips_reloc_status status;
+
+        if (offset >= size)
+            continue;
+        status = nanomips_reloc_apply (big_endian, list->type[i], bytes + offset, size - offset, list->address[i],
+                                       list->value[i], gp);
+        applied += status == NANOMIPS_RELOC_OK;
+        if (counts != NULL)
+            counts[status]++;
+    }
+    return applied;
+}
+
+int nanomips_elf_init (nanomips_elf *elf, const uint8_t *data, size_t size)
+{
+    uint32_t shoff;
+    unsigned int shentsize;
+
+    memset (elf, 0, sizeof (*elf));
+    if (size < ELF32_EHDR_SIZE || memcmp (data, "\177ELF", 4) != 0 || data[4] != 1)
+        return -1;
+    elf->data = data;
+    elf->size = size;
+    elf->big_endian = data[5] == 2;
+    elf->type = read16 (data + 16, elf->big_endian);
+
+    shoff = read32 (data + 32, elf->big_endian);
+    shentsize = read16 (data + 46, elf->big_endian);
+    elf->num_sections = read16 (data + 48, elf->big_endian);
+    if (elf->num_sections != 0
+        && (shentsize != ELF32_SHDR_SIZE || shoff > size
+            || (size - shoff) / ELF32_SHDR_SIZE < elf->num_sections))
+        return -1;
+    return 0;
+}
+
+int nanomips_elf_map (nanomips_elf *elf, const char *path)
+{
+#ifdef _WIN32
+    HANDLE file, mapping;
+    LARGE_INTEGER size;
+    const uint8_t *data;
+
+    memset (elf, 0, sizeof (*elf));
+    file = CreateFileA (path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return -1;
+    if (!GetFileSizeEx (file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle (file);
+        return -1;
+    }
+    mapping = CreateFileMappingA (file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle (file);
+    if (mapping == NULL)
+        return -1;
+    data = MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle (mapping);
+    if (data == NULL)
+        return -1;
+    if (nanomips_elf_init (elf, data, (size_t) size.QuadPart) != 0)
+    {
+        UnmapViewOfFile (data);
+        return -1;
+    }
+    elf->mapping = (void *) data;
+    return 0;
+#else
+    struct stat st;
+    void *data;
+    int fd;
+
+    memset (elf, 0, sizeof (*elf));
+    fd = open (path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (fstat (fd, &st) != 0 || st.st_size == 0)
+    {
+        close (fd);
+        return -1;
+    }
+    data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (data == MAP_FAILED)
+        return -1;
+    if (nanomips_elf_init (elf, data, st.st_size) != 0)
+    {
+        munmap (data, st.st_size);
+        return -1;
+    }
+    elf->mapping = data;
+    return 0;
+#endif
+}
+
+void nanomips_elf_unmap (nanomips_elf *elf)
+{
+    if (elf->mapping != NULL)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile (elf->mapping);
+#else
+        munmap (elf->mapping, elf->size);
+#endif
+    }
+    memset (elf, 0, sizeof (*elf));
+}
+
+int nanomips_elf_section_at (const nanomips_elf *elf, unsigned int index, nanomips_elf_section *out)
+{
+    const uint8_t *sh;
+    nanomips_elf_section strtab;
+    uint32_t name;
+    unsigned int shstrndx;
+
+    if (index >= elf->num_sections)
+        return -1;
+    sh = elf->data + read32 (elf->data + 32, elf->big_endian) + (size_t) index * ELF32_SHDR_SIZE;
+    name = read32 (sh, elf->big_endian);
+    out->type = read32 (sh + 4, elf->big_endian);
+    out->flags = read32 (sh + 8, elf->big_endian);
+    out->addr = read32 (sh + 12, elf->big_endian);
+    out->offset = read32 (sh + 16, elf->big_endian);
+    out->size = read32 (sh + 20, elf->big_endian);
+    out->link = read32 (sh + 24, elf->big_endian);
+    out->info = read32 (sh + 28, elf->big_endian);
+    out->entsize = read32 (sh + 36, elf->big_endian);
+    if (out->type != SHT_NOBITS && (out->offset > elf->size || elf->size - out->offset < out->size))
+        return -1;
+
+    out->name = "";
+    shstrndx = read16 (elf->data + 50, elf->big_endian);
+    if (shstrndx != index && shstrndx < elf->num_sections)
+    {
+        const uint8_t *strsh = elf->data + read32 (elf->data + 32, elf->big_endian) + (size_t) shstrndx * ELF32_SHDR_SIZE;
+        strtab.offset = read32 (strsh + 16, elf->big_endian);
+        strtab.size = read32 (strsh + 20, elf->big_endian);
+        if (strtab.offset <= elf->size && elf->size - strtab.offset >= strtab.size && name < strtab.size
+            && memchr (elf->data + strtab.offset + name, 0, strtab.size - name) != NULL)
+            out->name = (const char *) elf->data + strtab.offset + name;
+    }
+    return 0;
+}
+
+void nanomips_elf_layout (const nanomips_elf *elf, uint32_t *bases)
+{
+    nanomips_elf_section sec;
+    uint32_t next = 0x10000;
+    unsigned int i;
+
+    for (i = 0; i < elf->num_sections; i++)
+    {
+        bases[i] = 0;
+        if (nanomips_elf_section_at (elf, i, &sec) != 0)
+            continue;
+        if (elf->type != ET_REL)
+        {
+            bases[i] = sec.addr;
+            continue;
+        }
+        if ((sec.flags & SHF_ALLOC) == 0)
+            continue;
+        next = (next + 15) & ~(uint32_t) 15;
+        bases[i] = next;
+        next += sec.size;
+    }
+}
+
+/* The SIZE bytes in the file at address P, NULL if they are not in it.
+   INFO is the section the relocations apply to, 0 for dynamic ones.  */
+
+static const uint8_t *
+nanomips_elf_location (const nanomips_elf *elf, const uint32_t *bases, unsigned int info, uint32_t p, size_t size)
+{
+    nanomips_elf_section sec;
+    unsigned int i, first = info, last = info;
+
+    if (info == 0)
+    {
+        first = 1;
+        last = elf->num_sections - 1;
+    }
+    for (i = first; i <= last && i < elf->num_sections; i++)
+    {
+        if (nanomips_elf_section_at (elf, i, &sec) != 0 || sec.type == SHT_NOBITS || (sec.flags & SHF_ALLOC) == 0)
+            continue;
+        if (p - bases[i] < sec.size && sec.size - (p - bases[i]) >= size)
+            return elf->data + sec.offset + (p - bases[i]);
+    }
+    return NULL;
+}
+
+size_t nanomips_elf_read_relocs (const nanomips_elf *elf, const uint32_t *bases, nanomips_reloc_list *list)
+{
+    nanomips_elf_section sec, symtab;
+    size_t appended = 0;
+    unsigned int i;
+    int be = elf->big_endian;
+
+    for (i = 0; i < elf->num_sections; i++)
+    {
+        size_t entsize, count, num_syms, j;
+        const uint8_t *rel, *syms;
+        uint32_t target = 0;
+
+        if (nanomips_elf_section_at (elf, i, &sec) != 0 || (sec.type != SHT_REL && sec.type != SHT_RELA))
+            continue;
+        entsize = sec.type == SHT_RELA ? 12 : 8;
+        count = sec.size / entsize;
+        if (nanomips_elf_section_at (elf, sec.link, &symtab) != 0 || symtab.type == SHT_NOBITS)
+            symtab.size = 0;
+        syms = elf->data + symtab.offset;
+        num_syms = symtab.size / ELF32_SYM_SIZE;
+
+        /* Dynamic relocations hold addresses, the others offsets into their section.  */
+        if (elf->type == ET_REL && sec.info < elf->num_sections)
+            target = bases[sec.info];
+        if (!nanomips_reloc_list_reserve (list, list->count + count))
+            return (size_t) -1;
+
+        rel = elf->data + sec.offset;
+        for (j = 0; j < count; j++, rel += entsize)
+        {
+            uint32_t info = read32 (rel + 4, be), sym = info >> 8, s = 0, a = 0;
+            size_t n = list->count;
+
+            if (sym != 0 && sym < num_syms)
+            {
+                const uint8_t *st = syms + (size_t) sym * ELF32_SYM_SIZE;
+                unsigned int shndx = read16 (st + 14, be);
+                s = read32 (st + 4, be);
+                if (elf->type == ET_REL && shndx != 0 && shndx < SHN_LORESERVE && shndx < elf->num_sections)
+                    s += bases[shndx];
+            }
+
+            list->address[n] = target + read32 (rel, be);
+            list->type[n] = info & 0xff;
+            if (sec.type == SHT_RELA)
+                a = read32 (rel + 8, be);
+            else if ((info & 0xff) == R_NANOMIPS_32 || (info & 0xff) == R_NANOMIPS_RELATIVE)
+            {
+                /* REL only shows up in dynamic sections, where the addend of a word is in place.
+                   GOT entries hold the address of the lazy binding stub instead.  */
+                const uint8_t *loc = nanomips_elf_location (elf, bases, elf->type == ET_REL ? sec.info : 0,
+                                                            list->address[n], 4);
+                if (loc != NULL)
+                    a = read32 (loc, be);
+            }
+            list->symbol[n] = s;
+            list->addend[n] = a;
+            list->value[n] = 0;
+            list->count++;
+        }
+        appended += count;
+    }
+    return appended;
+}
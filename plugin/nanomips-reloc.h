@@ -0,0 +1,197 @@
+#ifndef __NANOMIPS_RELOC_H
+#define __NANOMIPS_RELOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* nanoMIPS relocations, independent of BFD and the IDA SDK.
+   The ELF loader gets its relocations one at a time from IDA's ELF loader
+   and only uses nanomips_reloc_apply on them.
+   Everything from nanomips_reloc_list on reads the relocations straight
+   from the REL and RELA sections of a mapped ELF32 file into flat arrays
+   instead, so computing S + A for all of them is a single loop, after
+   which they are applied section by section.  That path is only used by
+   nmips_reloc_bench, to check and time the engine outside of IDA.  */
+
+/* Relocation types, as in the nanoMIPS ELF ABI.  */
+enum nanomips_reloc_type {
+    R_NANOMIPS_NONE = 0,
+    R_NANOMIPS_32 = 1,
+    R_NANOMIPS_64 = 2,
+    R_NANOMIPS_NEG = 3,
+    R_NANOMIPS_ASHIFTR_1 = 4,
+    R_NANOMIPS_UNSIGNED_8 = 5,
+    R_NANOMIPS_SIGNED_8 = 6,
+    R_NANOMIPS_UNSIGNED_16 = 7,
+    R_NANOMIPS_SIGNED_16 = 8,
+    R_NANOMIPS_RELATIVE = 9,
+    R_NANOMIPS_GLOBAL = 10,
+    R_NANOMIPS_JUMP_SLOT = 11,
+    R_NANOMIPS_IRELATIVE = 12,
+    R_NANOMIPS_PC25_S1 = 13,
+    R_NANOMIPS_PC21_S1 = 14,
+    R_NANOMIPS_PC14_S1 = 15,
+    R_NANOMIPS_PC11_S1 = 16,
+    R_NANOMIPS_PC10_S1 = 17,
+    R_NANOMIPS_PC7_S1 = 18,
+    R_NANOMIPS_PC4_S1 = 19,
+    R_NANOMIPS_GPREL19_S2 = 20,
+    R_NANOMIPS_GPREL18_S3 = 21,
+    R_NANOMIPS_GPREL18 = 22,
+    R_NANOMIPS_GPREL17_S1 = 23,
+    R_NANOMIPS_GPREL16_S2 = 24,
+    R_NANOMIPS_GPREL7_S2 = 25,
+    R_NANOMIPS_GPREL_HI20 = 26,
+    R_NANOMIPS_PCHI20 = 27,
+    R_NANOMIPS_HI20 = 28,
+    R_NANOMIPS_LO12 = 29,
+    R_NANOMIPS_GPREL_I32 = 30,
+    R_NANOMIPS_PC_I32 = 31,
+    R_NANOMIPS_I32 = 32,
+    R_NANOMIPS_GOT_DISP = 33,
+    R_NANOMIPS_GOTPC_I32 = 34,
+    R_NANOMIPS_GOTPC_HI20 = 35,
+    R_NANOMIPS_GOT_LO12 = 36,
+    R_NANOMIPS_GOT_CALL = 37,
+    R_NANOMIPS_GOT_PAGE = 38,
+    R_NANOMIPS_GOT_OFST = 39,
+    R_NANOMIPS_LO4_S2 = 40,
+    R_NANOMIPS_RESERVED1 = 41,
+    R_NANOMIPS_GPREL_LO12 = 42,
+    R_NANOMIPS_SCN_DISP = 43,
+    R_NANOMIPS_COPY = 44,
+    R_NANOMIPS_ALIGN = 64,
+    R_NANOMIPS_FILL = 65,
+    R_NANOMIPS_MAX = 66,
+    R_NANOMIPS_INSN32 = 67,
+    R_NANOMIPS_FIXED = 68,
+    R_NANOMIPS_NORELAX = 69,
+    R_NANOMIPS_RELAX = 70,
+    R_NANOMIPS_SAVERESTORE = 71,
+    R_NANOMIPS_INSN16 = 72,
+    R_NANOMIPS_JALR32 = 73,
+    R_NANOMIPS_JALR16 = 74,
+    R_NANOMIPS_JUMPTABLE_LOAD = 75,
+    R_NANOMIPS_FRAME_REG = 76,
+    R_NANOMIPS_NOTRAP = 77,
+    R_NANOMIPS_TLS_DTPMOD = 80,
+    R_NANOMIPS_TLS_DTPREL = 81,
+    R_NANOMIPS_TLS_TPREL = 82
+};
+
+enum nanomips_reloc_status {
+    /* The location was patched.  */
+    NANOMIPS_RELOC_OK,
+    /* Only a hint for the linker, nothing to patch.  */
+    NANOMIPS_RELOC_IGNORED,
+    /* The value does not fit into the field, or is misaligned.  */
+    NANOMIPS_RELOC_OVERFLOW,
+    /* Not a static relocation (GOT, TLS and the like), or it needs GP and
+       none was given.  */
+    NANOMIPS_RELOC_UNSUPPORTED,
+    /* The location is not inside the bytes given.  */
+    NANOMIPS_RELOC_OUT_OF_RANGE,
+    NANOMIPS_RELOC_NUM_STATUS
+};
+
+/* GP for nanomips_reloc_apply, if it is not known.  */
+#define NANOMIPS_RELOC_NO_GP 0xffffffffu
+
+/* "R_NANOMIPS_HI20" and so on, NULL for an unknown TYPE.  */
+const char *nanomips_reloc_name(unsigned int type);
+
+/* Number of bytes at the location TYPE patches (2, 4 or 6 for
+   instructions), 0 if it never patches anything.  */
+unsigned int nanomips_reloc_size(unsigned int type);
+
+/* Whether TYPE is relative to GP, so nanomips_reloc_apply needs it.  */
+int nanomips_reloc_uses_gp(unsigned int type);
+
+/* Apply relocation TYPE to the AVAIL bytes at LOC, which live at address
+   P.  VALUE is S + A, GP is the value of _gp or NANOMIPS_RELOC_NO_GP.  */
+enum nanomips_reloc_status nanomips_reloc_apply(int big_endian, unsigned int type, uint8_t *loc, size_t avail,
+                                                uint32_t p, uint32_t value, uint32_t gp);
+
+/* Relocations as parallel arrays, one entry per relocation.  */
+typedef struct nanomips_reloc_list {
+    size_t count;
+    size_t capacity;
+    /* Address of the location, P.  */
+    uint32_t *address;
+    /* Value of the symbol, S.  */
+    uint32_t *symbol;
+    /* A, either from RELA or read from the location for REL.  */
+    uint32_t *addend;
+    /* S + A, filled by nanomips_reloc_resolve.  */
+    uint32_t *value;
+    uint8_t *type;
+} nanomips_reloc_list;
+
+void nanomips_reloc_list_init(nanomips_reloc_list *list);
+void nanomips_reloc_list_free(nanomips_reloc_list *list);
+
+/* Compute S + A of every relocation in LIST.  */
+void nanomips_reloc_resolve(nanomips_reloc_list *list);
+
+/* Apply every resolved relocation of LIST that falls into the SIZE bytes
+   at BYTES, which live at ADDRESS.  Adds the outcome of each one to
+   COUNTS, if not NULL.  Returns the number of relocations patched.  */
+size_t nanomips_reloc_apply_list(int big_endian, const nanomips_reloc_list *list, uint8_t *bytes, size_t size,
+                                 uint32_t address, uint32_t gp, size_t counts[NANOMIPS_RELOC_NUM_STATUS]);
+
+/* A mapped ELF32 file, either endianness.  */
+typedef struct nanomips_elf {
+    const uint8_t *data;
+    size_t size;
+    int big_endian;
+    /* ET_REL, ET_EXEC or ET_DYN.  */
+    unsigned int type;
+    unsigned int num_sections;
+    /* Set by nanomips_elf_map, released by nanomips_elf_unmap.  */
+    void *mapping;
+} nanomips_elf;
+
+/* A section header.  */
+typedef struct nanomips_elf_section {
+    const char *name;
+    uint32_t type;
+    uint32_t flags;
+    uint32_t addr;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t link;
+    uint32_t info;
+    uint32_t entsize;
+} nanomips_elf_section;
+
+/* Map the file at PATH read-only.  Returns 0 on success.  */
+int nanomips_elf_map(nanomips_elf *elf, const char *path);
+
+/* Use the SIZE bytes at DATA, e.g. a file which is already in memory.
+   Returns 0 if they are an ELF32 file with sane section headers.  */
+int nanomips_elf_init(nanomips_elf *elf, const uint8_t *data, size_t size);
+
+void nanomips_elf_unmap(nanomips_elf *elf);
+
+/* Read section header INDEX.  Returns 0 on success.  */
+int nanomips_elf_section_at(const nanomips_elf *elf, unsigned int index, nanomips_elf_section *out);
+
+/* Fill BASES (num_sections entries) with the address each section is
+   loaded at.  That is sh_addr, except for relocatable objects, whose
+   allocated sections are all at 0 and get laid out one after the other.  */
+void nanomips_elf_layout(const nanomips_elf *elf, uint32_t *bases);
+
+/* Append the relocations of all REL and RELA sections to LIST, with the
+   sections loaded at BASES.  Returns the number appended, or (size_t) -1
+   if out of memory.  */
+size_t nanomips_elf_read_relocs(const nanomips_elf *elf, const uint32_t *bases, nanomips_reloc_list *list);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANOMIPS_RELOC_H */
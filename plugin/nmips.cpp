@@ -22,6 +22,7 @@
 #include "hexrays.hpp"
 #include "log.hpp"
 #include "mopt.hpp"
+#include "reloc_fixup.hpp"
 #include "nanomips-dis.h"
 #include <allins.hpp>
 #include <ua.hpp>
@@ -79,9 +80,10 @@ int ida_read_memory (bfd_vma memaddr,
 		    unsigned int length,
 		    struct disassemble_info *info)
 {
-    size_t nbytes = get_bytes(myaddr, length, memaddr);
+    segment_mirror_t* mirror = (segment_mirror_t*)info->application_data;
+    size_t nbytes = mirror->read(memaddr, myaddr, length);
     if (nbytes < length) {
-        ERR("Read %d, expected %d", nbytes, length);
+        DLOG("Read %d, expected %d", nbytes, length);
         return EIO;
     }
     return 0;
@@ -109,16 +111,10 @@ bool supported_machine()
 
 uint32 get_feature(insn_t& insn)
 {
-    nanomips_extra_inst_t inst = (nanomips_extra_inst_t)insn.itype;
-    auto it = nanomips_insn.find(inst);
-    if (it != nanomips_insn.end())
-    {
-        return it->second.features;
-    }
-
     if (insn.itype >= CUSTOM_INSN_ITYPE) {
         // Otherwise we would segfault!
-        return 0;
+        const nanomips_insn_t* info = get_nanomips_insn(insn.itype);
+        return info != nullptr ? info->features : 0;
     }
 
     return insn.get_canon_feature(PH);
@@ -130,17 +126,13 @@ const char *plugin_ctx_t::get_insn_mnem(const insn_t &insn)
 {
     if (insn.itype == nMIPS_todo)
     {
-        struct nanomips_opcode op = {};
-        nanomips_decoded_op operands[MAX_NUM_OPS] = {};
-        size_t insn_size = nanomips_disasm_instr(insn.ea, &disasm_info, &op, operands);
-        //LOG("Decoded instruction of size: %d", insn_size);
-
-        return op.name;
+        const struct nanomips_opcode* op = get_insn_opcode(insn);
+        return op != nullptr ? op->name : "unknown";
     }
 
-    auto it = nanomips_insn.find((nanomips_extra_inst_t)insn.itype);
-    if (it != nanomips_insn.end()) {
-        return it->second.mnemonic;
+    const nanomips_insn_t* info = get_nanomips_insn(insn.itype);
+    if (info != nullptr) {
+        return info->mnemonic;
     }
 
     return "unknown";
@@ -195,13 +187,13 @@ ssize_t idaapi plugin_ctx_t::on_event(ssize_t code, va_list va)
         int machine_type = va_arg(va, int);
         const char** p_procname = va_arg(va, const char**);
         proc_def_t** p_pd = va_arg(va, proc_def_t**);
-        LOG("loader_elf_machine(0x%x)", machine_type);
+        DLOG("loader_elf_machine(0x%x)", machine_type);
         if (machine_type == ELF_NANOMIPS) {
             LOG("nanoMIPS elf detected!");
             *p_procname = "mipsl";
             // LOG("loader_elf_machine(%p)", *p_pd);
             elf_mips_t* elf_mips = (elf_mips_t*)*p_pd;
-            elf_nmips = new elf_nanomips_t(elf_mips, relocations);
+            elf_nmips = new elf_nanomips_t(elf_mips, relocations, &reloc_index, &insn_index, decoder);
             *p_pd = elf_nmips;
             // Forcibly enable plugin
             enable_plugin(true);
@@ -281,26 +273,8 @@ ssize_t idaapi plugin_ctx_t::on_event(ssize_t code, va_list va)
             insn_t *insn = va_arg(va, insn_t *);
             if (insn->itype > nMIPS_todo)
             {
-                switch (insn->itype) {
-                case nMIPS_bltic:
-                case nMIPS_bltiuc:
-                case nMIPS_beqic:
-                case nMIPS_bgeic:
-                case nMIPS_bgeiuc:
-                case nMIPS_bneic:
-                case nMIPS_bltc:
-                case nMIPS_bltuc:
-                case nMIPS_bgec:
-                case nMIPS_bgeuc:
-                case nMIPS_beqc:
-                case nMIPS_bnec:
-                case nMIPS_bgezc:
-                case nMIPS_blezc:
-                    return 1;
-
-                default:
-                    return -1;
-                }
+                nanomips_branch_t branch = get_nanomips_branch(insn->itype);
+                return branch == nmips_branch_cmp || branch == nmips_branch_zero ? 1 : -1;
             }
         }
         break;
@@ -459,6 +433,7 @@ static plugmod_t *idaapi init()
     int argc = 0;
     if (log_file != nullptr)
         loguru::add_file(log_file, loguru::Truncate, loguru::Verbosity_MAX);
+    log_configure(get_plugin_options("nmips_log"));
     LOG("Logging to log file %s", log_file);
     // LOG("Assembler: %s", get_ph()->assemblers[0]->name);
 
@@ -491,8 +466,33 @@ plugin_ctx_t::plugin_ctx_t()
     disasm_info.mach = bfd_mach_nanomipsisa32r6;
 
     disasm_info.read_memory_func = ida_read_memory;
+    disasm_info.application_data = &mirror;
 
     disassemble_init_for_target(&disasm_info);
+    decoder.big_endian = disasm_info.endian == BFD_ENDIAN_BIG;
+    nanomips_init_dispatch();
+    build_opcode_itypes();
+    build_fill_plans();
+
+    int cache_bits = decode_cache_default_bits;
+    const char* options = get_plugin_options("nmips");
+    const char* cache_option = options != NULL ? strstr(options, "decode_cache_bits=") : NULL;
+    if (cache_option != NULL)
+    {
+        cache_bits = atoi(cache_option + strlen("decode_cache_bits="));
+        if (cache_bits < decode_cache_min_bits || cache_bits > decode_cache_max_bits)
+        {
+            WARN("decode_cache_bits must be between %d and %d, using %d", decode_cache_min_bits, decode_cache_max_bits, decode_cache_default_bits);
+            cache_bits = decode_cache_default_bits;
+        }
+    }
+    decode_cache.resize(cache_bits);
+
+    const char* threads_option = options != NULL ? strstr(options, "predecode_threads=") : NULL;
+    if (threads_option != NULL)
+    {
+        insn_index.threads = atoi(threads_option + strlen("predecode_threads="));
+    }
 }
 
 //--------------------------------------------------------------------------
@@ -504,6 +504,8 @@ plugin_ctx_t::~plugin_ctx_t()
     delete mgen;
     // listeners are uninstalled automatically
     // when the owner module is unloaded
+    // the flusher thread must not outlive the module either.
+    log_shutdown();
 }
 
 void plugin_ctx_t::ensure_mgen_installed()
@@ -573,6 +575,14 @@ void plugin_ctx_t::enable_plugin(bool enable)
 {
     if (enable) {
         relocations->enable_hooks(true);
+        mirror.enable_hooks(true);
+        reloc_index.enable_hooks(true);
+        decode_cache.enable_hooks(true);
+        insn_index.enable_hooks(true);
+        func_finder.enable_hooks(true);
+        switch_cache.enable_hooks(true);
+        fake_secondary_insn.enable_hooks(true);
+        register_reloc_fixups();
         // this is very hacky, but I think needed so that we can change the names everywhere :/
         size_t idx = 0;
         const char** reg_names = (const char**)PH.reg_names;
@@ -601,6 +611,14 @@ void plugin_ctx_t::enable_plugin(bool enable)
         // protect_data(reg_page, page_size()*2, false);
     } else {
         relocations->enable_hooks(false);
+        mirror.enable_hooks(false);
+        reloc_index.enable_hooks(false);
+        decode_cache.enable_hooks(false);
+        insn_index.enable_hooks(false);
+        func_finder.enable_hooks(false);
+        switch_cache.enable_hooks(false);
+        fake_secondary_insn.enable_hooks(false);
+        unregister_reloc_fixups();
         unregister_action("nmips:ConfigGDB");
     }
     hooked = enable;
@@ -614,6 +632,8 @@ void plugin_ctx_t::load_from_idb()
     bool enable = nec_node.altval(0);
     enable_plugin(enable);
     relocations->load_from_idb();
+    reloc_index.load_from_idb();
+    fake_secondary_insn.load_from_idb();
 }
 
 //--------------------------------------------------------------------------
@@ -10,6 +10,13 @@
 #include "mgen.hpp"
 #include "ins.hpp"
 #include "elf_ldr.hpp" 
+#include "mirror.hpp"
+#include "reloc_index.hpp"
+#include "decode_cache.hpp"
+#include "insn_index.hpp"
+#include "func_finder.hpp"
+#include "switch_cache.hpp"
+#include "fake_secondary.hpp"
 #include "gdb.hpp"
 
 uint32 get_feature(insn_t& inst);
@@ -28,6 +35,77 @@ struct insn_analysis_state_t
     void record_int(bfd_vma val);
 };
 
+/**
+ * @brief  Field of an op_t that receives a value computed from a decoded operand.
+ */
+enum fill_field_t : uint8
+{
+    fill_reg,
+    fill_value,
+    fill_addr,
+    fill_specval,
+};
+
+struct fill_write_t
+{
+    uint8 slot;
+    uint8 op;
+    uint8 field;
+};
+
+/**
+ * @brief  Precompiled conversion of one row of nanomips_opcodes to an insn_t.
+ * The itype, operand types and dtypes and everything post_process does to them only depend on the opcode,
+ * so they are worked out once and ana just copies ops and stores the operand values into the fields listed in writes.
+ */
+struct fill_plan_t
+{
+    uint16 itype = nMIPS_todo;
+    int16 flags = 0;
+
+    /**
+     * @brief  post_process still has to run after filling, because it adds a secondary instruction or combines values.
+     */
+    bool runtime_post = false;
+
+    /**
+     * @brief  Indices of the decoded operands producing values, each one fills one slot (two for register pairs).
+     */
+    uint8 num_operands = 0;
+    uint8 operands[MAX_NUM_OPS] = {};
+
+    uint8 num_writes = 0;
+    fill_write_t writes[3 * MAX_NUM_OPS] = {};
+
+    /**
+     * @brief  Number of ops that differ from the ones of a fresh insn_t and have to be copied.
+     */
+    uint8 num_ops = 0;
+    op_t ops[UA_MAXOP];
+};
+
+/**
+ * @brief  Remembers which row of nanomips_opcodes insn was decoded from.
+ * Stored as index + 1 in segpref / insnpref, which the mips module does not use for our instructions,
+ * so rendering and switch detection do not have to decode the instruction again.
+ */
+inline void set_insn_opcode(insn_t& insn, const struct nanomips_opcode& op)
+{
+    uint16 idx = (&op - nanomips_opcodes) + 1;
+    insn.segpref = (char)(idx & 0xff);
+    insn.insnpref = (char)(idx >> 8);
+}
+
+/**
+ * @brief  The row of nanomips_opcodes stored by set_insn_opcode, nullptr if insn was not decoded by ana (e.g. fake secondary instructions).
+ */
+inline const struct nanomips_opcode* get_insn_opcode(const insn_t& insn)
+{
+    uint16 idx = (uint8)insn.segpref | ((uint8)insn.insnpref << 8);
+    if (idx == 0 || idx > bfd_nanomips_num_opcodes) return nullptr;
+    return &nanomips_opcodes[idx - 1];
+}
+
 //--------------------------------------------------------------------------
 // Context data for the plugin. This object is created by the init()
 // function and hold all local data.
@@ -48,6 +126,11 @@ struct plugin_ctx_t : public plugmod_t, public event_listener_t
     */
     struct disassemble_info disasm_info = {};
 
+   /**
+    * @brief  Settings for nanomips_decode, never written while decoding so it can be shared between threads.
+    */
+    nanomips_decoder decoder = {};
+
     // state analyzing instruction.
     insn_analysis_state_t ana_state = {};
 
@@ -55,10 +138,39 @@ struct plugin_ctx_t : public plugmod_t, public event_listener_t
     large_stk_opt_t mopt;
     bool did_check_hexx = false;
 
-    std::map<ea_t, size_t> fake_jrc_insn;
     // some instructions combine two ordinary mips instructions.
     // if we encounter them, we write out the first to ida, and store the second here.
-    std::map<ea_t, insn_t> fake_secondary_insn;
+    fake_secondary_store_t fake_secondary_insn;
+
+   /**
+    * @brief  Copy of the code segments, so decoding does not have to go through get_bytes.
+    */
+    segment_mirror_t mirror;
+
+   /**
+    * @brief  Relocations the loader could not apply, the instructions covering them are decoded with INSN_HAS_RELOC.
+    */
+    reloc_index_t reloc_index;
+
+   /**
+    * @brief  Recently decoded instructions, shared by everything that decodes.
+    */
+    decode_cache_t decode_cache{mirror, decoder, reloc_index};
+
+   /**
+    * @brief  All instructions of the code segments, decoded in parallel once the ELF loader is done.
+    */
+    insn_index_t insn_index{decoder};
+
+   /**
+    * @brief  Function starts, found in one sweep over the code segments once the loader is done.
+    */
+    func_finder_t func_finder{decoder};
+
+   /**
+    * @brief  Answers of is_switch, most of them filled by a sweep for brsc tables once the loader is done.
+    */
+    switch_cache_t switch_cache{decoder};
 
     elf_nanomips_t* elf_nmips = nullptr;
     elf_nanomips_relocations_t* relocations = nullptr;
@@ -94,6 +206,15 @@ struct plugin_ctx_t : public plugmod_t, public event_listener_t
     // This function is called upon some events.
     virtual ssize_t idaapi on_event(ssize_t code, va_list va) override;
 
+   /**
+    * @brief  Decodes the instruction at ea, from the instruction index or going through the decode cache.
+    * @param  ea: Address of the instruction.
+    * @param  op: Set to the matching entry of nanomips_opcodes.
+    * @param  operands: Receives the decoded operands, needs MAX_NUM_OPS zeroed entries.
+    * @retval The size of the instruction in bytes, 0 if it could not be decoded.
+    */
+    size_t decode(ea_t ea, const struct nanomips_opcode** op, nanomips_decoded_op* operands);
+
    /**
     * @brief  Analyze the given instruction and fill it if we can disassemble the location.
     * @note   Can change insn.
@@ -104,30 +225,60 @@ struct plugin_ctx_t : public plugmod_t, public event_listener_t
 
    /**
     * @brief  Get the mnemonic for the given instruction.
-    * @note   If the type of the instruction is TODO, disassemble again, then just return the name as is.
+    * @note   If the type of the instruction is TODO, the name of the opcode ana stored in insn is returned as is.
     * @param  &insn: The instruction.
     * @retval Mnemonic of the instruction.
     */
     const char* get_insn_mnem(const insn_t &insn);
 
+   /**
+    * @brief  itype of every row of nanomips_opcodes, nMIPS_todo if we do not map it.
+    */
+    qvector<uint16> opcode_itypes;
+
+   /**
+    * @brief  Resolves opcode_mapping into opcode_itypes, so fill_opcode does not need any lookups.
+    */
+    void build_opcode_itypes();
+
    /**
     * @brief  Sets the opcode of insn based on the opcode decoded in op.
-    * @note   
+    * @note   op has to point into nanomips_opcodes.
     * @param  &insn: The instruction to fill.
     * @param  op: The opcode of the disassembled instruction.
     * @retval Whether we could correctly map the instruction.
     */
-    bool fill_opcode(insn_t &insn, struct nanomips_opcode& op);
+    bool fill_opcode(insn_t &insn, const struct nanomips_opcode& op);
+
+   /**
+    * @brief  Fill plan of every row of nanomips_opcodes.
+    */
+    qvector<fill_plan_t> fill_plans;
+
+   /**
+    * @brief  Compiles fill_plans from opcode_itypes and the operand types of every opcode.
+    * @note   Has to run after build_opcode_itypes.
+    */
+    void build_fill_plans();
+
+   /**
+    * @brief  Fills insn from a decoded instruction, using the fill plan of its opcode.
+    * @param  &insn: The instruction to fill.
+    * @param  op: The opcode of the disassembled instruction.
+    * @param  operands: The decoded operands.
+    * @param  size: The size of the decoded instruction.
+    * @retval The size of the instruction in bytes, as changed by post_process.
+    */
+    size_t fill_insn(insn_t &insn, const struct nanomips_opcode& op, const nanomips_decoded_op* operands, size_t size);
 
    /**
-    * @brief  Converts the given nanomips operand to an ida operand.
-    * @note   
-    * @param  &insn: The instruction where we want to store the result operand.
+    * @brief  Computes the value(s) the ida operand for the given nanomips operand holds.
+    * @param  opcode: The opcode of the disassembled instruction.
     * @param  op: The decoded operand.
-    * @param  idx: The idx of the operand in the instruction.
-    * @retval next operand index
+    * @param  out: Receives the value, or both registers of a register pair.
+    * @retval Number of values written.
     */
-    int fill_operand(insn_t &insn, struct nanomips_opcode& opcode, nanomips_decoded_op& op, int idx);
+    int operand_values(const struct nanomips_opcode& opcode, const nanomips_decoded_op& op, uval_t* out);
 
     void post_process(insn_t &insn);
 
@@ -143,7 +294,15 @@ struct plugin_ctx_t : public plugmod_t, public event_listener_t
 
     void ensure_mgen_installed();
 
-    insn_t* add_fake_secondary(insn_t& curr);
+   /**
+    * @brief  Splits off the last size - 1 bytes of curr into a secondary instruction at curr.ea + 1.
+    * @param  &curr: The combined instruction, its size is set to 1.
+    * @param  itype: itype of the secondary instruction.
+    * @param  optype: Type of the single operand of the secondary instruction.
+    * @param  dtype: dtype of that operand.
+    * @param  value: Register or address of that operand.
+    */
+    void add_fake_secondary(insn_t& curr, uint16 itype, optype_t optype, op_dtype_t dtype, ea_t value);
 
    /**
     * @brief  Enable / disable the plugin from working.
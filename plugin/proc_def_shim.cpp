@@ -1,3 +1,4 @@
+#define LOG_CATEGORY log_loader
 #include "elf_ldr.hpp"
 #include "elf/elf.h"
 #include "log.hpp"
@@ -0,0 +1,108 @@
+#define LOG_CATEGORY log_loader
+#include "reloc_fixup.hpp"
+#include "bytes.hpp"
+#include "log.hpp"
+#include "nanomips-reloc.h"
+
+/**
+ * @brief Custom fixup of a single relocation type, which its callbacks need to know.
+ */
+struct reloc_fixup_handler_t : public fixup_handler_t
+{
+    uint32 reloc_type;
+};
+
+static reloc_fixup_handler_t reloc_fixup_handlers[R_NANOMIPS_TLS_TPREL + 1];
+static fixup_type_t reloc_fixup_types[R_NANOMIPS_TLS_TPREL + 1];
+
+/**
+ * @brief Standard fixup of the relocation types that store S + A as data, 0 for all others.
+ */
+static fixup_type_t data_fixup_type(uint32 type)
+{
+    switch (type)
+    {
+    case R_NANOMIPS_32:
+    case R_NANOMIPS_RELATIVE:
+    case R_NANOMIPS_GLOBAL:
+    case R_NANOMIPS_JUMP_SLOT:
+        return FIXUP_OFF32;
+    case R_NANOMIPS_UNSIGNED_16:
+    case R_NANOMIPS_SIGNED_16:
+        return FIXUP_OFF16;
+    case R_NANOMIPS_UNSIGNED_8:
+    case R_NANOMIPS_SIGNED_8:
+        return FIXUP_OFF8;
+    default:
+        return 0;
+    }
+}
+
+static uval_t idaapi reloc_fixup_value(const fixup_handler_t* fh, ea_t ea)
+{
+    fixup_data_t fd;
+    if (!get_fixup(&fd, ea)) return BADADDR;
+    return fd.get_base() + fd.off;
+}
+
+static bool idaapi reloc_fixup_patch(const fixup_handler_t* fh, ea_t ea, const fixup_data_t& fd)
+{
+    uint32 type = ((const reloc_fixup_handler_t*)fh)->reloc_type;
+    uchar bytes[6];
+    unsigned int size = nanomips_reloc_size(type);
+    if (get_bytes(bytes, size, ea) != size) return false;
+
+    uint32 value = fd.get_base() + fd.off;
+    // gp moves along with everything else, so its distance to the target stays the same.
+    uint32 gp = nanomips_reloc_uses_gp(type) ? value - fd.displacement : NANOMIPS_RELOC_NO_GP;
+    if (nanomips_reloc_apply(inf_is_be(), type, bytes, size, ea, value, gp) != NANOMIPS_RELOC_OK)
+    {
+        WARN("[0x%x] %s: cannot move the target to 0x%x", ea, fh->name, value);
+        return false;
+    }
+    put_bytes(ea, bytes, size);
+    return true;
+}
+
+void register_reloc_fixups()
+{
+    for (uint32 type = 0; type < qnumber(reloc_fixup_handlers); type++)
+    {
+        unsigned int size = nanomips_reloc_size(type);
+        if (size == 0 || data_fixup_type(type) != 0 || reloc_fixup_types[type] != 0) continue;
+
+        reloc_fixup_handler_t& handler = reloc_fixup_handlers[type];
+        handler.cbsize = sizeof(fixup_handler_t);
+        handler.name = nanomips_reloc_name(type);
+        handler.props = FHF_CODE;
+        handler.size = size;
+        handler.width = 32;
+        handler.get_value = reloc_fixup_value;
+        handler.patch_value = reloc_fixup_patch;
+        handler.reloc_type = type;
+        reloc_fixup_types[type] = register_custom_fixup(&handler);
+    }
+}
+
+void unregister_reloc_fixups()
+{
+    for (auto& fixup_type : reloc_fixup_types)
+    {
+        if (fixup_type == 0) continue;
+        unregister_custom_fixup(fixup_type);
+        fixup_type = 0;
+    }
+}
+
+void set_reloc_fixup(ea_t ea, uint32 type, uint32 value, uint32 gp)
+{
+    fixup_type_t fixup_type = data_fixup_type(type);
+    if (fixup_type == 0 && type < qnumber(reloc_fixup_types)) fixup_type = reloc_fixup_types[type];
+    if (fixup_type == 0) return;
+
+    fixup_data_t fd(fixup_type);
+    fd.off = value;
+    fd.set_target_sel();
+    if (nanomips_reloc_uses_gp(type)) fd.displacement = value - gp;
+    fd.set(ea);
+}
@@ -0,0 +1,24 @@
+#ifndef __RELOC_FIXUP_H
+#define __RELOC_FIXUP_H
+
+#include <pro.h>
+#include <fixup.hpp>
+
+/**
+ * @brief Registers a custom fixup for every relocation type that patches an instruction.
+ * IDA only knows how to rebase plain data, these re-encode the instruction with the moved target instead.
+ * They have to be registered whenever the plugin is enabled, since fixups are found again by name when a database is loaded.
+ */
+void register_reloc_fixups();
+void unregister_reloc_fixups();
+
+/**
+ * @brief Records the fixup of a relocation the loader applied, so that rebasing adjusts it.
+ * @param ea Location of the relocation.
+ * @param type Relocation type.
+ * @param value S + A.
+ * @param gp Value of _gp, only used for GP relative types.
+ */
+void set_reloc_fixup(ea_t ea, uint32 type, uint32 value, uint32 gp);
+
+#endif /* __RELOC_FIXUP_H */
@@ -0,0 +1,210 @@
+#define LOG_CATEGORY log_loader
+#include "reloc_index.hpp"
+#include "log.hpp"
+#include <algorithm>
+
+static const char reloc_index_node_name[] = "$ nanoMIPS unapplied relocations";
+
+/**
+ * @brief Bumped whenever the stored format changes, older blobs are ignored.
+ */
+static const nodeidx_t reloc_index_version = 2;
+
+ssize_t reloc_index_t::on_event(ssize_t code, va_list va)
+{
+    switch (code) {
+    case idb_event::segm_deleted:
+    {
+        ea_t start_ea = va_arg(va, ea_t);
+        ea_t end_ea = va_arg(va, ea_t);
+        erase_range(start_ea, end_ea);
+    }
+    break;
+    case idb_event::segm_moved:
+    {
+        ea_t from = va_arg(va, ea_t);
+        ea_t to = va_arg(va, ea_t);
+        asize_t size = va_arg(va, asize_t);
+        move_range(from, to, size);
+    }
+    break;
+    case idb_event::allsegs_moved:
+    {
+        segm_move_infos_t* info = va_arg(va, segm_move_infos_t*);
+        move_segments(*info);
+    }
+    break;
+    case idb_event::savebase:
+    {
+        save_to_idb();
+    }
+    break;
+    case idb_event::auto_empty_finally:
+    {
+        log_stats();
+    }
+    break;
+    case idb_event::closebase:
+    {
+        clear();
+    }
+    break;
+    }
+    return 0;
+}
+
+void reloc_index_t::enable_hooks(bool enable)
+{
+    if (enable) {
+        hook_event_listener(HT_IDB, this, this);
+    } else {
+        unhook_event_listener(HT_IDB, this);
+    }
+}
+
+void reloc_index_t::add(ea_t ea)
+{
+    if (!addresses.empty() && addresses.back() >= ea) sorted = false;
+    addresses.push_back(ea);
+}
+
+void reloc_index_t::build()
+{
+    if (!sorted)
+    {
+        std::sort(addresses.begin(), addresses.end());
+        addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+        sorted = true;
+    }
+
+    pages.clear();
+    first_page = 0;
+    if (addresses.empty()) return;
+
+    first_page = addresses.front() >> reloc_index_page_bits;
+    ea_t num_pages = (addresses.back() >> reloc_index_page_bits) - first_page + 1;
+    pages.resize((num_pages + 63) / 64);
+    for (ea_t ea : addresses)
+    {
+        ea_t bit = (ea >> reloc_index_page_bits) - first_page;
+        pages[bit / 64] |= (uint64)1 << (bit % 64);
+    }
+}
+
+bool reloc_index_t::covers(ea_t start, ea_t end) const
+{
+    if (!may_cover(start, end)) return false;
+    auto it = std::lower_bound(addresses.begin(), addresses.end(), start);
+    return it != addresses.end() && *it < end;
+}
+
+void reloc_index_t::erase_range(ea_t start, ea_t end)
+{
+    auto first = std::lower_bound(addresses.begin(), addresses.end(), start);
+    auto last = std::lower_bound(first, addresses.end(), end);
+    // a deleted segment ends a rebase.
+    unmoved_addresses.clear();
+    pending_moves.clear();
+    if (first == last) return;
+    addresses.erase(first, last);
+    build();
+}
+
+void reloc_index_t::move_range(ea_t from, ea_t to, asize_t size)
+{
+    if (pending_moves.empty()) unmoved_addresses = addresses;
+    segm_move_info_t move;
+    move.from = from;
+    move.to = to;
+    move.size = size;
+    pending_moves.push_back(move);
+    remap(unmoved_addresses, pending_moves);
+}
+
+void reloc_index_t::move_segments(const segm_move_infos_t& moves)
+{
+    remap(pending_moves.empty() ? addresses : unmoved_addresses, moves);
+    unmoved_addresses.clear();
+    pending_moves.clear();
+}
+
+void reloc_index_t::remap(const qvector<ea_t>& old_addresses, const segm_move_infos_t& moves)
+{
+    // copied first, old_addresses may be addresses itself.
+    qvector<ea_t> moved = old_addresses;
+    for (ea_t& ea : moved)
+    {
+        for (const segm_move_info_t& move : moves)
+        {
+            if (ea >= move.from && ea - move.from < move.size)
+            {
+                ea = ea - move.from + move.to;
+                break;
+            }
+        }
+    }
+    addresses.swap(moved);
+    sorted = false;
+    build();
+}
+
+void reloc_index_t::clear()
+{
+    addresses.clear();
+    unmoved_addresses.clear();
+    pending_moves.clear();
+    pages.clear();
+    first_page = 0;
+    sorted = true;
+    hits = 0;
+}
+
+void reloc_index_t::save_to_idb()
+{
+    storage.create(reloc_index_node_name);
+    storage.altset(0, reloc_index_version);
+    storage.delblob(0, 'R');
+    if (addresses.empty()) return;
+
+    // always 64 bits per address, so the blob does not depend on the size of ea_t.
+    bytevec_t blob;
+    blob.resize(addresses.size() * sizeof(uint64));
+    for (size_t i = 0; i < addresses.size(); i++)
+    {
+        uint64 ea = addresses[i];
+        memcpy(&blob[i * sizeof(ea)], &ea, sizeof(ea));
+    }
+    storage.setblob(&blob[0], blob.size(), 0, 'R');
+}
+
+void reloc_index_t::load_from_idb()
+{
+    clear();
+    storage.create(reloc_index_node_name);
+    if (storage.altval(0) != reloc_index_version) return;
+
+    bytevec_t blob;
+    if (storage.getblob(&blob, 0, 'R') <= 0) return;
+    if (blob.size() % sizeof(uint64) != 0)
+    {
+        WARN("Ignoring unapplied relocations stored in the database, blob has unexpected size 0x%zx", blob.size());
+        return;
+    }
+
+    addresses.resize(blob.size() / sizeof(uint64));
+    for (size_t i = 0; i < addresses.size(); i++)
+    {
+        uint64 ea;
+        memcpy(&ea, &blob[i * sizeof(ea)], sizeof(ea));
+        addresses[i] = ea;
+    }
+    sorted = false;
+    build();
+    LOG("Loaded %zu unapplied relocations from the database", addresses.size());
+}
+
+void reloc_index_t::log_stats()
+{
+    LOG("unapplied relocations: %zu entries, %zu bitmap bytes, %llu instructions decoded with a relocation",
+        addresses.size(), pages.size() * sizeof(uint64), (unsigned long long)hits);
+}
@@ -0,0 +1,120 @@
+#ifndef __RELOC_INDEX_H
+#define __RELOC_INDEX_H
+
+#include <pro.h>
+#include <idp.hpp>
+#include <netnode.hpp>
+#include <segment.hpp>
+
+/**
+ * @brief log2 of the bytes covered by a single bit of the page bitmap.
+ */
+constexpr int reloc_index_page_bits = 12;
+
+/**
+ * @brief Sorted addresses of the relocations whose bytes the loader left alone, so they still hold the addend.
+ * That is everything the relocation engine could not apply, e.g. GOT and TLS relocations or values that did not fit.
+ * Instructions covering one of them have to be decoded with INSN_HAS_RELOC, like objdump does for relocatable objects:
+ * their PC-relative operands are not relative to the PC yet, and a zero branch offset is fine.
+ * A bitmap with one bit per page answers almost every lookup without searching the addresses.
+ * The addresses are persisted in the database, since the loader only runs once.
+ */
+struct reloc_index_t : public event_listener_t
+{
+public:
+    virtual ssize_t idaapi on_event(ssize_t code, va_list va) override;
+
+    void enable_hooks(bool enable);
+
+    /**
+     * @brief Adds the relocation at ea. Only takes effect after the next build().
+     * Used by the loader, which reports relocations in no particular order.
+     */
+    void add(ea_t ea);
+
+    /**
+     * @brief Sorts the addresses added since the last build and recreates the page bitmap.
+     */
+    void build();
+
+    /**
+     * @brief Whether a relocation might be in [start, end), which must not span more than two pages.
+     * Only looks at the page bitmap, so false is definite, but true has to be confirmed with covers().
+     */
+    bool may_cover(ea_t start, ea_t end) const
+    {
+        if (pages.empty() || start >= end) return false;
+        return page_set(start >> reloc_index_page_bits) || page_set((end - 1) >> reloc_index_page_bits);
+    }
+
+    /**
+     * @brief Whether a relocation is in [start, end).
+     */
+    bool covers(ea_t start, ea_t end) const;
+
+    /**
+     * @brief Removes all relocations in [start, end).
+     */
+    void erase_range(ea_t start, ea_t end);
+
+    /**
+     * @brief Called for every segm_moved, moves the relocations in [from, from + size) to to.
+     */
+    void move_range(ea_t from, ea_t to, asize_t size);
+
+    /**
+     * @brief Called for allsegs_moved once the program was rebased, moves the relocations of every segment in moves.
+     */
+    void move_segments(const segm_move_infos_t& moves);
+
+    void clear();
+
+    void save_to_idb();
+    void load_from_idb();
+
+    /**
+     * @brief Logs the number of relocations and how many instructions were decoded with them.
+     */
+    void log_stats();
+
+    /**
+     * @brief Lookups that found a relocation.
+     */
+    uint64 hits = 0;
+
+private:
+    bool page_set(ea_t page) const
+    {
+        ea_t bit = page - first_page;
+        return page >= first_page && bit < (ea_t)pages.size() * 64 && (pages[bit / 64] & ((uint64)1 << (bit % 64))) != 0;
+    }
+
+    /**
+     * @brief Replaces addresses with old_addresses, each moved by the first of moves whose source contains it.
+     */
+    void remap(const qvector<ea_t>& old_addresses, const segm_move_infos_t& moves);
+
+    /**
+     * @brief Sorted and unique after build().
+     */
+    qvector<ea_t> addresses;
+
+    /**
+     * @brief The addresses before the first segm_moved since the last allsegs_moved, and the segments moved since.
+     * A rebase reports every segment once they all moved, so the old place of one segment can already hold
+     * the relocations of another. Moves are therefore always applied to the addresses from before the rebase.
+     */
+    qvector<ea_t> unmoved_addresses;
+    segm_move_infos_t pending_moves;
+
+    /**
+     * @brief Bit i is set if a relocation is in page first_page + i.
+     */
+    qvector<uint64> pages;
+    ea_t first_page = 0;
+
+    bool sorted = true;
+    netnode storage;
+};
+
+#endif /* __RELOC_INDEX_H */
@@ -0,0 +1,272 @@
+#define LOG_CATEGORY log_analysis
+#include "switch_cache.hpp"
+#include "bytes.hpp"
+#include "log.hpp"
+#include "segment.hpp"
+#include <algorithm>
+#include <chrono>
+
+/**
+ * @brief The part an instruction can play in a switch.
+ */
+enum switch_insn_kind_t : uint8
+{
+    switch_insn_other = 0,
+    // bgeiuc rA, #ncases, default
+    switch_insn_bounds,
+    // lapc rT, table
+    switch_insn_table,
+    // lwxs / lhuxs / lbux rB, rA(rT)
+    switch_insn_load_word,
+    switch_insn_load_half,
+    switch_insn_load_byte,
+    // brsc rB
+    switch_insn_jump,
+};
+
+/**
+ * @brief Register number or integer value of a decoded operand.
+ */
+static uint32 operand_value(const nanomips_decoded_op& op)
+{
+    switch (op.op->type)
+    {
+    case OP_REG:
+        return nanomips_decode_reg_operand((const struct nanomips_reg_operand*)op.op, op.val);
+    case OP_INT:
+        return nanomips_decode_int_operand((const struct nanomips_int_operand*)op.op, op.val);
+    default:
+        return op.val;
+    }
+}
+
+ssize_t switch_cache_t::on_event(ssize_t code, va_list va)
+{
+    switch (code) {
+    case idb_event::byte_patched:
+    {
+        ea_t ea = va_arg(va, ea_t);
+        invalidate(ea, ea + 1);
+    }
+    break;
+    // the jump pattern follows the flow backwards, which only exists once the code before the brsc was created.
+    case idb_event::make_code:
+    {
+        const insn_t* insn = va_arg(va, const insn_t*);
+        invalidate(insn->ea, insn->ea + insn->size, true);
+    }
+    break;
+    case idb_event::destroyed_items:
+    {
+        ea_t ea1 = va_arg(va, ea_t);
+        ea_t ea2 = va_arg(va, ea_t);
+        invalidate(ea1, ea2);
+    }
+    break;
+    // after the loader, so the table addresses have been relocated.
+    case idb_event::loader_finished:
+    {
+        scan();
+    }
+    break;
+    case idb_event::auto_empty_finally:
+    {
+        log_stats();
+    }
+    break;
+    case idb_event::segm_deleted:
+    case idb_event::segm_start_changed:
+    case idb_event::segm_end_changed:
+    case idb_event::segm_moved:
+    case idb_event::allsegs_moved:
+    case idb_event::closebase:
+    {
+        clear();
+    }
+    break;
+    }
+    return 0;
+}
+
+void switch_cache_t::enable_hooks(bool enable)
+{
+    if (enable) {
+        hook_event_listener(HT_IDB, this, this);
+    } else {
+        unhook_event_listener(HT_IDB, this);
+        clear();
+    }
+}
+
+const switch_cache_entry_t* switch_cache_t::find(ea_t ea)
+{
+    auto it = entries.find(ea);
+    if (it == entries.end())
+    {
+        misses++;
+        return nullptr;
+    }
+    hits++;
+    return &it->second;
+}
+
+void switch_cache_t::add(ea_t ea, const switch_info_t* si)
+{
+    switch_cache_entry_t& entry = entries[ea];
+    entry.window_start = ea > switch_window_bytes ? ea - switch_window_bytes : 0;
+    entry.is_switch = si != nullptr;
+    if (si != nullptr)
+    {
+        entry.si = *si;
+        if (si->startea != BADADDR && si->startea < entry.window_start) entry.window_start = si->startea;
+    }
+    max_window = std::max(max_window, ea - entry.window_start);
+}
+
+void switch_cache_t::invalidate(ea_t start, ea_t end, bool negative_only)
+{
+    if (entries.empty() || start >= end) return;
+
+    // brsc is 4 bytes, so only entries from start - 3 on can cover start.
+    auto it = entries.lower_bound(start > 3 ? start - 3 : 0);
+    while (it != entries.end() && it->first < end + max_window)
+    {
+        if (it->second.window_start >= end || (negative_only && it->second.is_switch))
+        {
+            ++it;
+            continue;
+        }
+        it = entries.erase(it);
+        invalidated++;
+    }
+}
+
+size_t switch_cache_t::scan()
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t count = 0;
+    bytevec_t bytes;
+    int qty = get_segm_qty();
+    for (int i = 0; i < qty; i++)
+    {
+        segment_t* seg = getnseg(i);
+        if (seg == NULL) continue;
+        if ((seg->perm & SEGPERM_EXEC) == 0 && seg->type != SEG_CODE) continue;
+
+        bytes.resize(seg->size());
+        ssize_t nbytes = get_bytes(&bytes[0], seg->size(), seg->start_ea);
+        if (nbytes < 2) continue;
+        count += scan_segment(seg->start_ea, &bytes[0], nbytes);
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG("Found %zu switch tables in %.1f ms", count, ms);
+    return count;
+}
+
+size_t switch_cache_t::scan_segment(ea_t start_ea, const uchar* bytes, size_t size)
+{
+    if (kinds.empty())
+    {
+        kinds.resize(bfd_nanomips_num_opcodes);
+        for (int i = 0; i < bfd_nanomips_num_opcodes; i++)
+        {
+            const char* name = nanomips_opcodes[i].name;
+            if (strcmp(name, "bgeiuc") == 0) kinds[i] = switch_insn_bounds;
+            else if (strcmp(name, "lapc") == 0) kinds[i] = switch_insn_table;
+            else if (strcmp(name, "lwxs") == 0) kinds[i] = switch_insn_load_word;
+            else if (strcmp(name, "lhuxs") == 0) kinds[i] = switch_insn_load_half;
+            else if (strcmp(name, "lbux") == 0) kinds[i] = switch_insn_load_byte;
+            else if (strcmp(name, "brsc") == 0) kinds[i] = switch_insn_jump;
+        }
+    }
+
+    nanomips_insn_stream stream;
+    nanomips_stream_init(&stream);
+    if (nanomips_decode_range(&decoder, bytes, size, start_ea, &stream) == (size_t)-1)
+    {
+        ERR("Out of memory sweeping 0x%x for switch tables", start_ea);
+        nanomips_stream_free(&stream);
+        return 0;
+    }
+
+    auto kind = [&](size_t slot) -> uint8 {
+        uint16 opcode = stream.opcode[slot];
+        return opcode == NANOMIPS_STREAM_INVALID ? switch_insn_other : kinds[opcode];
+    };
+
+    size_t count = 0;
+    nanomips_decoded_op jump[NANOMIPS_STREAM_MAX_OPS] = {};
+    nanomips_decoded_op load[NANOMIPS_STREAM_MAX_OPS] = {};
+    nanomips_decoded_op table[NANOMIPS_STREAM_MAX_OPS] = {};
+    nanomips_decoded_op bounds[NANOMIPS_STREAM_MAX_OPS] = {};
+    for (size_t i = 2; i < stream.count; i++)
+    {
+        if (kind(i) != switch_insn_jump) continue;
+
+        // lapc, the load and brsc are always next to each other.
+        int elsize;
+        switch (kind(i - 1))
+        {
+        case switch_insn_load_word: elsize = 4; break;
+        case switch_insn_load_half: elsize = 2; break;
+        case switch_insn_load_byte: elsize = 1; break;
+        default: continue;
+        }
+        if (kind(i - 2) != switch_insn_table || stream.target[i - 2] == NANOMIPS_NO_TARGET) continue;
+
+        nanomips_stream_operands(&stream, i, jump);
+        nanomips_stream_operands(&stream, i - 1, load);
+        nanomips_stream_operands(&stream, i - 2, table);
+        uint32 index_reg = operand_value(load[1]);
+        if (operand_value(load[0]) != operand_value(jump[0]) || operand_value(load[2]) != operand_value(table[0])) continue;
+
+        // the compiler can schedule other instructions between the bounds check and lapc.
+        ea_t jump_ea = start_ea + stream.offset[i];
+        size_t bounds_slot = i - 2;
+        while (bounds_slot > 0 && jump_ea - (start_ea + stream.offset[bounds_slot - 1]) <= switch_window_bytes)
+        {
+            bounds_slot--;
+            if (kind(bounds_slot) == switch_insn_bounds) break;
+        }
+        if (kind(bounds_slot) != switch_insn_bounds || stream.target[bounds_slot] == NANOMIPS_NO_TARGET) continue;
+        nanomips_stream_operands(&stream, bounds_slot, bounds);
+        if (operand_value(bounds[0]) != index_reg) continue;
+
+        uint32 ncases = operand_value(bounds[1]);
+        ea_t jumps = stream.target[i - 2];
+        if (ncases == 0 || getseg(jumps) == NULL) continue;
+
+        // the same as nmips_jump_pattern_t produces.
+        switch_info_t si;
+        si.flags |= SWI_ELBASE;
+        si.set_jtable_element_size(elsize);
+        si.set_jtable_size(ncases);
+        si.defjump = stream.target[bounds_slot];
+        si.jumps = jumps;
+        si.elbase = jump_ea + stream.length[i];
+        si.set_shift(1);
+        si.regnum = index_reg;
+        si.regdtype = dt_dword;
+        si.startea = start_ea + stream.offset[bounds_slot];
+        add(jump_ea, &si);
+        count++;
+    }
+    nanomips_stream_free(&stream);
+    num_scanned += count;
+    return count;
+}
+
+void switch_cache_t::clear()
+{
+    entries.clear();
+    max_window = switch_window_bytes;
+}
+
+void switch_cache_t::log_stats()
+{
+    uint64 total = hits + misses;
+    LOG("switch cache: %llu hits, %llu misses, %.1f%% hit rate, %llu invalidated, %zu entries, %llu tables from the sweep",
+        (unsigned long long)hits, (unsigned long long)misses, total ? 100.0 * hits / total : 0.0,
+        (unsigned long long)invalidated, entries.size(), (unsigned long long)num_scanned);
+}
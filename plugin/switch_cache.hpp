@@ -0,0 +1,100 @@
+#ifndef __SWITCH_CACHE_H
+#define __SWITCH_CACHE_H
+
+#include <pro.h>
+#include <idp.hpp>
+#include <jumptable.hpp>
+#include <map>
+#include "nanomips-dis.h"
+
+/**
+ * @brief Number of bytes before a brsc that the switch pattern looks at.
+ * Bounds the window of every cached answer, and how far back the sweep looks for the bgeiuc.
+ */
+constexpr ea_t switch_window_bytes = 64;
+
+/**
+ * @brief Answer of is_switch for a single brsc.
+ */
+struct switch_cache_entry_t
+{
+    /**
+     * @brief First byte of the instructions the answer depends on, from there up to the brsc.
+     */
+    ea_t window_start = BADADDR;
+    bool is_switch = false;
+    switch_info_t si;
+};
+
+/**
+ * @brief Answers of is_switch, which IDA asks again for the same brsc every time it is reanalyzed.
+ * Negative answers are kept as well, and every answer is dropped once an instruction in its window changes.
+ * Tables of the usual bgeiuc, lapc, lwxs / lhuxs / lbux, brsc sequence are all resolved in one sweep once the loader is done,
+ * so those never have to go through the jump pattern.
+ */
+struct switch_cache_t : public event_listener_t
+{
+public:
+    switch_cache_t(const nanomips_decoder& decoder) : decoder(decoder) {};
+
+    virtual ssize_t idaapi on_event(ssize_t code, va_list va) override;
+
+    void enable_hooks(bool enable);
+
+    /**
+     * @brief The cached answer for the brsc at ea, nullptr if it has to be computed.
+     */
+    const switch_cache_entry_t* find(ea_t ea);
+
+    /**
+     * @brief Remembers the answer for the brsc at ea.
+     * @param si The switch, nullptr if ea is not one.
+     */
+    void add(ea_t ea, const switch_info_t* si);
+
+    /**
+     * @brief Sweeps all executable segments and caches every switch table found.
+     * @return The number of switches found.
+     */
+    size_t scan();
+
+    /**
+     * @brief Sweeps the size bytes located at start_ea and caches the switch tables in there.
+     * @return The number of switches found.
+     */
+    size_t scan_segment(ea_t start_ea, const uchar* bytes, size_t size);
+
+    /**
+     * @brief Drops all answers that depend on a byte in [start, end).
+     * @param negative_only Only drop the brsc that are not switches, e.g. when new code was created.
+     */
+    void invalidate(ea_t start, ea_t end, bool negative_only = false);
+
+    void clear();
+
+    /**
+     * @brief Logs the hit / miss counters and the number of switches found by the sweep.
+     */
+    void log_stats();
+
+    uint64 hits = 0;
+    uint64 misses = 0;
+    uint64 invalidated = 0;
+    uint64 num_scanned = 0;
+
+private:
+    const nanomips_decoder& decoder;
+    std::map<ea_t, switch_cache_entry_t> entries;
+
+    /**
+     * @brief Longest window of any entry, the bgeiuc found by the jump pattern can be further back than switch_window_bytes.
+     */
+    ea_t max_window = switch_window_bytes;
+
+    /**
+     * @brief switch_insn_kind_t of every entry of nanomips_opcodes.
+     */
+    qvector<uint8> kinds;
+};
+
+#endif /* __SWITCH_CACHE_H */
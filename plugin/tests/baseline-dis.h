@@ -0,0 +1,13 @@
+#ifndef __BASELINE_DIS_H
+#define __BASELINE_DIS_H
+
+#include "nanomips-dis.h"
+
+/* nanomips_disasm_instr and nanomips_disasm_operands as they were before
+   the dispatch index, see baseline-dis.c.  */
+size_t baseline_disasm_instr(bfd_vma memaddr_base, disassemble_info *info, struct nanomips_opcode *out_op, nanomips_decoded_op* out_operands);
+void baseline_disasm_operands (struct disassemble_info *info,
+		 const struct nanomips_opcode *opcode,
+		 bfd_uint64_t insn, bfd_vma insn_pc, unsigned int length, nanomips_decoded_op* out_operands);
+
+#endif /* __BASELINE_DIS_H */
@@ -0,0 +1,188 @@
+/* Decodes the executable sections of an ELF file through every decoder
+   entry point and checks that they agree: nanomips_decode_range and its
+   expanded operands, nanomips_decode, and nanomips_disasm_instr reading
+   through disassemble_info.  With an expected hash, also checks the
+   mnemonics and operand values of the whole linear sweep against it, so
+   any change to what the bundled babymips decodes to is noticed.
+
+   usage: nmips_decode_test elf file [expected hash]  */
+
+#include "nanomips-dis.h"
+#include "test_elf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SECTIONS 16
+#define MAX_REPORTS 10
+
+static const uint8_t *memory;
+static size_t memory_size;
+static bfd_vma memory_base;
+static size_t failures;
+
+static int
+read_memory (bfd_vma addr, bfd_byte *out, unsigned int length, struct disassemble_info *info)
+{
+    if (addr < memory_base || addr - memory_base + length > memory_size)
+        return 5;
+    memcpy (out, memory + (addr - memory_base), length);
+    return 0;
+}
+
+static void
+memory_error (int status, bfd_vma addr, struct disassemble_info *info)
+{
+}
+
+static int
+ignore_printf (void *stream, const char *format, ...)
+{
+    return 0;
+}
+
+static void
+fail (bfd_vma pc, const char *what)
+{
+    if (failures++ < MAX_REPORTS)
+        printf ("0x%08lx: %s\n", (unsigned long) pc, what);
+}
+
+static int
+same_operands (const nanomips_decoded_op *a, const nanomips_decoded_op *b, unsigned int count)
+{
+    unsigned int i;
+
+    for (i = 0; i < count; i++)
+        if (a[i].op != b[i].op || a[i].val != b[i].val || a[i].base_pc != b[i].base_pc)
+            return 0;
+    return 1;
+}
+
+/* FNV-1a, over the mnemonic and operand values of every instruction.  */
+static uint64_t
+hash_bytes (uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    size_t i;
+
+    for (i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    return hash;
+}
+
+static uint64_t
+check_section (const struct test_section *section, const nanomips_decoder *decoder, disassemble_info *info,
+               nanomips_insn_stream *stream, uint64_t hash)
+{
+    size_t i;
+
+    memory = section->bytes;
+    memory_size = section->size;
+    memory_base = section->addr;
+    if (nanomips_decode_range (decoder, section->bytes, section->size, section->addr, stream) == (size_t) -1)
+    {
+        fail (section->addr, "out of memory");
+        return hash;
+    }
+
+    for (i = 0; i < stream->count; i++)
+    {
+        nanomips_decoded_op streamed[NANOMIPS_STREAM_MAX_OPS] = { 0 };
+        nanomips_decoded_op expanded[NANOMIPS_STREAM_MAX_OPS] = { 0 };
+        nanomips_decoded_op decoded[NANOMIPS_STREAM_MAX_OPS] = { 0 };
+        nanomips_decoded_op disassembled[NANOMIPS_STREAM_MAX_OPS] = { 0 };
+        struct nanomips_opcode disassembled_op = { 0 };
+        nanomips_decode_result result;
+        uint32_t offset = stream->offset[i];
+        bfd_vma pc = section->addr + offset;
+        const struct nanomips_opcode *op;
+        unsigned int count;
+        size_t length;
+
+        length = nanomips_decode (decoder, section->bytes + offset, section->size - offset, pc, 0, &result,
+                                  decoded);
+        if (stream->opcode[i] == NANOMIPS_STREAM_INVALID)
+        {
+            if (length != 0)
+                fail (pc, "nanomips_decode decodes a halfword the stream does not");
+            hash = hash_bytes (hash, "?", 1);
+            continue;
+        }
+
+        op = &nanomips_opcodes[stream->opcode[i]];
+        if (length != stream->length[i] || result.op != op)
+        {
+            fail (pc, "nanomips_decode and the stream decode different instructions");
+            continue;
+        }
+        if (result.target != stream->target[i])
+            fail (pc, "nanomips_decode and the stream have different targets");
+
+        count = nanomips_num_operands (op);
+        if (nanomips_stream_operands (stream, i, streamed) != count || !same_operands (streamed, decoded, count))
+            fail (pc, "stream operands differ from nanomips_decode");
+        if (nanomips_expand_operands (op, stream->vals + stream->vals_start[i], pc, length, expanded) != count
+            || !same_operands (expanded, decoded, count))
+            fail (pc, "expanded operands differ from nanomips_decode");
+
+        if (nanomips_disasm_instr (pc, info, &disassembled_op, disassembled) != length
+            || strcmp (disassembled_op.name, op->name) != 0 || disassembled_op.match != op->match
+            || !same_operands (disassembled, decoded, count) || info->insn_type != result.insn_type)
+            fail (pc, "nanomips_disasm_instr differs from nanomips_decode");
+
+        hash = hash_bytes (hash, op->name, strlen (op->name) + 1);
+        hash = hash_bytes (hash, &stream->length[i], 1);
+        for (count = 0; count < nanomips_num_operands (op); count++)
+            hash = hash_bytes (hash, &decoded[count].val, sizeof (decoded[count].val));
+    }
+    return hash;
+}
+
+int
+main (int argc, char **argv)
+{
+    struct test_section sections[MAX_SECTIONS];
+    nanomips_decoder decoder = { 0 };
+    nanomips_insn_stream stream;
+    disassemble_info info;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    size_t size, num_sections, s;
+    uint8_t *file;
+
+    if (argc < 2)
+    {
+        fprintf (stderr, "usage: %s elf file [expected hash]\n", argv[0]);
+        return 2;
+    }
+    file = test_read_file (argv[1], &size);
+    if (file == NULL)
+        return 1;
+    num_sections = test_find_sections (file, size, sections, MAX_SECTIONS);
+    if (num_sections == 0)
+    {
+        fprintf (stderr, "%s has no executable sections\n", argv[1]);
+        return 1;
+    }
+
+    init_disassemble_info (&info, NULL, ignore_printf);
+    info.arch = bfd_arch_nanomips;
+    info.endian = BFD_ENDIAN_LITTLE;
+    info.read_memory_func = read_memory;
+    info.memory_error_func = memory_error;
+
+    nanomips_init_dispatch ();
+    nanomips_stream_init (&stream);
+    for (s = 0; s < num_sections; s++)
+        hash = check_section (&sections[s], &decoder, &info, &stream, hash);
+    nanomips_stream_free (&stream);
+    free (file);
+
+    printf ("%s: %zu mismatches, hash 0x%016llx\n", argv[1], failures, (unsigned long long) hash);
+    if (argc > 2 && strtoull (argv[2], NULL, 16) != hash)
+    {
+        printf ("expected hash %s\n", argv[2]);
+        return 1;
+    }
+    return failures != 0;
+}
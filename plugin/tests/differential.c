@@ -0,0 +1,75 @@
+#include "differential.h"
+#include "baseline-dis.h"
+#include <stdio.h>
+
+#define MAX_REPORTS 10
+
+size_t differential_compared;
+size_t differential_mismatches;
+
+static const uint8_t *memory;
+static size_t memory_size;
+static bfd_vma memory_base;
+
+static int
+read_memory (bfd_vma addr, bfd_byte *out, unsigned int length, struct disassemble_info *info)
+{
+    if (addr < memory_base || addr - memory_base + length > memory_size)
+        return 5;
+    memcpy (out, memory + (addr - memory_base), length);
+    return 0;
+}
+
+static void
+memory_error (int status, bfd_vma addr, struct disassemble_info *info)
+{
+}
+
+static int
+ignore_printf (void *stream, const char *format, ...)
+{
+    return 0;
+}
+
+static void
+init_info (disassemble_info *info, unsigned int flags)
+{
+    init_disassemble_info (info, NULL, ignore_printf);
+    info->arch = bfd_arch_nanomips;
+    info->endian = BFD_ENDIAN_LITTLE;
+    info->read_memory_func = read_memory;
+    info->memory_error_func = memory_error;
+    info->flags = flags;
+}
+
+int
+differential_check (const uint8_t *bytes, size_t size, bfd_vma base, bfd_vma pc, unsigned int flags)
+{
+    struct nanomips_opcode baseline_op = { 0 }, op = { 0 };
+    nanomips_decoded_op baseline_operands[NANOMIPS_STREAM_MAX_OPS] = { 0 };
+    nanomips_decoded_op operands[NANOMIPS_STREAM_MAX_OPS] = { 0 };
+    disassemble_info baseline_info, info;
+    size_t baseline_length, length;
+
+    memory = bytes;
+    memory_size = size;
+    memory_base = base;
+    init_info (&baseline_info, flags);
+    init_info (&info, flags);
+
+    baseline_length = baseline_disasm_instr (pc, &baseline_info, &baseline_op, baseline_operands);
+    length = nanomips_disasm_instr (pc, &info, &op, operands);
+    differential_compared++;
+    /* Neither could read the instruction, nothing else is set then.  */
+    if (baseline_length == (size_t) -1 && length == (size_t) -1)
+        return 1;
+    if (baseline_length == length && memcmp (&baseline_op, &op, sizeof (op)) == 0
+        && memcmp (baseline_operands, operands, sizeof (operands)) == 0 && baseline_info.insn_type == info.insn_type)
+        return 1;
+
+    if (differential_mismatches++ < MAX_REPORTS)
+        printf ("0x%08lx%s: baseline %s (%ld bytes), now %s (%ld bytes)\n", (unsigned long) pc,
+                (flags & INSN_HAS_RELOC) != 0 ? " with relocation" : "", baseline_op.name ? baseline_op.name : "-",
+                (long) baseline_length, op.name ? op.name : "-", (long) length);
+    return 0;
+}
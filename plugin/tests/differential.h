@@ -0,0 +1,18 @@
+/* Compares nanomips_disasm_instr with the baseline scan in baseline-dis.c.  */
+
+#ifndef __DIFFERENTIAL_H
+#define __DIFFERENTIAL_H
+
+#include "nanomips-dis.h"
+
+/* Number of instructions compared and how many of them differed.  */
+extern size_t differential_compared;
+extern size_t differential_mismatches;
+
+/* Decode the instruction at PC with both decoders, reading from the SIZE
+   bytes at BYTES, which live at BASE.  FLAGS may contain INSN_HAS_RELOC.
+   The length, opcode row, operands and insn_type all have to agree, the
+   first few mismatches are printed.  Returns 1 if they do.  */
+int differential_check (const uint8_t *bytes, size_t size, bfd_vma base, bfd_vma pc, unsigned int flags);
+
+#endif /* __DIFFERENTIAL_H */
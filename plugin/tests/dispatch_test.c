@@ -0,0 +1,63 @@
+/* Differential test of the dispatch index in nanomips_disasm_instr against
+   the linear scan it replaced.  Every halfword offset of the given file is
+   decoded, code or not, both with and without INSN_HAS_RELOC, followed by
+   random buffers of 6 bytes.
+
+   usage: nmips_dispatch_test file [random buffers]  */
+
+#include "differential.h"
+#include "test_elf.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FILE_BASE 0x400000
+#define RANDOM_BASE 0x1000
+
+/* xorshift64, so every platform tries the same buffers.  */
+static uint64_t
+next_random (uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+int
+main (int argc, char **argv)
+{
+    static const unsigned int flags[] = { 0, INSN_HAS_RELOC };
+    long buffers = argc > 2 ? atol (argv[2]) : 1000000;
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+    uint8_t buf[6];
+    size_t size, offset, f;
+    uint8_t *file;
+    long r;
+
+    if (argc < 2)
+    {
+        fprintf (stderr, "usage: %s file [random buffers]\n", argv[0]);
+        return 2;
+    }
+    file = test_read_file (argv[1], &size);
+    if (file == NULL)
+        return 1;
+
+    nanomips_init_dispatch ();
+    for (f = 0; f < sizeof (flags) / sizeof (flags[0]); f++)
+    {
+        for (offset = 0; offset + 2 <= size; offset += 2)
+            differential_check (file, size, FILE_BASE, FILE_BASE + offset, flags[f]);
+
+        for (r = 0; r < buffers; r++)
+        {
+            uint64_t bits = next_random (&state);
+            memcpy (buf, &bits, sizeof (buf));
+            differential_check (buf, sizeof (buf), RANDOM_BASE, RANDOM_BASE, flags[f]);
+        }
+    }
+    free (file);
+
+    printf ("%zu instructions compared, %zu mismatches\n", differential_compared, differential_mismatches);
+    return differential_mismatches != 0;
+}
@@ -0,0 +1,85 @@
+// Checks that the instruction index stops serving instructions whose bytes changed while a process was debugged.
+// Memory snapshots write the database without any events, so the index only finds out when the process is gone.
+// Links against the SDK stand-in in bench/sdk, like the analysis benchmark.
+//
+// usage: nmips_insn_index_test [elf file]
+
+#include "nmips.hpp"
+#include "log.hpp"
+#include "dbg.hpp"
+#include "standin_db.hpp"
+#include <stdio.h>
+
+/**
+ * @brief Address of the first instruction the index has in seg at or after ea, BADADDR if there is none.
+ */
+static ea_t find_indexed(plugin_ctx_t* ctx, segment_t* seg, ea_t ea)
+{
+    for (; ea + 2 <= seg->end_ea; ea += 2)
+    {
+        const struct nanomips_opcode* op = nullptr;
+        nanomips_decoded_op operands[MAX_NUM_OPS] = {};
+        size_t size = 0;
+        if (ctx->insn_index.lookup(ea, &op, operands, &size) && size != 0) return ea;
+    }
+    return BADADDR;
+}
+
+static bool indexed(plugin_ctx_t* ctx, ea_t ea)
+{
+    const struct nanomips_opcode* op = nullptr;
+    nanomips_decoded_op operands[MAX_NUM_OPS] = {};
+    size_t size = 0;
+    return ctx->insn_index.lookup(ea, &op, operands, &size);
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = argc > 1 ? argv[1] : "babymips";
+    loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+
+    if (!standin_load_elf(path))
+    {
+        fprintf(stderr, "cannot load %s\n", path);
+        return 1;
+    }
+
+    plugin_ctx_t* ctx = new plugin_ctx_t;
+    ctx->insn_index.build();
+
+    // the instruction that is changed, and one in another segment, which has to stay indexed.
+    ea_t ea = BADADDR, other = BADADDR;
+    for (int i = 0; i < get_segm_qty() && other == BADADDR; i++)
+    {
+        segment_t* seg = getnseg(i);
+        if ((seg->perm & SEGPERM_EXEC) == 0) continue;
+        if (ea == BADADDR) ea = find_indexed(ctx, seg, seg->start_ea);
+        else other = find_indexed(ctx, seg, seg->start_ea);
+    }
+    if (ea == BADADDR)
+    {
+        fprintf(stderr, "%s has no indexed instructions\n", path);
+        return 1;
+    }
+
+    int failures = 0;
+    auto check = [&](const char* what, bool ok) {
+        printf("%-48s %s\n", what, ok ? "ok" : "FAILED");
+        if (!ok) failures++;
+    };
+
+    uchar bytes[2];
+    get_bytes(bytes, sizeof(bytes), ea);
+    bytes[0] ^= 0xFF;
+    bytes[1] ^= 0xFF;
+
+    standin_notify(HT_DBG, dbg_process_start);
+    put_bytes(ea, bytes, sizeof(bytes));
+    check("indexed while debugging, before the process exits", indexed(ctx, ea));
+    standin_notify(HT_DBG, dbg_process_exit);
+    check("not indexed after the process exited", !indexed(ctx, ea));
+    if (other != BADADDR) check("other segments still indexed", indexed(ctx, other));
+
+    delete ctx;
+    return failures != 0;
+}
@@ -0,0 +1,49 @@
+// Checks that resolving opcode_mapping into plugin_ctx_t::opcode_itypes changed nothing:
+// every row of nanomips_opcodes gets the itype the map has for its mnemonic through fill_opcode, or nMIPS_todo if it has none.
+// Links against the SDK stand-in in bench/sdk, like the analysis benchmark.
+//
+// usage: nmips_opcode_map_test
+
+#include "nmips.hpp"
+#include "log.hpp"
+#include <map>
+#include <set>
+#include <stdio.h>
+#include <string>
+
+extern std::map<std::string, uint16> opcode_mapping;
+
+int main(int argc, char** argv)
+{
+    loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+    plugin_ctx_t* ctx = new plugin_ctx_t;
+
+    size_t mismatches = 0;
+    size_t mapped = 0;
+    std::set<std::string> used;
+    for (int i = 0; i < bfd_nanomips_num_opcodes; i++)
+    {
+        const struct nanomips_opcode& op = nanomips_opcodes[i];
+        auto it = opcode_mapping.find(op.name);
+        uint16 expected = it != opcode_mapping.end() ? it->second : nMIPS_todo;
+
+        insn_t insn;
+        bool filled = ctx->fill_opcode(insn, op);
+        if (insn.itype != expected || filled != (it != opcode_mapping.end()))
+        {
+            if (mismatches++ < 10) printf("row %d (%s): itype %u, expected %u\n", i, op.name, insn.itype, expected);
+            continue;
+        }
+        if (it != opcode_mapping.end())
+        {
+            mapped++;
+            used.insert(it->first);
+        }
+    }
+
+    // mnemonics nanomips_opcodes does not have, these never resolve to anything.
+    size_t unused = opcode_mapping.size() - used.size();
+    printf("%d rows, %zu mapped, %zu mismatches, %zu map entries without a row\n", bfd_nanomips_num_opcodes, mapped, mismatches, unused);
+    delete ctx;
+    return mismatches != 0;
+}
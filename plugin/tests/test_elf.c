@@ -0,0 +1,78 @@
+#include "test_elf.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SHF_EXECINSTR 0x4
+
+static uint32_t
+read32 (const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint16_t
+read16 (const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+uint8_t *
+test_read_file (const char *path, size_t *size)
+{
+    uint8_t *file;
+    FILE *f = fopen (path, "rb");
+
+    if (f == NULL)
+    {
+        fprintf (stderr, "cannot open %s\n", path);
+        return NULL;
+    }
+    fseek (f, 0, SEEK_END);
+    *size = ftell (f);
+    rewind (f);
+    file = malloc (*size);
+    if (file == NULL || fread (file, 1, *size, f) != *size)
+    {
+        fprintf (stderr, "cannot read %s\n", path);
+        free (file);
+        fclose (f);
+        return NULL;
+    }
+    fclose (f);
+    return file;
+}
+
+size_t
+test_find_sections (const uint8_t *file, size_t size, struct test_section *out, size_t max)
+{
+    uint32_t shoff;
+    uint16_t shentsize, shnum, i;
+    size_t count = 0;
+
+    if (size < 52 || file[0] != 0x7f || file[1] != 'E' || file[4] != 1 || file[5] != 1)
+        return 0;
+
+    shoff = read32 (file + 32);
+    shentsize = read16 (file + 46);
+    shnum = read16 (file + 48);
+    for (i = 0; i < shnum && count < max; i++)
+    {
+        const uint8_t *sh = file + shoff + (size_t) i * shentsize;
+        uint32_t flags, addr, offset, sh_size;
+
+        if (sh + 40 > file + size)
+            break;
+        flags = read32 (sh + 8);
+        addr = read32 (sh + 12);
+        offset = read32 (sh + 16);
+        sh_size = read32 (sh + 20);
+        if ((flags & SHF_EXECINSTR) == 0 || (size_t) offset + sh_size > size)
+            continue;
+
+        out[count].bytes = file + offset;
+        out[count].size = sh_size;
+        out[count].addr = addr;
+        count++;
+    }
+    return count;
+}
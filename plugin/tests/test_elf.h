@@ -0,0 +1,22 @@
+/* Helpers shared by the decoder tests, which read the bundled babymips.  */
+
+#ifndef __TEST_ELF_H
+#define __TEST_ELF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct test_section
+{
+    const uint8_t *bytes;
+    size_t size;
+    uint32_t addr;
+};
+
+/* Read the whole file at PATH, NULL on failure.  */
+uint8_t *test_read_file (const char *path, size_t *size);
+
+/* Collect up to MAX executable sections of a little-endian ELF32 file.  */
+size_t test_find_sections (const uint8_t *file, size_t size, struct test_section *out, size_t max);
+
+#endif /* __TEST_ELF_H */